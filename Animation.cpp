@@ -0,0 +1,231 @@
+#include "Animation.h"
+#include "ThreadPool.h"
+
+#include <assimp/scene.h>
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// assimp's default when a file doesn't say
+const double DEFAULT_TICKS_PER_SECOND = 25.0;
+
+////////////////////////////
+/// Skeleton Definitions ///
+////////////////////////////
+
+int Skeleton::addBone(const std::string& name, const glm::mat4& offset) {
+    auto it = boneIndex.find(name);
+    if (it != boneIndex.end()) return it->second;
+    auto node = nodeIndex.find(name);
+    if (node == nodeIndex.end()) return -1;
+    int bone = boneNodes.size();
+    boneNodes.push_back(node->second);
+    inverseBind.push_back(offset);
+    boneIndex[name] = bone;
+    return bone;
+}
+
+void addNodes(const aiNode* node, int parent, Skeleton& skeleton) {
+    int index = skeleton.parents.size();
+    skeleton.nodeNames.push_back(node->mName.C_Str());
+    skeleton.parents.push_back(parent);
+    skeleton.bindLocal.push_back(toGlm(&node->mTransformation.a1));
+    skeleton.nodeIndex[node->mName.C_Str()] = index;
+    for (unsigned int i = 0; i < node->mNumChildren; i++) addNodes(node->mChildren[i], index, skeleton);
+}
+
+Skeleton importSkeleton(const aiScene* scene) {
+    Skeleton skeleton;
+    addNodes(scene->mRootNode, -1, skeleton);
+    skeleton.globalInverse = glm::inverse(skeleton.bindLocal[0]);
+    return skeleton;
+}
+
+AnimationClip importAnimation(const aiAnimation* animation, const Skeleton& skeleton) {
+    AnimationClip clip;
+    clip.name = animation->mName.C_Str();
+    double ticks = animation->mTicksPerSecond > 0 ? animation->mTicksPerSecond : DEFAULT_TICKS_PER_SECOND;
+    clip.duration = animation->mDuration / ticks;
+    for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+        const aiNodeAnim* channel = animation->mChannels[c];
+        auto node = skeleton.nodeIndex.find(channel->mNodeName.C_Str());
+        // channels for nodes the scene doesn't have can't affect anything
+        if (node == skeleton.nodeIndex.end()) continue;
+        NodeTrack track;
+        track.node = node->second;
+        for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+            const aiVectorKey& key = channel->mPositionKeys[k];
+            track.positionTimes.push_back(key.mTime / ticks);
+            track.px.push_back(key.mValue.x);
+            track.py.push_back(key.mValue.y);
+            track.pz.push_back(key.mValue.z);
+        }
+        for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+            const aiQuatKey& key = channel->mRotationKeys[k];
+            track.rotationTimes.push_back(key.mTime / ticks);
+            track.rx.push_back(key.mValue.x);
+            track.ry.push_back(key.mValue.y);
+            track.rz.push_back(key.mValue.z);
+            track.rw.push_back(key.mValue.w);
+        }
+        for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+            const aiVectorKey& key = channel->mScalingKeys[k];
+            track.scaleTimes.push_back(key.mTime / ticks);
+            track.sx.push_back(key.mValue.x);
+            track.sy.push_back(key.mValue.y);
+            track.sz.push_back(key.mValue.z);
+        }
+        clip.tracks.push_back(std::move(track));
+    }
+    return clip;
+}
+
+////////////////////////////
+/// Pose Evaluation ///
+////////////////////////////
+
+// key before time and the blend factor towards the next one
+size_t findKey(const std::vector<float>& times, float time, float& t) {
+    t = 0;
+    if (times.size() < 2 || time <= times[0]) return 0;
+    size_t k = std::upper_bound(times.begin(), times.end(), time) - times.begin() - 1;
+    if (k + 1 >= times.size()) return times.size() - 1;
+    float span = times[k + 1] - times[k];
+    t = span > 0 ? (time - times[k]) / span : 0;
+    return k;
+}
+
+float lerp(const std::vector<float>& v, size_t k, float t) {
+    return t == 0 ? v[k] : v[k] + (v[k + 1] - v[k]) * t;
+}
+
+void sampleTrack(const NodeTrack& track, float time, float* m) {
+    float t;
+    float tx = 0, ty = 0, tz = 0;
+    if (!track.positionTimes.empty()) {
+        size_t k = findKey(track.positionTimes, time, t);
+        tx = lerp(track.px, k, t);
+        ty = lerp(track.py, k, t);
+        tz = lerp(track.pz, k, t);
+    }
+    float x = 0, y = 0, z = 0, w = 1;
+    if (!track.rotationTimes.empty()) {
+        size_t k = findKey(track.rotationTimes, time, t);
+        x = track.rx[k];
+        y = track.ry[k];
+        z = track.rz[k];
+        w = track.rw[k];
+        if (t > 0) {
+            // nlerp along the shorter arc, keys are dense enough that it's indistinguishable from slerp
+            float s = x * track.rx[k + 1] + y * track.ry[k + 1] + z * track.rz[k + 1] + w * track.rw[k + 1] < 0 ? -t : t;
+            x = x * (1 - t) + track.rx[k + 1] * s;
+            y = y * (1 - t) + track.ry[k + 1] * s;
+            z = z * (1 - t) + track.rz[k + 1] * s;
+            w = w * (1 - t) + track.rw[k + 1] * s;
+        }
+        float len = std::sqrt(x * x + y * y + z * z + w * w);
+        if (len > 0) {
+            x /= len;
+            y /= len;
+            z /= len;
+            w /= len;
+        }
+    }
+    float sx = 1, sy = 1, sz = 1;
+    if (!track.scaleTimes.empty()) {
+        size_t k = findKey(track.scaleTimes, time, t);
+        sx = lerp(track.sx, k, t);
+        sy = lerp(track.sy, k, t);
+        sz = lerp(track.sz, k, t);
+    }
+
+    // translation * rotation * scale, column major
+    m[0] = (1 - 2 * (y * y + z * z)) * sx;
+    m[1] = 2 * (x * y + w * z) * sx;
+    m[2] = 2 * (x * z - w * y) * sx;
+    m[3] = 0;
+    m[4] = 2 * (x * y - w * z) * sy;
+    m[5] = (1 - 2 * (x * x + z * z)) * sy;
+    m[6] = 2 * (y * z + w * x) * sy;
+    m[7] = 0;
+    m[8] = 2 * (x * z + w * y) * sz;
+    m[9] = 2 * (y * z - w * x) * sz;
+    m[10] = (1 - 2 * (x * x + y * y)) * sz;
+    m[11] = 0;
+    m[12] = tx;
+    m[13] = ty;
+    m[14] = tz;
+    m[15] = 1;
+}
+
+void samplePose(const Skeleton& skeleton, const AnimationClip& clip, float time, glm::mat4* locals) {
+    if (clip.duration > 0) {
+        time = std::fmod(time, clip.duration);
+        if (time < 0) time += clip.duration;
+    }
+    std::memcpy((void*)locals, skeleton.bindLocal.data(), skeleton.nodeCount() * sizeof(glm::mat4));
+    for (const NodeTrack& track : clip.tracks) sampleTrack(track, time, &locals[track.node][0][0]);
+}
+
+void composePose(const Skeleton& skeleton, const glm::mat4* locals, glm::mat4* globals, glm::mat4* palette) {
+    // parents come first so one pass resolves the whole hierarchy
+    size_t n = skeleton.nodeCount();
+    for (size_t i = 0; i < n; i++) {
+        int parent = skeleton.parents[i];
+        if (parent < 0) globals[i] = locals[i];
+        else multiply(&globals[parent][0][0], &locals[i][0][0], &globals[i][0][0]);
+    }
+    for (size_t b = 0; b < skeleton.boneCount(); b++) {
+        float* out = &palette[b][0][0];
+        multiply(&globals[skeleton.boneNodes[b]][0][0], &skeleton.inverseBind[b][0][0], out);
+        multiply(&skeleton.globalInverse[0][0], out, out);
+    }
+}
+
+void evaluatePoses(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, const std::vector<AnimationInstance>& instances, std::vector<glm::mat4>& palettes) {
+    size_t n_bones = skeleton.boneCount();
+    palettes.resize(instances.size() * n_bones);
+    ThreadPool::global().parallelFor(instances.size(), [&](size_t begin, size_t end, size_t) {
+        // scratch per chunk, reused for every instance in it
+        std::vector<glm::mat4> locals(skeleton.nodeCount());
+        std::vector<glm::mat4> globals(skeleton.nodeCount());
+        for (size_t i = begin; i < end; i++) {
+            glm::mat4* palette = palettes.data() + i * n_bones;
+            if (instances[i].clip < clips.size()) samplePose(skeleton, clips[instances[i].clip], instances[i].time, locals.data());
+            else std::memcpy((void*)locals.data(), skeleton.bindLocal.data(), locals.size() * sizeof(glm::mat4));
+            composePose(skeleton, locals.data(), globals.data(), palette);
+        }
+    });
+}
+
+//////////////////////////////////////
+/// BonePaletteBuffer Definitions ///
+//////////////////////////////////////
+
+BonePaletteBuffer::BonePaletteBuffer(void) :
+    TBO{ GLBuffer::create() },
+    texture{ GLTexture::create() },
+    capacity{ 0 }
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, TBO);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void BonePaletteBuffer::upload(const std::vector<glm::mat4>& palettes) {
+    glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+    // grows geometrically, otherwise the same size is orphaned every frame
+    if (palettes.size() > capacity) capacity = std::max(palettes.size(), 2 * capacity);
+    glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    if (!palettes.empty()) glBufferSubData(GL_TEXTURE_BUFFER, 0, palettes.size() * sizeof(glm::mat4), palettes.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void BonePaletteBuffer::bind(unsigned int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+}
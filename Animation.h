@@ -0,0 +1,93 @@
+#ifndef ANIMATION_HH
+#define ANIMATION_HH
+
+#include "GLHandle.h"
+#include "MatrixMath.h"
+
+#include <glm/glm/glm.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct aiScene;
+struct aiAnimation;
+
+// node hierarchy of a model plus the subset of nodes that skin vertices (bones).
+// nodes are stored depth first so every parent comes before its children.
+struct Skeleton {
+    std::vector<std::string> nodeNames;
+    // -1 for the root
+    std::vector<int> parents;
+    // node transform relative to its parent when no animation drives it
+    std::vector<glm::mat4> bindLocal;
+    // bone -> node, and the mesh space to bone space transform (aiBone::mOffsetMatrix)
+    std::vector<int> boneNodes;
+    std::vector<glm::mat4> inverseBind;
+    std::unordered_map<std::string, int> nodeIndex;
+    std::unordered_map<std::string, int> boneIndex;
+    glm::mat4 globalInverse;
+
+    size_t nodeCount(void) const { return parents.size(); }
+    size_t boneCount(void) const { return boneNodes.size(); }
+    // index of the bone with that name, registered on first use. -1 if no node has the name
+    int addBone(const std::string& name, const glm::mat4& offset);
+};
+
+// keyframes of one node, structure of arrays so the key search and interpolation stream through plain floats.
+// times are in seconds
+struct NodeTrack {
+    int node;
+    std::vector<float> positionTimes, px, py, pz;
+    std::vector<float> rotationTimes, rx, ry, rz, rw;
+    std::vector<float> scaleTimes, sx, sy, sz;
+};
+
+struct AnimationClip {
+    std::string name;
+    // seconds
+    float duration;
+    std::vector<NodeTrack> tracks;
+};
+
+// one animated character
+struct AnimationInstance {
+    unsigned int clip;
+    // seconds, wrapped into the clip
+    float time;
+};
+
+// the node tree of a scene, without bones, those are added by addBone while reading the meshes
+Skeleton importSkeleton(const aiScene* scene);
+AnimationClip importAnimation(const aiAnimation* animation, const Skeleton& skeleton);
+
+// local transform of every node at time, nodes without a track keep their bind pose
+void samplePose(const Skeleton& skeleton, const AnimationClip& clip, float time, glm::mat4* locals);
+// walks the hierarchy and writes one skinning matrix per bone, globals is scratch space of nodeCount matrices
+void composePose(const Skeleton& skeleton, const glm::mat4* locals, glm::mat4* globals, glm::mat4* palette);
+// samples and composes every instance on the global ThreadPool,
+// palettes receives boneCount matrices per instance, instance after instance
+void evaluatePoses(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, const std::vector<AnimationInstance>& instances, std::vector<glm::mat4>& palettes);
+
+// The palettes of all instances in one texture buffer, uploaded once per frame (GL 3.3 has no storage buffers).
+// Skinning shaders fetch the matrix of bone b of instance i as 4 texels starting at 4 * (i * boneCount + b):
+//     uniform samplerBuffer bones;
+//     mat4 bone(int b) {
+//         int base = 4 * ((boneBase + gl_InstanceID) * boneCount + b);
+//         return mat4(texelFetch(bones, base), texelFetch(bones, base + 1), texelFetch(bones, base + 2), texelFetch(bones, base + 3));
+//     }
+class BonePaletteBuffer {
+public:
+    GLBuffer TBO;
+    GLTexture texture;
+    // matrices the buffer can hold before it has to grow
+    size_t capacity;
+
+    BonePaletteBuffer(void);
+    // orphans the previous storage so the upload never waits on the GPU still reading last frame's palettes
+    void upload(const std::vector<glm::mat4>& palettes);
+    // binds the texture buffer to a texture unit for the samplerBuffer
+    void bind(unsigned int unit);
+};
+
+#endif
@@ -0,0 +1,547 @@
+#include "BVH.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define BVH_SSE
+#endif
+
+namespace {
+
+// batch queries use a few chunks per thread since rays cost very different amounts
+const size_t CHUNKS_PER_THREAD = 4;
+// leaves of the top level, instances are cheap to list but expensive to enter
+const uint32_t SCENE_LEAF_SIZE = 2;
+
+struct Bounds {
+    glm::vec3 lo, hi;
+
+    Bounds(void) : lo(FLT_MAX), hi(-FLT_MAX) {}
+    void grow(const glm::vec3& p) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    void grow(const Bounds& b) {
+        lo = glm::min(lo, b.lo);
+        hi = glm::max(hi, b.hi);
+    }
+    // half the surface area, the SAH only compares them
+    float area(void) const {
+        if (hi.x < lo.x) return 0;
+        glm::vec3 d = hi - lo;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+};
+
+struct Bin {
+    Bounds bounds;
+    uint32_t count = 0;
+};
+
+// binned SAH over primitive boxes, writes nodes and the leaf order of the primitives
+struct Builder {
+    const Bounds* boxes;
+    const glm::vec3* centroids;
+    uint32_t* order;
+    BVHNode* nodes;
+    std::atomic<uint32_t> used;
+    uint32_t leafSize;
+
+    void build(uint32_t index, uint32_t begin, uint32_t end, uint32_t depth);
+};
+
+void Builder::build(uint32_t index, uint32_t begin, uint32_t end, uint32_t depth) {
+    uint32_t count = end - begin;
+    bool parallel = count >= BVH_PARALLEL_BUILD;
+    size_t chunks = parallel ? ThreadPool::global().size() : 1;
+    // most nodes are small, they run the passes directly on stack scratch
+    auto run = [&](const std::function<void(size_t, size_t, size_t)>& pass) {
+        if (parallel) ThreadPool::global().parallelFor(count, pass, chunks);
+        else pass(0, count, 0);
+    };
+
+    Bounds localBounds[2];
+    std::vector<Bounds> sharedBounds(parallel ? 2 * chunks : 0);
+    Bounds* boxBounds = parallel ? sharedBounds.data() : localBounds;
+    Bounds* centroidBounds = boxBounds + chunks;
+    run([&](size_t b, size_t e, size_t c) {
+        for (size_t i = begin + b; i < begin + e; i++) {
+            boxBounds[c].grow(boxes[order[i]]);
+            centroidBounds[c].grow(centroids[order[i]]);
+        }
+    });
+    for (size_t c = 1; c < chunks; c++) {
+        boxBounds[0].grow(boxBounds[c]);
+        centroidBounds[0].grow(centroidBounds[c]);
+    }
+    BVHNode& node = nodes[index];
+    for (int a = 0; a < 3; a++) {
+        node.lo[a] = boxBounds[0].lo[a];
+        node.hi[a] = boxBounds[0].hi[a];
+    }
+    if (count <= leafSize) {
+        node.first = begin;
+        node.count = count;
+        return;
+    }
+
+    const Bounds& cb = centroidBounds[0];
+    glm::vec3 extent = cb.hi - cb.lo;
+    float scale[3];
+    for (int a = 0; a < 3; a++) scale[a] = extent[a] > 0 ? BVH_SAH_BINS / extent[a] : 0;
+    auto binOf = [&](const glm::vec3& c, int axis) {
+        return std::min((int)((c[axis] - cb.lo[axis]) * scale[axis]), BVH_SAH_BINS - 1);
+    };
+
+    int bestAxis = -1;
+    int bestSplit = 0;
+    // deep down the heuristic gave up on balance, median splits bound the rest of the depth
+    if (depth < BVH_MAX_DEPTH / 2) {
+        Bin localBins[3 * BVH_SAH_BINS];
+        std::vector<Bin> sharedBins(parallel ? chunks * 3 * BVH_SAH_BINS : 0);
+        Bin* bins = parallel ? sharedBins.data() : localBins;
+        run([&](size_t b, size_t e, size_t c) {
+            Bin* own = &bins[c * 3 * BVH_SAH_BINS];
+            for (size_t i = begin + b; i < begin + e; i++) {
+                uint32_t p = order[i];
+                for (int a = 0; a < 3; a++) {
+                    if (scale[a] == 0) continue;
+                    Bin& bin = own[a * BVH_SAH_BINS + binOf(centroids[p], a)];
+                    bin.bounds.grow(boxes[p]);
+                    bin.count++;
+                }
+            }
+        });
+        for (size_t c = 1; c < chunks; c++) {
+            for (int k = 0; k < 3 * BVH_SAH_BINS; k++) {
+                bins[k].bounds.grow(bins[c * 3 * BVH_SAH_BINS + k].bounds);
+                bins[k].count += bins[c * 3 * BVH_SAH_BINS + k].count;
+            }
+        }
+
+        float bestCost = FLT_MAX;
+        for (int a = 0; a < 3; a++) {
+            if (scale[a] == 0) continue;
+            const Bin* axisBins = &bins[a * BVH_SAH_BINS];
+            // cost of the right side of every split plane, swept from the right
+            float rightCost[BVH_SAH_BINS];
+            Bounds right;
+            uint32_t rightCount = 0;
+            for (int s = BVH_SAH_BINS - 1; s > 0; s--) {
+                right.grow(axisBins[s].bounds);
+                rightCount += axisBins[s].count;
+                rightCost[s] = right.area() * rightCount;
+            }
+            Bounds left;
+            uint32_t leftCount = 0;
+            for (int s = 1; s < BVH_SAH_BINS; s++) {
+                left.grow(axisBins[s - 1].bounds);
+                leftCount += axisBins[s - 1].count;
+                if (leftCount == 0 || leftCount == count) continue;
+                float cost = left.area() * leftCount + rightCost[s];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestSplit = s;
+                }
+            }
+        }
+    }
+
+    uint32_t mid = begin + count / 2;
+    if (bestAxis >= 0) {
+        mid = std::partition(order + begin, order + end, [&](uint32_t p) { return binOf(centroids[p], bestAxis) < bestSplit; }) - order;
+    }
+    else if (depth >= BVH_MAX_DEPTH / 2) {
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+        std::nth_element(order + begin, order + mid, order + end, [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+    // otherwise every centroid is the same point and any split is as good
+
+    uint32_t left = used.fetch_add(2);
+    node.first = left;
+    node.count = 0;
+    if (parallel) {
+        std::atomic<bool> finished(false);
+        ThreadPool::global().submit([this, &finished, left, begin, mid, depth] {
+            build(left, begin, mid, depth + 1);
+            finished = true;
+        }, &finished);
+        build(left + 1, mid, end, depth + 1);
+        ThreadPool::global().helpUntil([&finished] { return finished.load(); }, &finished);
+    }
+    else {
+        build(left, begin, mid, depth + 1);
+        build(left + 1, mid, end, depth + 1);
+    }
+}
+
+// nodes over boxes, order receives the primitives in leaf order
+std::vector<BVHNode> buildNodes(const std::vector<Bounds>& boxes, uint32_t leafSize, std::vector<uint32_t>& order) {
+    size_t n = boxes.size();
+    std::vector<glm::vec3> centroids(n);
+    order.resize(n);
+    ThreadPool::global().parallelFor(n, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) {
+            centroids[i] = 0.5f * (boxes[i].lo + boxes[i].hi);
+            order[i] = i;
+        }
+    }, n < BVH_PARALLEL_BUILD ? 1 : 0);
+    // a binary tree with at least one primitive per leaf
+    std::vector<BVHNode> nodes(std::max<size_t>(1, 2 * n - 1));
+    Builder builder;
+    builder.boxes = boxes.data();
+    builder.centroids = centroids.data();
+    builder.order = order.data();
+    builder.nodes = nodes.data();
+    builder.used = 1;
+    builder.leafSize = leafSize;
+    builder.build(0, 0, n, 0);
+    nodes.resize(builder.used);
+    return nodes;
+}
+
+// ray with what the box and triangle tests reuse
+struct RayData {
+    glm::vec3 origin, direction;
+#ifdef BVH_SSE
+    __m128 o, inverse;
+#else
+    glm::vec3 inverse;
+#endif
+
+    RayData(const glm::vec3& org, const glm::vec3& dir) : origin{ org }, direction{ dir } {
+        glm::vec3 inv(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+#ifdef BVH_SSE
+        o = _mm_set_ps(0, org.z, org.y, org.x);
+        inverse = _mm_set_ps(0, inv.z, inv.y, inv.x);
+#else
+        inverse = inv;
+#endif
+    }
+};
+
+// slab test, tEnter is where the ray enters the box
+inline bool hitBox(const BVHNode& node, const RayData& r, float tMax, float& tEnter) {
+#ifdef BVH_SSE
+    // the fourth lane holds first/count, only xyz are reduced
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.lo), r.o), r.inverse);
+    __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.hi), r.o), r.inverse);
+    __m128 tmin = _mm_min_ps(t1, t2);
+    __m128 tmax = _mm_max_ps(t1, t2);
+    __m128 enter = _mm_max_ss(_mm_max_ss(tmin, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(3, 3, 3, 1))), _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(3, 3, 3, 2)));
+    __m128 exit = _mm_min_ss(_mm_min_ss(tmax, _mm_shuffle_ps(tmax, tmax, _MM_SHUFFLE(3, 3, 3, 1))), _mm_shuffle_ps(tmax, tmax, _MM_SHUFFLE(3, 3, 3, 2)));
+    tEnter = std::max(_mm_cvtss_f32(enter), 0.0f);
+    return tEnter <= std::min(_mm_cvtss_f32(exit), tMax);
+#else
+    float enter = 0, exit = tMax;
+    for (int a = 0; a < 3; a++) {
+        float t1 = (node.lo[a] - r.origin[a]) * r.inverse[a];
+        float t2 = (node.hi[a] - r.origin[a]) * r.inverse[a];
+        enter = std::max(enter, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+    }
+    tEnter = enter;
+    return enter <= exit;
+#endif
+}
+
+// closest hit of the packet inside (0, best), updates best and hit
+inline bool hitPacket(const TrianglePacket& p, const RayData& r, float& best, RayHit& hit) {
+    float ts[4], us[4], vs[4];
+    int mask = 0;
+#ifdef BVH_SSE
+    __m128 dx = _mm_set1_ps(r.direction.x), dy = _mm_set1_ps(r.direction.y), dz = _mm_set1_ps(r.direction.z);
+    __m128 e1x = _mm_loadu_ps(p.e1[0]), e1y = _mm_loadu_ps(p.e1[1]), e1z = _mm_loadu_ps(p.e1[2]);
+    __m128 e2x = _mm_loadu_ps(p.e2[0]), e2y = _mm_loadu_ps(p.e2[1]), e2z = _mm_loadu_ps(p.e2[2]);
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    // s = o - v0
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(r.origin.x), _mm_loadu_ps(p.v0[0]));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(r.origin.y), _mm_loadu_ps(p.v0[1]));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(r.origin.z), _mm_loadu_ps(p.v0[2]));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+    __m128 zero = _mm_setzero_ps();
+    // degenerate lanes have det 0, NaNs fail every comparison
+    __m128 ok = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_cmpge_ps(u, zero));
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(v, zero));
+    ok = _mm_and_ps(ok, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    ok = _mm_and_ps(ok, _mm_cmpgt_ps(t, zero));
+    ok = _mm_and_ps(ok, _mm_cmplt_ps(t, _mm_set1_ps(best)));
+    mask = _mm_movemask_ps(ok);
+    if (!mask) return false;
+    _mm_storeu_ps(ts, t);
+    _mm_storeu_ps(us, u);
+    _mm_storeu_ps(vs, v);
+#else
+    for (int k = 0; k < 4; k++) {
+        glm::vec3 e1(p.e1[0][k], p.e1[1][k], p.e1[2][k]);
+        glm::vec3 e2(p.e2[0][k], p.e2[1][k], p.e2[2][k]);
+        glm::vec3 pv = glm::cross(r.direction, e2);
+        float det = glm::dot(e1, pv);
+        if (det == 0) continue;
+        float inv = 1.0f / det;
+        glm::vec3 s = r.origin - glm::vec3(p.v0[0][k], p.v0[1][k], p.v0[2][k]);
+        us[k] = glm::dot(s, pv) * inv;
+        glm::vec3 q = glm::cross(s, e1);
+        vs[k] = glm::dot(r.direction, q) * inv;
+        ts[k] = glm::dot(e2, q) * inv;
+        if (us[k] >= 0 && vs[k] >= 0 && us[k] + vs[k] <= 1 && ts[k] > 0 && ts[k] < best) mask |= 1 << k;
+    }
+    if (!mask) return false;
+#endif
+    for (int k = 0; k < 4; k++) {
+        if (!(mask & (1 << k)) || ts[k] >= best) continue;
+        best = ts[k];
+        hit.t = ts[k];
+        hit.u = us[k];
+        hit.v = vs[k];
+        hit.triangle = p.triangle[k];
+    }
+    return true;
+}
+
+// front to back walk, leaf(node, best) tests the primitives and returns true to stop early
+template <class Leaf>
+void traverse(const std::vector<BVHNode>& nodes, const RayData& r, float& best, Leaf leaf) {
+    struct Entry {
+        uint32_t node;
+        float t;
+    };
+    Entry stack[BVH_MAX_DEPTH];
+    int top = 0;
+    float t;
+    if (nodes.empty() || !hitBox(nodes[0], r, best, t)) return;
+    uint32_t current = 0;
+    while (true) {
+        const BVHNode& node = nodes[current];
+        if (node.count) {
+            if (leaf(node, best)) return;
+        }
+        else {
+            float t0, t1;
+            bool h0 = hitBox(nodes[node.first], r, best, t0);
+            bool h1 = hitBox(nodes[node.first + 1], r, best, t1);
+            if (h0 && h1) {
+                bool swap = t1 < t0;
+                stack[top++] = { node.first + (swap ? 0 : 1), swap ? t0 : t1 };
+                current = node.first + (swap ? 1 : 0);
+                continue;
+            }
+            if (h0 || h1) {
+                current = node.first + (h0 ? 0 : 1);
+                continue;
+            }
+        }
+        // entries behind the closest hit so far are skipped
+        do {
+            if (top == 0) return;
+            top--;
+        } while (stack[top].t > best);
+        current = stack[top].node;
+    }
+}
+
+RayHit missed(const Ray& ray) {
+    return RayHit{ ray.tMax, 0, 0, BVH_NO_HIT, BVH_NO_HIT };
+}
+
+size_t batchChunks(void) {
+    return ThreadPool::global().size() * CHUNKS_PER_THREAD;
+}
+
+}
+
+////////////////////////////
+/// MeshBVH Definitions ///
+////////////////////////////
+
+MeshBVH::MeshBVH(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds) {
+    size_t n_tris = n_inds / 3;
+    if (n_tris == 0) return;
+    for (size_t i = 0; i < n_tris * 3; i++) {
+        if (inds[i] >= n_vs) {
+            std::cout << "ERROR::BVH:: index " << inds[i] << " out of range of " << n_vs << " vertices\n";
+            return;
+        }
+    }
+    std::vector<Bounds> boxes(n_tris);
+    ThreadPool::global().parallelFor(n_tris, [&](size_t begin, size_t end, size_t) {
+        for (size_t t = begin; t < end; t++) {
+            for (int k = 0; k < 3; k++) boxes[t].grow(vs[inds[3 * t + k]].Position);
+        }
+    }, n_tris < BVH_PARALLEL_BUILD ? 1 : 0);
+    std::vector<uint32_t> order;
+    nodes = buildNodes(boxes, BVH_LEAF_SIZE, order);
+
+    // every leaf becomes one packet, laid out in node order
+    std::vector<uint32_t> leaves;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].count) leaves.push_back(i);
+    }
+    packets.resize(leaves.size());
+    ThreadPool::global().parallelFor(leaves.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t l = begin; l < end; l++) {
+            BVHNode& leaf = nodes[leaves[l]];
+            TrianglePacket& p = packets[l];
+            std::memset(&p, 0, sizeof(p));
+            for (uint32_t k = 0; k < 4; k++) {
+                p.triangle[k] = BVH_NO_HIT;
+                if (k >= leaf.count) continue;
+                uint32_t t = order[leaf.first + k];
+                glm::vec3 a = vs[inds[3 * t]].Position;
+                glm::vec3 e1 = vs[inds[3 * t + 1]].Position - a;
+                glm::vec3 e2 = vs[inds[3 * t + 2]].Position - a;
+                for (int c = 0; c < 3; c++) {
+                    p.v0[c][k] = a[c];
+                    p.e1[c][k] = e1[c];
+                    p.e2[c][k] = e2[c];
+                }
+                p.triangle[k] = t;
+            }
+            leaf.first = l;
+        }
+    }, leaves.size() < BVH_PARALLEL_BUILD ? 1 : 0);
+}
+
+MeshBVH::MeshBVH(const Mesh& mesh) {
+    if (mesh.vertices.empty() || mesh.indices.empty()) {
+        std::cout << "ERROR::BVH:: mesh has no CPU data, load it with Retain_type::ALL\n";
+        return;
+    }
+    *this = MeshBVH(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.lods[0].indexCount);
+}
+
+bool MeshBVH::intersect(const Ray& ray, RayHit& hit) const {
+    RayData r(ray.origin, ray.direction);
+    float best = ray.tMax;
+    bool found = false;
+    traverse(nodes, r, best, [&](const BVHNode& leaf, float& t) {
+        found = hitPacket(packets[leaf.first], r, t, hit) || found;
+        return false;
+    });
+    if (found) hit.instance = BVH_NO_HIT;
+    return found;
+}
+
+bool MeshBVH::occluded(const Ray& ray) const {
+    RayData r(ray.origin, ray.direction);
+    float best = ray.tMax;
+    bool found = false;
+    RayHit scratch;
+    traverse(nodes, r, best, [&](const BVHNode& leaf, float& t) {
+        found = hitPacket(packets[leaf.first], r, t, scratch);
+        return found;
+    });
+    return found;
+}
+
+void MeshBVH::intersect(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const {
+    hits.resize(rays.size());
+    ThreadPool::global().parallelFor(rays.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) {
+            if (!intersect(rays[i], hits[i])) hits[i] = missed(rays[i]);
+        }
+    }, batchChunks());
+}
+
+////////////////////////////
+/// SceneBVH Definitions ///
+////////////////////////////
+
+SceneBVH::SceneBVH(std::vector<BVHInstance> instances) {
+    build(std::move(instances));
+}
+
+void SceneBVH::build(std::vector<BVHInstance> newInstances) {
+    instances = std::move(newInstances);
+    inverses.resize(instances.size());
+    // instances without geometry keep an empty box, which no ray enters
+    std::vector<Bounds> boxes(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        inverses[i] = glm::inverse(instances[i].transform);
+        if (!instances[i].bvh || instances[i].bvh->empty()) continue;
+        const BVHNode& root = instances[i].bvh->nodes[0];
+        for (int c = 0; c < 8; c++) {
+            glm::vec3 corner(c & 1 ? root.hi[0] : root.lo[0], c & 2 ? root.hi[1] : root.lo[1], c & 4 ? root.hi[2] : root.lo[2]);
+            boxes[i].grow(glm::vec3(instances[i].transform * glm::vec4(corner, 1.0f)));
+        }
+    }
+    if (instances.empty()) {
+        nodes.clear();
+        order.clear();
+        return;
+    }
+    nodes = buildNodes(boxes, SCENE_LEAF_SIZE, order);
+}
+
+bool SceneBVH::intersect(const Ray& ray, RayHit& hit) const {
+    RayData r(ray.origin, ray.direction);
+    float best = ray.tMax;
+    bool found = false;
+    traverse(nodes, r, best, [&](const BVHNode& leaf, float& t) {
+        for (uint32_t k = leaf.first; k < leaf.first + leaf.count; k++) {
+            uint32_t i = order[k];
+            if (!instances[i].bvh) continue;
+            // the direction isn't renormalized so t stays the same along both rays
+            Ray local{ glm::vec3(inverses[i] * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverses[i] * glm::vec4(ray.direction, 0.0f)), t };
+            if (instances[i].bvh->intersect(local, hit)) {
+                t = hit.t;
+                hit.instance = i;
+                found = true;
+            }
+        }
+        return false;
+    });
+    return found;
+}
+
+bool SceneBVH::occluded(const Ray& ray) const {
+    RayData r(ray.origin, ray.direction);
+    float best = ray.tMax;
+    bool found = false;
+    traverse(nodes, r, best, [&](const BVHNode& leaf, float& t) {
+        for (uint32_t k = leaf.first; k < leaf.first + leaf.count && !found; k++) {
+            uint32_t i = order[k];
+            if (!instances[i].bvh) continue;
+            Ray local{ glm::vec3(inverses[i] * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverses[i] * glm::vec4(ray.direction, 0.0f)), t };
+            found = instances[i].bvh->occluded(local);
+        }
+        return found;
+    });
+    return found;
+}
+
+void SceneBVH::intersect(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const {
+    hits.resize(rays.size());
+    ThreadPool::global().parallelFor(rays.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) {
+            if (!intersect(rays[i], hits[i])) hits[i] = missed(rays[i]);
+        }
+    }, batchChunks());
+}
+
+void SceneBVH::occluded(const std::vector<Ray>& rays, std::vector<unsigned char>& results) const {
+    results.resize(rays.size());
+    ThreadPool::global().parallelFor(rays.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) results[i] = occluded(rays[i]);
+    }, batchChunks());
+}
@@ -0,0 +1,108 @@
+#ifndef BVH_HH
+#define BVH_HH
+
+#include "Mesh.h"
+
+#include <glm/glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// triangles per leaf, exactly one SIMD packet
+#define BVH_LEAF_SIZE 4
+// candidate split planes per axis in the binned SAH build
+#define BVH_SAH_BINS 16
+// nodes with at least this many primitives bin in parallel and build their children as separate jobs
+#define BVH_PARALLEL_BUILD 8192
+// deepest a tree gets, the builder switches to median splits halfway so traversal stacks stay fixed size
+#define BVH_MAX_DEPTH 64
+#define BVH_NO_HIT 0xffffffffu
+
+struct Ray {
+    glm::vec3 origin;
+    // need not be normalized, t is measured in multiples of it
+    glm::vec3 direction;
+    // hits beyond are ignored
+    float tMax;
+};
+
+struct RayHit {
+    float t;
+    // barycentric weights of the second and third vertex
+    float u, v;
+    // the triangle's indices start at 3 * triangle, BVH_NO_HIT on a miss
+    uint32_t triangle;
+    // index into SceneBVH::instances, BVH_NO_HIT for single mesh queries
+    uint32_t instance;
+};
+
+// 32 bytes. The two children of an inner node are stored next to each other, so it only keeps the first
+struct BVHNode {
+    float lo[3];
+    // first child of inner nodes, first primitive (mesh leaves: packet) of leaves
+    uint32_t first;
+    float hi[3];
+    // 0 for inner nodes, primitives in the leaf otherwise
+    uint32_t count;
+};
+
+// up to four triangles as structure of arrays for the 4 wide Moller-Trumbore test, unused lanes are degenerate
+struct TrianglePacket {
+    float v0[3][4];
+    float e1[3][4];
+    float e2[3][4];
+    uint32_t triangle[4];
+};
+
+// Bounding volume hierarchy over the triangles of one mesh, built with the surface area heuristic.
+// Only positions are copied in, so the mesh may drop its CPU data afterwards.
+class MeshBVH {
+public:
+    std::vector<BVHNode> nodes;
+    // one per leaf, in leaf order
+    std::vector<TrianglePacket> packets;
+
+    MeshBVH(void) {}
+    // builds over the triangles of inds on the global ThreadPool
+    MeshBVH(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds);
+    // the full level of detail of a mesh that kept its vertices and indices (Retain_type::ALL)
+    MeshBVH(const Mesh& mesh);
+
+    bool empty(void) const { return nodes.empty(); }
+    // closest hit before ray.tMax, hit is left alone if there is none
+    bool intersect(const Ray& ray, RayHit& hit) const;
+    // whether anything is hit before ray.tMax, stops at the first hit, for line of sight
+    bool occluded(const Ray& ray) const;
+    // one query per ray on the global ThreadPool, misses get triangle BVH_NO_HIT and t = tMax
+    void intersect(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const;
+};
+
+// a mesh BVH placed in the world, the transform has to be invertible
+struct BVHInstance {
+    const MeshBVH* bvh;
+    glm::mat4 transform;
+};
+
+// Top level hierarchy over instances of mesh BVHs. Rays are moved into each instance's space, which keeps t,
+// so hits compare directly across instances. Rebuilding it is cheap next to the mesh BVHs, do it when things move.
+class SceneBVH {
+public:
+    std::vector<BVHNode> nodes;
+    std::vector<BVHInstance> instances;
+    // world to instance transforms
+    std::vector<glm::mat4> inverses;
+    // leaves index this, it holds indices into instances
+    std::vector<uint32_t> order;
+
+    SceneBVH(void) {}
+    SceneBVH(std::vector<BVHInstance> instances);
+
+    void build(std::vector<BVHInstance> instances);
+    bool intersect(const Ray& ray, RayHit& hit) const;
+    bool occluded(const Ray& ray) const;
+    void intersect(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const;
+    // 1 where something is hit before tMax
+    void occluded(const std::vector<Ray>& rays, std::vector<unsigned char>& results) const;
+};
+
+#endif
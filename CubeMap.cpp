@@ -1,4 +1,5 @@
 #include "CubeMap.h"
+#include "TextureCompression.h"
 
 #include <glad/glad.h>
 #include <stb/stb_image.h>
@@ -6,11 +7,21 @@
 #include <iostream>
 
 CubeMap::CubeMap(const std::vector<std::string>& faces) {
-    glGenTextures(1, &ID);
+    ID = GLTexture::create();
     glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++) {
+        // block compressed faces go up with their mip chain, which the linear filter below doesn't sample.
+        // a cube map container holds all six faces and is given as the only file
+        if (isCompressedTextureFile(faces[i])) {
+            CompressedImage image;
+            bool ok = readCompressedImage(faces[i], image) && i + image.faces <= 6;
+            for (int face = 0; ok && face < image.faces; face++) ok = uploadCompressedLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i + face, image, face);
+            if (!ok) std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
+            continue;
+        }
+        // faces are top row first like their containers
         unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
         if (data) glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         else std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
@@ -27,8 +38,4 @@ CubeMap::CubeMap(const std::vector<std::string>& faces) {
 void CubeMap::bind(void) {
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
-}
-
-CubeMap::~CubeMap(void) {
-    glDeleteTextures(1, &ID);
 }
\ No newline at end of file
@@ -1,19 +1,20 @@
 #ifndef CUBEMAP_HH
 #define CUBEMAP_HH
 
+#include "GLHandle.h"
+
 #include <string>
 #include <vector>
 
 class CubeMap {
 public:
-    unsigned int ID;
+    GLTexture ID;
     // should cube maps have texture units?
     //size_t unit;
 
+    // one image per face in GL face order, or a single KTX2 or DDS cube map
     CubeMap(const std::vector<std::string>& faces);
     void bind(void);
-
-    ~CubeMap(void);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "GLHandle.h"
+
+#include <glad/glad.h>
+
+unsigned int GLBufferTraits::create(void) {
+    unsigned int id;
+    glGenBuffers(1, &id);
+    return id;
+}
+
+void GLBufferTraits::destroy(unsigned int id) {
+    glDeleteBuffers(1, &id);
+}
+
+unsigned int GLVertexArrayTraits::create(void) {
+    unsigned int id;
+    glGenVertexArrays(1, &id);
+    return id;
+}
+
+void GLVertexArrayTraits::destroy(unsigned int id) {
+    glDeleteVertexArrays(1, &id);
+}
+
+unsigned int GLTextureTraits::create(void) {
+    unsigned int id;
+    glGenTextures(1, &id);
+    return id;
+}
+
+void GLTextureTraits::destroy(unsigned int id) {
+    glDeleteTextures(1, &id);
+}
+
+unsigned int GLFramebufferTraits::create(void) {
+    unsigned int id;
+    glGenFramebuffers(1, &id);
+    return id;
+}
+
+void GLFramebufferTraits::destroy(unsigned int id) {
+    glDeleteFramebuffers(1, &id);
+}
+
+unsigned int GLRenderbufferTraits::create(void) {
+    unsigned int id;
+    glGenRenderbuffers(1, &id);
+    return id;
+}
+
+void GLRenderbufferTraits::destroy(unsigned int id) {
+    glDeleteRenderbuffers(1, &id);
+}
+
+unsigned int GLProgramTraits::create(void) {
+    return glCreateProgram();
+}
+
+void GLProgramTraits::destroy(unsigned int id) {
+    glDeleteProgram(id);
+}
@@ -0,0 +1,85 @@
+#ifndef GL_HANDLE_HH
+#define GL_HANDLE_HH
+
+// Move only owner of a GL object name, deleted when the handle dies.
+// Converts to the raw name so it drops into gl* calls unchanged. Traits provide
+// create (glGen* / glCreate*) and destroy (glDelete*), see the typedefs below.
+template <class Traits>
+class GLHandle {
+public:
+    GLHandle(void) : id{ 0 } {}
+    // takes ownership of an existing name
+    explicit GLHandle(unsigned int name) : id{ name } {}
+    GLHandle(GLHandle&& other) noexcept : id{ other.id } { other.id = 0; }
+    GLHandle& operator=(GLHandle&& other) noexcept {
+        if (this != &other) {
+            reset();
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+    ~GLHandle(void) { reset(); }
+
+    // new object from the traits
+    static GLHandle create(void) { return GLHandle(Traits::create()); }
+
+    operator unsigned int() const { return id; }
+    unsigned int get(void) const { return id; }
+    // deletes the object now
+    void reset(void) {
+        if (id) Traits::destroy(id);
+        id = 0;
+    }
+    // gives up ownership without deleting
+    unsigned int release(void) {
+        unsigned int name = id;
+        id = 0;
+        return name;
+    }
+
+private:
+    unsigned int id;
+};
+
+struct GLBufferTraits {
+    static unsigned int create(void);
+    static void destroy(unsigned int id);
+};
+
+struct GLVertexArrayTraits {
+    static unsigned int create(void);
+    static void destroy(unsigned int id);
+};
+
+struct GLTextureTraits {
+    static unsigned int create(void);
+    static void destroy(unsigned int id);
+};
+
+struct GLFramebufferTraits {
+    static unsigned int create(void);
+    static void destroy(unsigned int id);
+};
+
+struct GLRenderbufferTraits {
+    static unsigned int create(void);
+    static void destroy(unsigned int id);
+};
+
+// programs are made by the shader code, create is only for completeness
+struct GLProgramTraits {
+    static unsigned int create(void);
+    static void destroy(unsigned int id);
+};
+
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLTextureTraits> GLTexture;
+typedef GLHandle<GLFramebufferTraits> GLFramebuffer;
+typedef GLHandle<GLRenderbufferTraits> GLRenderbuffer;
+typedef GLHandle<GLProgramTraits> GLProgram;
+
+#endif
@@ -10,7 +10,6 @@ const double pi = 3.14159265358979323846;
 // TODO //
 //////////
 //
-// Compute dual shapes
 // Normalize Polygon size
 // Allow extrusion offsets
 // Allow variable layer size in spheres and layer offsets
@@ -1,5 +1,8 @@
 #include "GeometryOld.h"
 #include "Geometry.h"
+#include "Triangulation.h"
+#include "NormalGeneration.h"
+#include "TextureAtlas.h"
 
 #include <glad/glad.h>
 
@@ -25,11 +28,12 @@ std::vector<unsigned int> wireFrameDecomp_RP_Limited(size_t vs_size);
 /// Shape Definitions ///
 /////////////////////////
 
-Shape::Shape(void) {
+Shape::Shape(void) :
+    VAO{ GLVertexArray::create() },
+    EBO{ GLBuffer::create() },
+    VBO{ GLBuffer::create() }
+{
     decomp = Decomp_type::TRI;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
 }
 
 void Shape::generateColorData(void) {
@@ -76,6 +80,16 @@ void Shape::generateTexCoords(void) {
     texcoords = tmp;
 }
 
+void Shape::generateNormals(void) {
+    normals = ::generateNormals(vertices, indices);
+}
+
+bool Shape::remapTexCoords(const AtlasRegion& region) {
+    if (!texCoordsInUnitSquare(texcoords)) return false;
+    ::remapTexCoords(texcoords, region);
+    return true;
+}
+
 void Shape::sendVertexData(void) {
     glBindVertexArray(VAO);
 
@@ -127,7 +141,7 @@ void Shape::sendVertexData(void) {
 
 void Shape::initalizeInstancing(size_t instances) {
     glBindVertexArray(VAO);
-    glGenBuffers(1, &instanceVBO);
+    instanceVBO = GLBuffer::create();
 
     glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * instances, 0, GL_DYNAMIC_DRAW);
@@ -178,13 +192,6 @@ void Shape::drawInstanced(size_t instances) {
     glBindVertexArray(0);
 }
 
-Shape::~Shape(void) {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteBuffers(1, &instanceVBO);
-}
-
 ////////////////////////////
 /// 2D Shape Definitions ///
 ////////////////////////////
@@ -231,6 +238,15 @@ RegularPolygon::RegularPolygon(size_t n_sides, float circ_radius) {
     sendVertexData();
 }
 
+SimplePolygon::SimplePolygon(const std::vector<float>& outline, const std::vector<std::vector<float>>& holes) {
+    vertices = concatenateContours(outline, holes);
+    indices = triangulatePolygon(outline, holes);
+    generateColorData();
+    generateTexCoords();
+    generateNormals();
+    sendVertexData();
+}
+
 ////////////////////////////
 /// 3D Shape Definitions ///
 ////////////////////////////
@@ -315,7 +331,6 @@ Simplex::Simplex(float l) {
     vertices = createCone(3,1,l);
 }
 
-void Simplex::generateNormals(void) {};
 
 ///////////////////////////////
 /// Geometry Helper Methods ///
@@ -424,6 +439,7 @@ std::vector<float> createRegularPolygon(size_t n_sides, float circ_radius) {
 
 */
 
+// fan about vertex 0, only valid for convex polygons. See triangulatePolygon for everything else
 std::vector<unsigned int> trianglularDecomp_2D(size_t vs_size) {
     std::vector<unsigned int> indices(vs_size - 6);
     for (size_t i = 0; i < indices.size(); i++) {
@@ -1,10 +1,14 @@
 #ifndef GEOMETRY_O_HH
 #define GEOMETRY_O_HH
 
+#include "GLHandle.h"
+
 #include <glm/glm/glm.hpp>
 
 #include <vector>
 
+struct AtlasRegion;
+
 enum class Triangle_type {
 	SSS,
 	SSA,
@@ -29,12 +33,13 @@ enum class Decomp_type {
 class Shape {
 public:
 	// vertex array object - reference to vertex attribute pointers
-	unsigned int VAO;
+	GLVertexArray VAO;
 	// element buffer object - reference to index draw order
-	unsigned int EBO;
+	GLBuffer EBO;
 	// vertex buffer object - reference to vertex data in GPU
-	unsigned int VBO;
-	unsigned int instanceVBO;
+	GLBuffer VBO;
+	// created by initalizeInstancing
+	GLBuffer instanceVBO;
 	Decomp_type decomp;
 	std::vector<unsigned int> indices;
 	std::vector<float> vertices;
@@ -46,14 +51,16 @@ public:
 
 	void generateColorData(void);
 	virtual void generateTexCoords(void);
-	virtual void generateNormals(void) = 0;
+	// smooth normals from the index buffer, see NormalGeneration.h
+	virtual void generateNormals(void);
+	// moves the texcoords into region of a TextureAtlas, call before sendVertexData.
+	// false and unchanged if they leave [0, 1], the shape then needs its own texture
+	bool remapTexCoords(const AtlasRegion& region);
 	void sendVertexData(void);
 	void sendInstancedData(const std::vector<glm::mat4>& models);
 	void initalizeInstancing(size_t instances);
 	void draw(void);
 	void drawInstanced(size_t instances);
-
-	~Shape(void);
 };
 
 // abstract 2D shape class
@@ -78,6 +85,12 @@ public:
 	RegularPolygon(size_t n_sides, float circ_radius);
 };
 
+// arbitrary simple polygon, concave outlines and holes are triangulated by triangulatePolygon
+class SimplePolygon : public Shape_2D {
+public:
+	SimplePolygon(const std::vector<float>& outline, const std::vector<std::vector<float>>& holes = {});
+};
+
 // 3D shape classes
 class RectangularPrism : public Shape {
 public:
@@ -96,7 +109,6 @@ public:
 class Simplex : public Shape {
 public:
 	Simplex(float l);
-	void generateNormals(void);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "HalfEdge.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+
+/////////////////////////////
+/// Half-Edge Definitions ///
+/////////////////////////////
+
+HalfEdgeMesh::HalfEdgeMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices) :
+    positions{ vertices }
+{
+    std::vector<unsigned int> faceSizes(indices.size() / 3, 3);
+    build(indices, faceSizes);
+}
+
+HalfEdgeMesh::HalfEdgeMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& faceSizes) :
+    positions{ vertices }
+{
+    build(indices, faceSizes);
+}
+
+void HalfEdgeMesh::build(const std::vector<unsigned int>& indices, const std::vector<unsigned int>& faceSizes) {
+    size_t n_vs = positions.size() / 3;
+    vertexEdge.assign(n_vs, INVALID);
+    faceEdge.clear();
+    edges.clear();
+    edges.reserve(2 * indices.size());
+    faceEdge.reserve(faceSizes.size());
+
+    // directed edge (origin, dest) -> half-edge, used once to pair twins in linear time
+    std::unordered_map<unsigned long long, unsigned int> directed;
+    directed.reserve(indices.size());
+    size_t non_manifold = 0;
+
+    size_t start = 0;
+    for (size_t f = 0; f < faceSizes.size(); start += faceSizes[f], f++) {
+        unsigned int n = faceSizes[f];
+        // skip degenerate faces, they have no well defined adjacency
+        bool degenerate = n < 3;
+        for (unsigned int k = 0; k < n && !degenerate; k++) {
+            degenerate = indices[start + k] == indices[start + (k + 1) % n];
+        }
+        if (degenerate) continue;
+
+        unsigned int first = edges.size();
+        unsigned int fid = faceEdge.size();
+        for (unsigned int k = 0; k < n; k++) {
+            unsigned int a = indices[start + k];
+            unsigned int b = indices[start + (k + 1) % n];
+            edges.push_back({ a, INVALID, first + (k + 1) % n, first + (k + n - 1) % n, fid });
+            unsigned long long key = (static_cast<unsigned long long>(a) << 32) | b;
+            if (!directed.emplace(key, first + k).second) non_manifold++;
+            vertexEdge[a] = first + k;
+        }
+        faceEdge.push_back(first);
+    }
+
+    // pair twins
+    size_t interior = edges.size();
+    for (unsigned int h = 0; h < interior; h++) {
+        if (edges[h].twin != INVALID) continue;
+        unsigned long long key = (static_cast<unsigned long long>(dest(h)) << 32) | edges[h].origin;
+        auto itr = directed.find(key);
+        if (itr != directed.end() && edges[itr->second].twin == INVALID) {
+            edges[h].twin = itr->second;
+            edges[itr->second].twin = h;
+        }
+    }
+
+    // close boundaries with face-less half-edges running opposite to the unpaired ones
+    for (unsigned int h = 0; h < interior; h++) {
+        if (edges[h].twin != INVALID) continue;
+        unsigned int b = edges.size();
+        edges.push_back({ dest(h), h, INVALID, INVALID, INVALID });
+        edges[h].twin = b;
+    }
+    for (unsigned int b = interior; b < edges.size(); b++) {
+        // b runs dest(h) -> origin(h) and continues with the boundary edge leaving origin(h) in the same fan of faces.
+        // a vertex can have several of those (a bowtie), so rotate from h until the faces run out
+        unsigned int e = edges[b].twin;
+        size_t guard = 0;
+        while (edges[edges[edges[e].prev].twin].face != INVALID && ++guard < edges.size()) e = edges[edges[e].prev].twin;
+        unsigned int n = edges[edges[e].prev].twin;
+        edges[b].next = n;
+        edges[n].prev = b;
+    }
+
+    // a bowtie vertex gets a copy per extra fan, rotating about a vertex then reaches all its half-edges
+    std::vector<bool> seen(n_vs, false);
+    size_t split = 0;
+    for (unsigned int b = interior; b < edges.size(); b++) {
+        unsigned int w = edges[b].origin;
+        if (!seen[w]) {
+            seen[w] = true;
+            vertexEdge[w] = b;
+            continue;
+        }
+        unsigned int copy = vertexEdge.size();
+        float x = positions[3 * w], y = positions[3 * w + 1], z = positions[3 * w + 2];
+        positions.insert(positions.end(), { x, y, z });
+        vertexEdge.push_back(b);
+        unsigned int e = b;
+        size_t guard = 0;
+        do {
+            edges[e].origin = copy;
+            e = rotate(e);
+        } while (e != b && ++guard < edges.size());
+        split++;
+    }
+
+    if (non_manifold) std::cout << "HalfEdgeMesh: " << non_manifold << " non-manifold edges ignored\n";
+    if (split) std::cout << "HalfEdgeMesh: " << split << " non-manifold vertices split\n";
+}
+
+bool HalfEdgeMesh::isBoundaryVertex(unsigned int v) const {
+    unsigned int h0 = vertexEdge[v];
+    if (h0 == INVALID) return false;
+    unsigned int h = h0;
+    size_t guard = 0;
+    do {
+        if (edges[h].face == INVALID) return true;
+        h = rotate(h);
+    } while (h != h0 && ++guard < edges.size());
+    return false;
+}
+
+size_t HalfEdgeMesh::valence(unsigned int v) const {
+    return vertexNeighbors(v).size();
+}
+
+std::vector<unsigned int> HalfEdgeMesh::vertexNeighbors(unsigned int v) const {
+    std::vector<unsigned int> ns;
+    unsigned int h0 = vertexEdge[v];
+    if (h0 == INVALID) return ns;
+    unsigned int h = h0;
+    size_t guard = 0;
+    do {
+        ns.push_back(dest(h));
+        h = rotate(h);
+    } while (h != h0 && ++guard < edges.size());
+    return ns;
+}
+
+std::vector<unsigned int> HalfEdgeMesh::vertexFaces(unsigned int v) const {
+    std::vector<unsigned int> fs;
+    unsigned int h0 = vertexEdge[v];
+    if (h0 == INVALID) return fs;
+    unsigned int h = h0;
+    size_t guard = 0;
+    do {
+        if (edges[h].face != INVALID) fs.push_back(edges[h].face);
+        h = rotate(h);
+    } while (h != h0 && ++guard < edges.size());
+    return fs;
+}
+
+std::vector<unsigned int> HalfEdgeMesh::faceVertices(unsigned int f) const {
+    std::vector<unsigned int> vs;
+    unsigned int h0 = faceEdge[f];
+    if (h0 == INVALID) return vs;
+    unsigned int h = h0;
+    do {
+        vs.push_back(edges[h].origin);
+        h = edges[h].next;
+    } while (h != h0);
+    return vs;
+}
+
+std::vector<unsigned int> HalfEdgeMesh::faceNeighbors(unsigned int f) const {
+    std::vector<unsigned int> fs;
+    unsigned int h0 = faceEdge[f];
+    if (h0 == INVALID) return fs;
+    unsigned int h = h0;
+    do {
+        unsigned int g = edges[edges[h].twin].face;
+        if (g != INVALID) fs.push_back(g);
+        h = edges[h].next;
+    } while (h != h0);
+    return fs;
+}
+
+HalfEdgeMesh HalfEdgeMesh::dual(void) const {
+    HalfEdgeMesh d;
+    // one dual vertex per live face, placed at the centroid
+    std::vector<unsigned int> faceMap(faceEdge.size(), INVALID);
+    unsigned int count = 0;
+    for (unsigned int f = 0; f < faceEdge.size(); f++) {
+        if (faceEdge[f] == INVALID) continue;
+        float c[3]{ 0,0,0 };
+        unsigned int h = faceEdge[f];
+        size_t n = 0;
+        do {
+            for (size_t i = 0; i < 3; i++) c[i] += positions[3 * edges[h].origin + i];
+            n++;
+            h = edges[h].next;
+        } while (h != faceEdge[f]);
+        for (size_t i = 0; i < 3; i++) d.positions.push_back(c[i] / n);
+        faceMap[f] = count++;
+    }
+    // one dual face per interior vertex, rotating counter clockwise keeps the primal winding
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> faceSizes;
+    indices.reserve(edges.size());
+    for (unsigned int v = 0; v < vertexEdge.size(); v++) {
+        if (vertexEdge[v] == INVALID || isBoundaryVertex(v)) continue;
+        unsigned int h = vertexEdge[v];
+        unsigned int n = 0;
+        do {
+            indices.push_back(faceMap[edges[h].face]);
+            n++;
+            h = rotate(h);
+        } while (h != vertexEdge[v] && n < edges.size());
+        faceSizes.push_back(n);
+    }
+    d.build(indices, faceSizes);
+    return d;
+}
+
+bool HalfEdgeMesh::collapseEdge(unsigned int h) {
+    if (h >= edges.size() || edges[h].origin == INVALID) return false;
+    unsigned int t = edges[h].twin;
+    unsigned int u = edges[h].origin;
+    unsigned int v = edges[t].origin;
+    unsigned int sides[2]{ h, t };
+
+    // only triangles can lose an edge without becoming a different polygon
+    size_t n_faces = 0;
+    for (unsigned int e : sides) {
+        if (edges[e].face == INVALID) continue;
+        if (edges[edges[edges[e].next].next].next != e) return false;
+        // a triangle hanging on two boundary edges would degenerate
+        if (edges[edges[edges[e].next].twin].face == INVALID && edges[edges[edges[e].prev].twin].face == INVALID) return false;
+        n_faces++;
+    }
+    // interior edge between two boundary vertices would pinch the surface
+    if (!isBoundaryEdge(h) && isBoundaryVertex(u) && isBoundaryVertex(v)) return false;
+
+    // link condition: u and v may only share the vertices opposite the collapsed edge
+    std::vector<unsigned int> nu = vertexNeighbors(u);
+    std::vector<unsigned int> nv = vertexNeighbors(v);
+    std::sort(nu.begin(), nu.end());
+    std::sort(nv.begin(), nv.end());
+    std::vector<unsigned int> common;
+    std::set_intersection(nu.begin(), nu.end(), nv.begin(), nv.end(), std::back_inserter(common));
+    if (common.size() != n_faces) return false;
+
+    // gather v's outgoing half-edges before the neighbourhood changes
+    std::vector<unsigned int> outV;
+    unsigned int o = vertexEdge[v];
+    size_t guard = 0;
+    do {
+        outV.push_back(o);
+        o = rotate(o);
+    } while (o != vertexEdge[v] && ++guard < edges.size());
+
+    for (size_t i = 0; i < 3; i++) positions[3 * u + i] = (positions[3 * u + i] + positions[3 * v + i]) / 2;
+
+    for (unsigned int e : sides) {
+        if (edges[e].face != INVALID) {
+            // e: u->v, en: v->w, ep: w->u. Their outer twins become twins of each other
+            unsigned int en = edges[e].next;
+            unsigned int ep = edges[e].prev;
+            unsigned int a = edges[en].twin;
+            unsigned int b = edges[ep].twin;
+            edges[a].twin = b;
+            edges[b].twin = a;
+            vertexEdge[edges[ep].origin] = a;
+            vertexEdge[u] = b;
+            faceEdge[edges[e].face] = INVALID;
+            edges[en].origin = INVALID;
+            edges[ep].origin = INVALID;
+        }
+        else {
+            // boundary half-edge, unlink it from its loop
+            edges[edges[e].prev].next = edges[e].next;
+            edges[edges[e].next].prev = edges[e].prev;
+            vertexEdge[u] = edges[e].next;
+        }
+    }
+    edges[h].origin = INVALID;
+    edges[t].origin = INVALID;
+
+    // v's surviving half-edges now leave u
+    for (unsigned int e : outV) {
+        if (edges[e].origin != INVALID) edges[e].origin = u;
+    }
+    if (edges[vertexEdge[u]].origin != u) {
+        for (unsigned int e : outV) {
+            if (edges[e].origin == u) {
+                vertexEdge[u] = e;
+                break;
+            }
+        }
+    }
+    vertexEdge[v] = INVALID;
+    return true;
+}
+
+std::vector<std::vector<unsigned int>> HalfEdgeMesh::boundaryLoops(void) const {
+    std::vector<std::vector<unsigned int>> loops;
+    std::vector<bool> visited(edges.size(), false);
+    for (unsigned int h = 0; h < edges.size(); h++) {
+        if (visited[h] || edges[h].face != INVALID || edges[h].origin == INVALID) continue;
+        std::vector<unsigned int> loop;
+        unsigned int b = h;
+        do {
+            visited[b] = true;
+            loop.push_back(edges[b].origin);
+            b = edges[b].next;
+        } while (b != h && !visited[b]);
+        loops.push_back(loop);
+    }
+    return loops;
+}
+
+void HalfEdgeMesh::exportBuffers(std::vector<float>& vertices, std::vector<unsigned int>& indices) const {
+    // drop removed and isolated vertices
+    std::vector<unsigned int> remap(vertexEdge.size(), INVALID);
+    vertices.clear();
+    vertices.reserve(positions.size());
+    unsigned int count = 0;
+    for (unsigned int v = 0; v < vertexEdge.size(); v++) {
+        if (vertexEdge[v] == INVALID) continue;
+        vertices.insert(vertices.end(), positions.begin() + 3 * v, positions.begin() + 3 * v + 3);
+        remap[v] = count++;
+    }
+    // fan triangulate each face, the same decomposition trianglularDecomp_2D uses
+    indices.clear();
+    indices.reserve(edges.size());
+    for (unsigned int f = 0; f < faceEdge.size(); f++) {
+        unsigned int h0 = faceEdge[f];
+        if (h0 == INVALID) continue;
+        unsigned int h = edges[h0].next;
+        while (edges[h].next != h0) {
+            indices.push_back(remap[edges[h0].origin]);
+            indices.push_back(remap[edges[h].origin]);
+            indices.push_back(remap[edges[edges[h].next].origin]);
+            h = edges[h].next;
+        }
+    }
+}
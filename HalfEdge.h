@@ -0,0 +1,75 @@
+#ifndef HALF_EDGE_HH
+#define HALF_EDGE_HH
+
+#include <vector>
+
+// Index based half-edge mesh
+// every reference is an index into one of the arrays below so the structure can be
+// copied, stored, and rebuilt without pointer fix ups. Boundaries are closed with
+// explicit half-edges whose face is INVALID so every half-edge always has a twin.
+// Vertices where separate fans of faces touch (bowties) are split into one vertex per fan,
+// so numVertices can exceed the input's and the positions gain the copies.
+class HalfEdgeMesh {
+public:
+	static constexpr unsigned int INVALID = 0xFFFFFFFF;
+
+	struct HalfEdge {
+		unsigned int origin;
+		unsigned int twin;
+		unsigned int next;
+		unsigned int prev;
+		// INVALID for boundary half-edges
+		unsigned int face;
+	};
+
+	// xyz positions, same packing as the generators in Geometry.h
+	std::vector<float> positions;
+	std::vector<HalfEdge> edges;
+	// one outgoing half-edge per vertex, INVALID if the vertex was removed or is isolated
+	std::vector<unsigned int> vertexEdge;
+	// one half-edge per face, INVALID if the face was removed
+	std::vector<unsigned int> faceEdge;
+
+	// build from a triangle list (Shape::vertices and Shape::indices)
+	HalfEdgeMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+	// build from a polygon list, faceSizes[i] consecutive indices make up face i
+	HalfEdgeMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& faceSizes);
+
+	// O(1) adjacency
+	unsigned int origin(unsigned int h) const { return edges[h].origin; }
+	unsigned int dest(unsigned int h) const { return edges[edges[h].next].origin; }
+	unsigned int twin(unsigned int h) const { return edges[h].twin; }
+	unsigned int next(unsigned int h) const { return edges[h].next; }
+	unsigned int prev(unsigned int h) const { return edges[h].prev; }
+	unsigned int face(unsigned int h) const { return edges[h].face; }
+	// next outgoing half-edge counter clockwise about origin(h)
+	unsigned int rotate(unsigned int h) const { return edges[edges[h].prev].twin; }
+	bool isBoundaryEdge(unsigned int h) const { return edges[h].face == INVALID || edges[edges[h].twin].face == INVALID; }
+	bool isBoundaryVertex(unsigned int v) const;
+
+	// O(valence) neighbourhood queries
+	size_t valence(unsigned int v) const;
+	std::vector<unsigned int> vertexNeighbors(unsigned int v) const;
+	std::vector<unsigned int> vertexFaces(unsigned int v) const;
+	std::vector<unsigned int> faceVertices(unsigned int f) const;
+	std::vector<unsigned int> faceNeighbors(unsigned int f) const;
+
+	size_t numVertices(void) const { return vertexEdge.size(); }
+	size_t numFaces(void) const { return faceEdge.size(); }
+
+	// dual mesh: a vertex at every face centroid and a face around every interior vertex
+	HalfEdgeMesh dual(void) const;
+	// merges dest(h) into origin(h) at the edge midpoint, returns false if the collapse would break manifoldness
+	bool collapseEdge(unsigned int h);
+	// closed loops of boundary vertices in traversal order
+	std::vector<std::vector<unsigned int>> boundaryLoops(void) const;
+
+	// compacts removed elements and fan triangulates every face into buffers Shape::sendVertexData consumes
+	void exportBuffers(std::vector<float>& vertices, std::vector<unsigned int>& indices) const;
+
+private:
+	HalfEdgeMesh(void) {}
+	void build(const std::vector<unsigned int>& indices, const std::vector<unsigned int>& faceSizes);
+};
+
+#endif
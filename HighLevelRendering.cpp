@@ -2,11 +2,11 @@
 
 #include <glad/glad.h>
 
-GPUdata::GPUdata(void) {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-}
+GPUdata::GPUdata(void) :
+    VAO{ GLVertexArray::create() },
+    EBO{ GLBuffer::create() },
+    VBO{ GLBuffer::create() }
+{}
 
 void GPUdata::sendToGPU(size_t size, float* data) {
     glBindVertexArray(VAO);
@@ -20,10 +20,4 @@ void GPUdata::render(size_t num_points) {
     glBindVertexArray(VAO);
     glDrawArrays(GL_POINTS, 0, num_points);
     glBindVertexArray(0);
-}
-
-GPUdata::~GPUdata(void) {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
 }
\ No newline at end of file
@@ -1,18 +1,20 @@
 #ifndef HLR_HH
 #define HLR_HH
 
+#include "GLHandle.h"
+
+#include <cstddef>
+
 class GPUdata {
 public:
-	unsigned int VAO;
-	unsigned int EBO;
-	unsigned int VBO;
+	GLVertexArray VAO;
+	GLBuffer EBO;
+	GLBuffer VBO;
 
 	GPUdata(void);
 
 	void sendToGPU(size_t size, float* data);
 	void render(size_t num_points);
-
-	~GPUdata(void);
 };
 
 #endif
\ No newline at end of file
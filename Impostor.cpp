@@ -0,0 +1,288 @@
+#include "Impostor.h"
+#include "ModelCache.h"
+#include "VertexFormat.h"
+
+#include <glad/glad.h>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+const char IMPOSTOR_MAGIC[4] = { 'I', 'M', 'P', 'S' };
+
+// up axis of the captures, must match the vertex shader in Impostor.h
+glm::vec3 viewUp(const glm::vec3& dir) {
+    return std::fabs(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// sphere around the meshes as their nodes place them
+void modelBounds(Model& model, glm::vec3& center, float& radius) {
+    model.scene.update();
+    std::vector<glm::vec3> centers(model.meshes.size());
+    std::vector<float> radii(model.meshes.size());
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        int node = i < model.meshNodes.size() ? model.meshNodes[i] : -1;
+        glm::mat4 m = node < 0 ? glm::mat4(1.0f) : model.scene.world(node);
+        float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        centers[i] = glm::vec3(m * glm::vec4(model.meshes[i].center, 1.0f));
+        radii[i] = model.meshes[i].radius * scale;
+        lo = glm::min(lo, centers[i] - glm::vec3(radii[i]));
+        hi = glm::max(hi, centers[i] + glm::vec3(radii[i]));
+    }
+    center = 0.5f * (lo + hi);
+    radius = 0;
+    for (size_t i = 0; i < centers.size(); i++) radius = std::max(radius, glm::length(centers[i] - center) + radii[i]);
+}
+
+bool impostorHash(const std::string& sourcePath, int views, int tile, uint64_t& hash) {
+    if (!hashFile(sourcePath, hash)) return false;
+    int settings[2] = { views, tile };
+    hash = hashBytes((const unsigned char*)settings, sizeof(settings), hash);
+    return true;
+}
+
+Impostor::Impostor(float switchDistance) :
+    grid{ 0 },
+    tileSize{ 0 },
+    center{ 0.0f },
+    radius{ 0 },
+    distance{ switchDistance }
+{}
+
+bool Impostor::build(Model& model, const std::string& sourcePath, Shader& captureShader, int views, int tile) {
+    uint64_t hash;
+    if (!impostorHash(sourcePath, views, tile, hash)) {
+        std::cout << "ERROR::IMPOSTOR:: can't read " << sourcePath << "\n";
+        return false;
+    }
+    std::string path = sourcePath + IMPOSTOR_EXTENSION;
+    if (load(path, hash)) return true;
+    if (!capture(model, captureShader, views, tile)) return false;
+    save(path, hash);
+    return true;
+}
+
+bool Impostor::capture(Model& model, Shader& captureShader, int views, int tile) {
+    if (views < 2 || tile < 1 || model.meshes.empty()) {
+        std::cout << "ERROR::IMPOSTOR:: nothing to capture\n";
+        return false;
+    }
+    grid = views;
+    tileSize = tile;
+    modelBounds(model, center, radius);
+    if (!(radius > 0)) {
+        std::cout << "ERROR::IMPOSTOR:: model has no extent\n";
+        return false;
+    }
+    int size = grid * tileSize;
+    GLTexture newColor = createAtlas(nullptr);
+    GLTexture newNormalDepth = createAtlas(nullptr);
+    GLRenderbuffer depth = GLRenderbuffer::create();
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    int previous, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    bool scissor = glIsEnabled(GL_SCISSOR_TEST);
+    bool depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+    GLFramebuffer framebuffer = GLFramebuffer::create();
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, newColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, newNormalDepth, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    unsigned int targets[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, targets);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+        // empty texels: transparent, facing the capture, at the far plane
+        const float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const float clearNormalDepth[4] = { 0.5f, 0.5f, 1.0f, 1.0f };
+        glDisable(GL_SCISSOR_TEST);
+        glEnable(GL_DEPTH_TEST);
+        glViewport(0, 0, size, size);
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+        glClearBufferfv(GL_COLOR, 1, clearNormalDepth);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        captureShader.set();
+        // the sphere fills every tile, near and far plane touch it
+        captureShader.setUniform_Mat4("projection", glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius));
+        for (int y = 0; y < grid; y++) {
+            for (int x = 0; x < grid; x++) {
+                glm::vec3 dir = viewDirection(x, y);
+                glViewport(x * tileSize, y * tileSize, tileSize, tileSize);
+                captureShader.setUniform_Mat4("view", glm::lookAt(center + dir * radius, center, viewUp(dir)));
+                model.Draw(captureShader, glm::mat4(1.0f));
+            }
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (scissor) glEnable(GL_SCISSOR_TEST);
+    if (!depthTest) glDisable(GL_DEPTH_TEST);
+    if (!complete) {
+        std::cout << "ERROR::IMPOSTOR:: capture framebuffer incomplete\n";
+        return false;
+    }
+    color = std::move(newColor);
+    normalDepth = std::move(newNormalDepth);
+    if (!VAO) setupQuad();
+    return true;
+}
+
+bool Impostor::save(const std::string& path, uint64_t sourceHash) const {
+    if (!valid()) return false;
+    size_t bytes = (size_t)grid * tileSize * grid * tileSize * 4;
+    std::vector<unsigned char> pixels(2 * bytes);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, normalDepth);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data() + bytes);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    ImpostorHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, IMPOSTOR_MAGIC, 4);
+    header.version = IMPOSTOR_VERSION;
+    header.sourceHash = sourceHash;
+    header.grid = grid;
+    header.tileSize = tileSize;
+    header.center[0] = center.x;
+    header.center[1] = center.y;
+    header.center[2] = center.z;
+    header.radius = radius;
+
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        std::cout << "ERROR::IMPOSTOR:: can't write " << path << "\n";
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 && std::fwrite(pixels.data(), 1, pixels.size(), f) == pixels.size();
+    ok = std::fclose(f) == 0 && ok;
+    std::remove(path.c_str());
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cout << "ERROR::IMPOSTOR:: failed writing " << path << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Impostor::load(const std::string& path, uint64_t sourceHash) {
+    MappedFile file(path);
+    if (!file.data || file.size < sizeof(ImpostorHeader)) return false;
+    const ImpostorHeader* h = (const ImpostorHeader*)file.data;
+    if (std::memcmp(h->magic, IMPOSTOR_MAGIC, 4) != 0 || h->version != IMPOSTOR_VERSION || h->sourceHash != sourceHash) return false;
+    if (h->grid < 2 || h->tileSize < 1 || !(h->radius > 0)) return false;
+    uint64_t side = (uint64_t)h->grid * h->tileSize;
+    if (file.size != sizeof(ImpostorHeader) + 2 * side * side * 4) return false;
+
+    grid = h->grid;
+    tileSize = h->tileSize;
+    center = glm::vec3(h->center[0], h->center[1], h->center[2]);
+    radius = h->radius;
+    const unsigned char* pixels = file.data + sizeof(ImpostorHeader);
+    color = createAtlas(pixels);
+    normalDepth = createAtlas(pixels + side * side * 4);
+    if (!VAO) setupQuad();
+    return true;
+}
+
+glm::vec3 Impostor::viewDirection(int x, int y) const {
+    float scale = 2.0f / (grid - 1);
+    return octDecode(glm::vec2(x * scale - 1.0f, y * scale - 1.0f));
+}
+
+glm::ivec2 Impostor::nearestView(const glm::vec3& direction) const {
+    glm::vec2 e = octEncode(direction);
+    float last = (float)(grid - 1);
+    return glm::ivec2((int)std::round((e.x * 0.5f + 0.5f) * last), (int)std::round((e.y * 0.5f + 0.5f) * last));
+}
+
+bool Impostor::distant(const glm::vec3& camera, const glm::mat4& model) const {
+    glm::vec3 c = glm::vec3(model * glm::vec4(center, 1.0f));
+    return glm::dot(camera - c, camera - c) > distance * distance;
+}
+
+void Impostor::partition(const std::vector<glm::mat4>& models, const glm::vec3& camera, std::vector<glm::mat4>& nearModels, std::vector<glm::mat4>& farModels) const {
+    nearModels.clear();
+    farModels.clear();
+    for (const glm::mat4& m : models) {
+        if (distant(camera, m)) farModels.push_back(m);
+        else nearModels.push_back(m);
+    }
+}
+
+void Impostor::Draw(Shader& shader, const glm::mat4& model, const glm::vec3& camera) {
+    if (!valid()) return;
+    setUniforms(shader, camera);
+    shader.setUniform_Mat4("model", model);
+    glBindVertexArray(VAO);
+    InstanceBuffer::detach();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Impostor::DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t count, const glm::vec3& camera, size_t first) {
+    if (!valid() || !count) return;
+    setUniforms(shader, camera);
+    shader.setUniform_Mat4("model", glm::mat4(1.0f));
+    glBindVertexArray(VAO);
+    instances.attach(first);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Impostor::setupQuad(void) {
+    const float corners[8] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    VAO = GLVertexArray::create();
+    VBO = GLBuffer::create();
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Impostor::setUniforms(Shader& shader, const glm::vec3& camera) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, color);
+    shader.setUniform_Int("impostorColor", 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalDepth);
+    shader.setUniform_Int("impostorNormalDepth", 1);
+    shader.setUniform_Vec3("cameraPosition", camera);
+    shader.setUniform_Vec3("impostorCenter", center);
+    shader.setUniform_Float("impostorRadius", radius);
+    shader.setUniform_Int("impostorGrid", grid);
+}
+
+GLTexture Impostor::createAtlas(const unsigned char* pixels) const {
+    int size = grid * tileSize;
+    GLTexture texture = GLTexture::create();
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    // no mipmaps, they would bleed neighbouring views into each other
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
@@ -0,0 +1,112 @@
+#ifndef IMPOSTOR_HH
+#define IMPOSTOR_HH
+
+#include "GLHandle.h"
+#include "InstanceBuffer.h"
+#include "Model.h"
+#include "Shader.h"
+
+#include <glm/glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define IMPOSTOR_EXTENSION ".impostor"
+#define IMPOSTOR_VERSION 1
+// views per side of the octahedral grid and pixels per side of a view
+#define IMPOSTOR_GRID 8
+#define IMPOSTOR_TILE_SIZE 128
+
+// layout: header | color atlas | normal/depth atlas, both RGBA8 rows bottom up
+struct ImpostorHeader {
+    char magic[4];
+    uint32_t version;
+    // FNV-1a of the source file's contents, mixed with grid and tile size
+    uint64_t sourceHash;
+    uint32_t grid;
+    uint32_t tileSize;
+    float center[3];
+    float radius;
+};
+
+// A model captured from grid * grid directions into two atlases, drawn as one quad per instance far away.
+// The directions sit on the vertices of an octahedral grid over the whole sphere, so the view for any direction
+// is found by rounding its octahedral encoding (octEncode in VertexFormat.h), nearest in that encoding.
+//
+// Capturing draws the model with a caller supplied shader under an orthographic projection around its bounding
+// sphere, once per tile. It gets "projection" and "view" and writes two targets:
+//     layout (location = 0) out vec4 color;        // alpha is coverage
+//     layout (location = 1) out vec4 normalDepth;  // vec4(normalize(normal) * 0.5 + 0.5, gl_FragCoord.z)
+//
+// Drawing uses a quad at location 0 (corners in [-1, 1]) plus the InstanceBuffer inputs. The vertex shader turns the
+// quad towards the nearest captured view:
+//     uniform vec3 cameraPosition, impostorCenter;
+//     uniform float impostorRadius;
+//     uniform int impostorGrid;
+//     mat4 world = instanceModel * model;
+//     // rotation and uniform scale only, so the transpose undoes the rotation
+//     vec3 toCamera = normalize(transpose(mat3(world)) * (cameraPosition - (world * vec4(impostorCenter, 1.0)).xyz));
+//     vec2 e = toCamera.xy / (abs(toCamera.x) + abs(toCamera.y) + abs(toCamera.z));
+//     if (toCamera.z < 0.0) e = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+//     vec2 cell = round((e * 0.5 + 0.5) * float(impostorGrid - 1));
+//     vec3 dir = octDecode(cell / float(impostorGrid - 1) * 2.0 - 1.0);
+//     vec3 up = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+//     vec3 right = normalize(cross(up, dir));
+//     up = cross(dir, right);
+//     gl_Position = projection * view * world * vec4(impostorCenter + (corner.x * right + corner.y * up) * impostorRadius, 1.0);
+//     uv = (cell + corner * 0.5 + 0.5) / float(impostorGrid);
+// and the fragment shader samples impostorColor and impostorNormalDepth at uv, discarding where alpha is 0.
+class Impostor {
+public:
+    GLTexture color;
+    GLTexture normalDepth;
+    int grid;
+    int tileSize;
+    // bounding sphere of the model in its own space
+    glm::vec3 center;
+    float radius;
+    // camera distance from the sphere's center beyond which the impostor replaces the model
+    float distance;
+
+    Impostor(float switchDistance = 100.0f);
+
+    // loads the atlas cached next to sourcePath, or captures model and caches the result. false if neither worked
+    bool build(Model& model, const std::string& sourcePath, Shader& captureShader, int views = IMPOSTOR_GRID, int tile = IMPOSTOR_TILE_SIZE);
+    // renders the atlases, needs the GL context. Restores the framebuffer and viewport it found
+    bool capture(Model& model, Shader& captureShader, int views = IMPOSTOR_GRID, int tile = IMPOSTOR_TILE_SIZE);
+    // reads the atlases back and writes them, through a temporary file like the model cache
+    bool save(const std::string& path, uint64_t sourceHash) const;
+    // false for a missing, stale or damaged file
+    bool load(const std::string& path, uint64_t sourceHash);
+    bool valid(void) const { return color != 0; }
+
+    // unit direction from the center towards the camera of view (x, y)
+    glm::vec3 viewDirection(int x, int y) const;
+    // view captured closest to a direction in model space
+    glm::ivec2 nearestView(const glm::vec3& direction) const;
+
+    // whether the camera is far enough from a model placed at model to draw the impostor instead
+    bool distant(const glm::vec3& camera, const glm::mat4& model) const;
+    // splits placements into the ones to draw as models and the ones to draw as impostors
+    void partition(const std::vector<glm::mat4>& models, const glm::vec3& camera, std::vector<glm::mat4>& nearModels, std::vector<glm::mat4>& farModels) const;
+
+    // one impostor placed at model, sets the uniforms above besides projection and view
+    void Draw(Shader& shader, const glm::mat4& model, const glm::vec3& camera);
+    // count impostors in one call, placed by the instance transforms with "model" set to identity
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t count, const glm::vec3& camera, size_t first = 0);
+
+private:
+    GLVertexArray VAO;
+    GLBuffer VBO;
+
+    void setupQuad(void);
+    void setUniforms(Shader& shader, const glm::vec3& camera);
+    // the atlas is grid * tileSize pixels on a side
+    GLTexture createAtlas(const unsigned char* pixels) const;
+};
+
+// hash that ties an impostor file to its source and capture settings, false if the source can't be read
+bool impostorHash(const std::string& sourcePath, int views, int tile, uint64_t& hash);
+
+#endif
@@ -0,0 +1,60 @@
+#include "InstanceBuffer.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+InstanceBuffer::InstanceBuffer(void) :
+    VBO{ GLBuffer::create() },
+    count{ 0 },
+    capacity{ 0 },
+    hasAttributes{ false }
+{}
+
+void InstanceBuffer::upload(const std::vector<glm::mat4>& transforms, const std::vector<glm::vec4>& attributes) {
+    if (!attributes.empty() && attributes.size() != transforms.size()) {
+        std::cout << "Instance attributes don't match the transforms: " << attributes.size() << " for " << transforms.size() << "\n";
+        return;
+    }
+    count = transforms.size();
+    hasAttributes = !attributes.empty();
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (count > capacity) capacity = std::max(count, 2 * capacity);
+    // the attribute block starts after capacity transforms so growing is the only thing that moves it
+    glBufferData(GL_ARRAY_BUFFER, capacity * (sizeof(glm::mat4) + sizeof(glm::vec4)), nullptr, GL_STREAM_DRAW);
+    if (count) glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms.data());
+    if (hasAttributes) glBufferSubData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), count * sizeof(glm::vec4), attributes.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::attach(size_t first) const {
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    // a mat4 attribute is four vec4 columns on consecutive locations
+    for (unsigned int c = 0; c < 4; c++) {
+        unsigned int location = INSTANCE_TRANSFORM_LOCATION + c;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(first * sizeof(glm::mat4) + c * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    if (hasAttributes) {
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION);
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(capacity * sizeof(glm::mat4) + first * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION, 1);
+    }
+    else {
+        // a disabled array reads the current value
+        glDisableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION);
+        glVertexAttrib4f(INSTANCE_ATTRIBUTE_LOCATION, 1.0f, 1.0f, 1.0f, 1.0f);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::detach(void) {
+    for (unsigned int c = 0; c < 4; c++) {
+        glDisableVertexAttribArray(INSTANCE_TRANSFORM_LOCATION + c);
+        glVertexAttrib4f(INSTANCE_TRANSFORM_LOCATION + c, c == 0, c == 1, c == 2, c == 3);
+    }
+    glDisableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION);
+    glVertexAttrib4f(INSTANCE_ATTRIBUTE_LOCATION, 1.0f, 1.0f, 1.0f, 1.0f);
+}
@@ -0,0 +1,42 @@
+#ifndef INSTANCE_BUFFER_HH
+#define INSTANCE_BUFFER_HH
+
+#include "GLHandle.h"
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+
+// first of the four locations the instance transform takes, right after the vertex attributes (see VertexFormat.h)
+#define INSTANCE_TRANSFORM_LOCATION 7
+#define INSTANCE_ATTRIBUTE_LOCATION 11
+
+// Per instance streams for instanced draws: a transform and a free vec4 (tint, variation, animation phase...) per
+// instance, as two blocks of one buffer. Instanced vertex shaders read them as
+//     layout (location = 7) in mat4 instanceModel;
+//     layout (location = 11) in vec4 instanceAttribute;
+//     gl_Position = projection * view * instanceModel * model * vec4(aPos, 1.0);
+// where instanceModel places the whole model and the "model" uniform the mesh inside it (its scene graph node).
+// Skinned meshes find the palette of their instance at boneBase + gl_InstanceID, see BonePaletteBuffer.
+class InstanceBuffer {
+public:
+    GLBuffer VBO;
+    // instances in the last upload
+    size_t count;
+    // instances the buffer can hold before it has to grow
+    size_t capacity;
+    // whether the last upload came with attributes, instanceAttribute is (1, 1, 1, 1) otherwise
+    bool hasAttributes;
+
+    InstanceBuffer(void);
+    // attributes is empty or has one entry per transform. Orphans the previous storage like BonePaletteBuffer::upload
+    void upload(const std::vector<glm::mat4>& transforms, const std::vector<glm::vec4>& attributes = {});
+    // points the instance attributes of the bound VAO at the instances from first on.
+    // GL 3.3 has no base instance, so drawing a sub range moves the pointers instead
+    void attach(size_t first = 0) const;
+    // turns the instance arrays of the bound VAO off for a plain draw, instanceModel then reads the identity
+    // and instanceAttribute (1, 1, 1, 1)
+    static void detach(void);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "MatrixMath.h"
+
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define MATRIX_SSE
+#endif
+
+void multiply(const float* a, const float* b, float* out) {
+#ifdef MATRIX_SSE
+    __m128 c0 = _mm_loadu_ps(a);
+    __m128 c1 = _mm_loadu_ps(a + 4);
+    __m128 c2 = _mm_loadu_ps(a + 8);
+    __m128 c3 = _mm_loadu_ps(a + 12);
+    for (int j = 0; j < 4; j++) {
+        __m128 r = _mm_mul_ps(c0, _mm_set1_ps(b[4 * j]));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(b[4 * j + 1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(b[4 * j + 2])));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(b[4 * j + 3])));
+        _mm_storeu_ps(out + 4 * j, r);
+    }
+#else
+    float r[16];
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) r[4 * j + i] = a[i] * b[4 * j] + a[4 + i] * b[4 * j + 1] + a[8 + i] * b[4 * j + 2] + a[12 + i] * b[4 * j + 3];
+    }
+    std::memcpy(out, r, sizeof(r));
+#endif
+}
+
+glm::mat4 multiply(const glm::mat4& a, const glm::mat4& b) {
+    glm::mat4 out;
+    multiply(&a[0][0], &b[0][0], &out[0][0]);
+    return out;
+}
+
+glm::mat4 toGlm(const float* rowMajor) {
+    glm::mat4 m;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) m[c][r] = rowMajor[4 * r + c];
+    }
+    return m;
+}
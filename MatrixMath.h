@@ -0,0 +1,13 @@
+#ifndef MATRIX_MATH_HH
+#define MATRIX_MATH_HH
+
+#include <glm/glm/glm.hpp>
+
+// out = a * b on column major 4x4 matrices, SSE where the target has it. out may alias b but not a
+void multiply(const float* a, const float* b, float* out);
+glm::mat4 multiply(const glm::mat4& a, const glm::mat4& b);
+
+// glm matrix from a row major array, ASSIMP's layout
+glm::mat4 toGlm(const float* rowMajor);
+
+#endif
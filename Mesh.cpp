@@ -2,16 +2,145 @@
 
 #include <glad/glad.h>
 
-Mesh::Mesh(std::vector<VertexData> vs, std::vector<unsigned int> inds, std::vector<TextureData> texs) {
-    vertices = vs;
-    indices = inds;
-    textures = texs;
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+Mesh::Mesh(std::vector<VertexData> vs, std::vector<unsigned int> inds, std::vector<TextureData> texs, bool clusters, Vertex_format fmt, Retain_type retain) {
+    format = fmt;
+    vertices = std::move(vs);
+    indices = std::move(inds);
+    textures = std::move(texs);
+    if (clusters) meshlets = buildMeshlets(vertices, indices);
 
     // now that we have all the required data, set the vertex buffers and its attribute pointers.
-    setupMesh();
+    setupMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    if (retain == Retain_type::NONE) releaseCPUData();
+}
+
+Mesh::Mesh(MeshData&& data) :
+    indices{ std::move(data.indices) },
+    vertices{ std::move(data.vertices) },
+    textures{ std::move(data.textures) },
+    meshlets{ std::move(data.meshlets) },
+    lods{ std::move(data.lods) },
+    format{ data.format }
+{
+    setupMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    if (data.retain == Retain_type::NONE) releaseCPUData();
+}
+
+Mesh::Mesh(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds, std::vector<TextureData> texs, std::vector<Meshlet> clusters, std::vector<MeshLod> levels, Vertex_format fmt) :
+    textures{ std::move(texs) },
+    meshlets{ std::move(clusters) },
+    lods{ std::move(levels) },
+    format{ fmt }
+{
+    setupMesh(vs, n_vs, inds, n_inds);
 }
 
 void Mesh::Draw(Shader& shader) {
+    Draw(shader, 0);
+}
+
+void Mesh::Draw(Shader& shader, size_t lod) {
+    if (!VAO) return;
+    bindTextures(shader, textures);
+
+    // draw mesh
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, lods[lod].indexCount, GL_UNSIGNED_INT, (const void*)(sizeof(unsigned int) * lods[lod].firstIndex));
+    glBindVertexArray(0);
+
+    // always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t count, size_t first, size_t lod) {
+    if (!VAO || !count) return;
+    bindTextures(shader, textures);
+    glBindVertexArray(VAO);
+    instances.attach(first);
+    glDrawElementsInstanced(GL_TRIANGLES, lods[lod].indexCount, GL_UNSIGNED_INT, (const void*)(sizeof(unsigned int) * lods[lod].firstIndex), count);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawCulled(Shader& shader, const glm::mat4& mvp, const glm::vec3& localCamera) {
+    if (meshlets.empty() || !VAO) {
+        Draw(shader);
+        return;
+    }
+    std::vector<unsigned int> visible = cullMeshlets(meshlets, mvp, localCamera);
+    if (visible.empty()) return;
+    // meshlets are stored back to back so neighbouring visible ones merge into a single range
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    for (unsigned int i : visible) {
+        const Meshlet& m = meshlets[i];
+        const void* offset = (const void*)(sizeof(unsigned int) * m.firstIndex);
+        if (!counts.empty() && (const char*)offsets.back() + sizeof(unsigned int) * counts.back() == offset) counts.back() += m.indexCount;
+        else {
+            counts.push_back(m.indexCount);
+            offsets.push_back(offset);
+        }
+    }
+
+    bindTextures(shader, textures);
+    glBindVertexArray(VAO);
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), counts.size());
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+size_t Mesh::selectLod(const glm::mat4& modelView, float pixelScale, float pixelError) const {
+    if (lods.size() < 2) return 0;
+    glm::vec3 c = glm::vec3(modelView * glm::vec4(center, 1.0f));
+    // errors and the radius are in mesh space, scaled by the largest axis of the transform
+    float scale = 0;
+    for (int i = 0; i < 3; i++) scale = std::max(scale, glm::length(glm::vec3(modelView[i])));
+    float distance = glm::length(c) - radius * scale;
+    // the camera is inside the bounds
+    if (distance <= 0) return 0;
+    size_t lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * scale * pixelScale <= pixelError * distance) lod++;
+    return lod;
+}
+
+float Mesh::uvPerPixel(const glm::mat4& modelView, float pixelScale) const {
+    glm::vec3 c = glm::vec3(modelView * glm::vec4(center, 1.0f));
+    float scale = 0;
+    for (int i = 0; i < 3; i++) scale = std::max(scale, glm::length(glm::vec3(modelView[i])));
+    float distance = glm::length(c) - radius * scale;
+    if (distance <= 0 || scale <= 0) return 0;
+    // a mesh space unit covers pixelScale * scale / distance pixels there
+    return uvDensity * distance / (pixelScale * scale);
+}
+
+void Mesh::copyBuffers(unsigned int dstVBO, size_t vertexOffset, unsigned int dstEBO, size_t indexOffset) const {
+    glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, dstVBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, vertexOffset, vertexCount * vertexSize(format));
+    glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, dstEBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, indexOffset, indexCount * sizeof(unsigned int));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void Mesh::releaseBuffers(void) {
+    VAO.reset();
+    VBO.reset();
+    EBO.reset();
+}
+
+void Mesh::releaseCPUData(void) {
+    // swap rather than clear so the memory is actually returned
+    std::vector<VertexData>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+}
+
+void Mesh::bindTextures(Shader& shader, const std::vector<TextureData>& textures) {
     // bind appropriate textures
     // textures only need to be bound once, not every frame.
     // move out of draw?
@@ -38,21 +167,36 @@ void Mesh::Draw(Shader& shader) {
         // and finally bind the texture
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
+}
 
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+void Mesh::setupMesh(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds) {
+    vertexCount = n_vs;
+    indexCount = n_inds;
+    if (lods.empty()) lods.push_back({ 0, (unsigned int)n_inds, 0.0f });
+    format = chooseVertexFormat(format, vs, n_vs);
 
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
-}
+    // center of the bounding box, close enough to the smallest sphere for picking a level of detail
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (size_t i = 0; i < n_vs; i++) {
+        lo = glm::min(lo, vs[i].Position);
+        hi = glm::max(hi, vs[i].Position);
+    }
+    center = n_vs ? 0.5f * (lo + hi) : glm::vec3(0.0f);
+    radius = 0;
+    for (size_t i = 0; i < n_vs; i++) radius = std::max(radius, glm::length(vs[i].Position - center));
+    double area = 0, uvArea = 0;
+    for (size_t t = lods[0].firstIndex; t + 2 < (size_t)lods[0].firstIndex + lods[0].indexCount; t += 3) {
+        const VertexData& a = vs[inds[t]], & b = vs[inds[t + 1]], & c = vs[inds[t + 2]];
+        area += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+        glm::vec2 u = b.TexCoords - a.TexCoords, v = c.TexCoords - a.TexCoords;
+        uvArea += std::fabs(u.x * v.y - u.y * v.x);
+    }
+    uvDensity = area > 0 ? (float)std::sqrt(uvArea / area) : 0.0f;
 
-void Mesh::setupMesh() {
     // create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    VAO = GLVertexArray::create();
+    VBO = GLBuffer::create();
+    EBO = GLBuffer::create();
 
     glBindVertexArray(VAO);
     // load data into vertex buffers
@@ -60,33 +204,18 @@ void Mesh::setupMesh() {
     // A great thing about structs is that their memory layout is sequential for all its items.
     // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
     // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexData), &vertices[0], GL_STATIC_DRAW);
+    // compact formats are packed into a temporary first
+    if (format == Vertex_format::FULL) glBufferData(GL_ARRAY_BUFFER, n_vs * sizeof(VertexData), vs, GL_STATIC_DRAW);
+    else {
+        std::vector<unsigned char> packed = packVertices(format, vs, n_vs);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+    }
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, n_inds * sizeof(unsigned int), inds, GL_STATIC_DRAW);
 
     // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Bitangent));
-    // ids
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(VertexData), (void*)offsetof(VertexData, m_BoneIDs));
-    // weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, m_Weights));
+    setupVertexAttributes(format);
 
     glBindVertexArray(0);
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "GLHandle.h"
+#include "InstanceBuffer.h"
 #include "Shader.h"
+#include "Meshlet.h"
+#include "Simplification.h"
+#include "VertexFormat.h"
 
 #include <glm/glm/glm.hpp>
 
@@ -30,19 +35,82 @@ struct TextureData {
     std::string path;
 };
 
+// what a Mesh keeps on the CPU once it's uploaded
+enum class Retain_type {
+    // vertices and indices stay, for anything that reads the geometry back
+    ALL,
+    // only what drawing needs: textures and meshlets
+    NONE
+};
+
+// CPU side result of importing a mesh, built on worker threads and turned into a Mesh on the GL thread
+struct MeshData {
+    std::vector<VertexData>   vertices;
+    std::vector<unsigned int> indices;
+    std::vector<TextureData>  textures;
+    std::vector<Meshlet>      meshlets;
+    // levels of detail over ranges of indices, the full mesh first. Empty means indices is only the full mesh
+    std::vector<MeshLod>      lods;
+    Vertex_format             format = Vertex_format::FULL;
+    Retain_type               retain = Retain_type::ALL;
+    // scene graph node that places the mesh, -1 for none
+    int                       node = -1;
+};
+
 class Mesh {
 public:
     // mesh Data
-    unsigned int VAO;
+    GLVertexArray VAO;
     std::vector<unsigned int> indices;
     std::vector<VertexData>   vertices;
     std::vector<TextureData>  textures;
+    // clusters over ranges of indices, empty if the mesh was built without them
+    std::vector<Meshlet>      meshlets;
+    // levels of detail, never empty: the first is the full mesh, the range meshlets cover
+    std::vector<MeshLod>      lods;
+    // number of vertices and indices on the GPU, every level included. Stay valid when there's no CPU copy
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    // bounding sphere of the vertices
+    glm::vec3 center;
+    float radius;
+    // uv units per mesh space unit, the square root of uv area over surface area of the full level. 0 without uvs
+    float uvDensity;
+    // layout the vertices were uploaded with, never AUTO once the mesh is set up
+    Vertex_format format;
 
-    Mesh(std::vector<VertexData> vs, std::vector<unsigned int> inds, std::vector<TextureData> texs);
+    // clusters reorders the indices into meshlets before upload. Pass the vectors with std::move to avoid copies
+    Mesh(std::vector<VertexData> vs, std::vector<unsigned int> inds, std::vector<TextureData> texs, bool clusters = true, Vertex_format fmt = Vertex_format::FULL, Retain_type retain = Retain_type::ALL);
+    // takes over already processed data, only does the upload
+    Mesh(MeshData&& data);
+    // uploads straight from memory owned by the caller (e.g. a mapped cache file), vertices and indices stay empty
+    Mesh(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds, std::vector<TextureData> texs, std::vector<Meshlet> clusters, std::vector<MeshLod> levels = {}, Vertex_format fmt = Vertex_format::FULL);
 
     void Draw(Shader& shader);
+    // draws one level of detail
+    void Draw(Shader& shader, size_t lod);
+    // coarsest level whose error stays within pixelError pixels on screen. modelView takes the mesh to view space,
+    // pixelScale is the pixels a unit long object covers at distance 1: viewport height / 2 * projection[1][1]
+    size_t selectLod(const glm::mat4& modelView, float pixelScale, float pixelError) const;
+    // uv units one pixel covers where the bounds come closest to the camera, same arguments as selectLod.
+    // 0 with the camera inside the bounds. Times a texture's size it is what TextureResidency::request takes
+    float uvPerPixel(const glm::mat4& modelView, float pixelScale) const;
+    // draws count instances of one level of detail in a single call, starting at instance first of instances
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t count, size_t first = 0, size_t lod = 0);
+    // draws only the meshlets inside the frustum that face the camera, see cullMeshlets for the arguments
+    void DrawCulled(Shader& shader, const glm::mat4& mvp, const glm::vec3& localCamera);
+
+    // GPU side copy of the vertex and index buffers into other buffers at the given byte offsets
+    void copyBuffers(unsigned int dstVBO, size_t vertexOffset, unsigned int dstEBO, size_t indexOffset) const;
+    // deletes the GL objects, e.g. once the mesh lives in a packed buffer. Draw does nothing afterwards
+    void releaseBuffers(void);
+    // frees the CPU copies of vertices and indices, the GPU copy is unaffected
+    void releaseCPUData(void);
+
+    // binds textures to the texture_diffuseN, texture_specularN, ... samplers
+    static void bindTextures(Shader& shader, const std::vector<TextureData>& textures);
 private:
-    unsigned int VBO, EBO;
-    void setupMesh();
+    GLBuffer VBO, EBO;
+    void setupMesh(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "MeshOptimizer.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+
+// vertices the scoring function models, larger than the measured cache so it's not tuned to one size
+static constexpr unsigned int SCORE_CACHE_SIZE = 32;
+static constexpr float CACHE_DECAY_POWER = 1.5f;
+static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+float computeACMR(const unsigned int* indices, size_t n_inds, unsigned int cacheSize) {
+    if (n_inds < 3) return 0;
+    unsigned int n_vs = 0;
+    for (size_t i = 0; i < n_inds; i++) n_vs = std::max(n_vs, indices[i] + 1);
+    // miss count at the time each vertex entered the cache, it's still in as long as fewer than cacheSize came after
+    std::vector<size_t> entered(n_vs, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < n_inds; i++) {
+        unsigned int v = indices[i];
+        if (entered[v] && misses - entered[v] < cacheSize) continue;
+        misses++;
+        entered[v] = misses;
+    }
+    return (float)misses / (n_inds / 3);
+}
+
+size_t weldVertices(std::vector<VertexData>& vertices, std::vector<unsigned int>& indices) {
+    // VertexData has no padding and processMesh zero fills it, so the bytes are the identity
+    std::unordered_map<std::string_view, unsigned int> unique;
+    unique.reserve(vertices.size());
+    std::vector<unsigned int> remap(vertices.size());
+    size_t n_unique = 0;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        std::string_view key((const char*)&vertices[i], sizeof(VertexData));
+        auto it = unique.find(key);
+        if (it != unique.end()) {
+            remap[i] = it->second;
+            continue;
+        }
+        // only ever moves down, so the keys already stored still point at their vertices
+        vertices[n_unique] = vertices[i];
+        unique.emplace(std::string_view((const char*)&vertices[n_unique], sizeof(VertexData)), n_unique);
+        remap[i] = n_unique++;
+    }
+    for (unsigned int& i : indices) i = remap[i];
+    size_t removed = vertices.size() - n_unique;
+    vertices.resize(n_unique);
+    return removed;
+}
+
+static float vertexScore(int cachePosition, unsigned int remaining) {
+    // no triangles left, never pick it again
+    if (remaining == 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the last triangle's vertices get a fixed score, they'd otherwise win every time and give strips
+        if (cachePosition < 3) score = LAST_TRIANGLE_SCORE;
+        else score = std::pow(1.0f - (float)(cachePosition - 3) / (SCORE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+    // vertices with few triangles left are finished first so they don't come back later as a miss
+    return score + VALENCE_BOOST_SCALE * std::pow((float)remaining, -VALENCE_BOOST_POWER);
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t n_inds) {
+    size_t n_tris = n_inds / 3;
+    if (n_tris < 2) return;
+
+    // dense local ids, so a small range of a big mesh costs only its own size
+    std::vector<unsigned int> ids(indices, indices + 3 * n_tris);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    size_t n_vs = ids.size();
+    std::vector<unsigned int> local(3 * n_tris);
+    for (size_t i = 0; i < 3 * n_tris; i++) local[i] = std::lower_bound(ids.begin(), ids.end(), indices[i]) - ids.begin();
+
+    // vertex -> triangle adjacency, compressed rows
+    std::vector<unsigned int> offsets(n_vs + 1, 0);
+    for (unsigned int v : local) offsets[v + 1]++;
+    for (size_t v = 0; v < n_vs; v++) offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> adj(3 * n_tris);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < 3 * n_tris; i++) adj[fill[local[i]]++] = i / 3;
+
+    std::vector<unsigned int> remaining(n_vs);
+    std::vector<int> cachePosition(n_vs, -1);
+    std::vector<float> score(n_vs);
+    for (size_t v = 0; v < n_vs; v++) {
+        remaining[v] = offsets[v + 1] - offsets[v];
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScore(n_tris);
+    std::vector<char> emitted(n_tris, 0);
+    unsigned int best = 0;
+    for (size_t t = 0; t < n_tris; t++) {
+        triangleScore[t] = score[local[3 * t]] + score[local[3 * t + 1]] + score[local[3 * t + 2]];
+        if (triangleScore[t] > triangleScore[best]) best = t;
+    }
+
+    std::vector<unsigned int> cache, next;
+    cache.reserve(SCORE_CACHE_SIZE + 3);
+    next.reserve(SCORE_CACHE_SIZE + 3);
+    std::vector<unsigned int> out;
+    out.reserve(3 * n_tris);
+    size_t cursor = 0;
+    for (size_t n = 0; n < n_tris; n++) {
+        if (best == (unsigned int)-1) {
+            // nothing in the cache has triangles left, continue with the next unused one
+            while (emitted[cursor]) cursor++;
+            best = cursor;
+        }
+        emitted[best] = 1;
+        for (size_t k = 0; k < 3; k++) {
+            unsigned int v = local[3 * best + k];
+            out.push_back(ids[v]);
+            remaining[v]--;
+        }
+
+        // the triangle's vertices move to the front, the rest shift back, anything past the end drops out
+        next.clear();
+        for (size_t k = 0; k < 3; k++) next.push_back(local[3 * best + k]);
+        for (unsigned int v : cache) {
+            if (v != next[0] && v != next[1] && v != next[2]) next.push_back(v);
+        }
+        for (size_t i = SCORE_CACHE_SIZE; i < next.size(); i++) {
+            cachePosition[next[i]] = -1;
+            score[next[i]] = vertexScore(-1, remaining[next[i]]);
+        }
+        if (next.size() > SCORE_CACHE_SIZE) next.resize(SCORE_CACHE_SIZE);
+        cache.swap(next);
+        for (size_t i = 0; i < cache.size(); i++) {
+            cachePosition[cache[i]] = i;
+            score[cache[i]] = vertexScore(i, remaining[cache[i]]);
+        }
+
+        // only triangles around cached vertices changed, the best of them goes next
+        best = (unsigned int)-1;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            for (unsigned int k = offsets[v]; k < offsets[v + 1]; k++) {
+                unsigned int t = adj[k];
+                if (emitted[t]) continue;
+                triangleScore[t] = score[local[3 * t]] + score[local[3 * t + 1]] + score[local[3 * t + 2]];
+                if (triangleScore[t] > bestScore) {
+                    best = t;
+                    bestScore = triangleScore[t];
+                }
+            }
+        }
+    }
+    std::copy(out.begin(), out.end(), indices);
+}
+
+void optimizeOverdraw(const std::vector<VertexData>& vertices, std::vector<unsigned int>& indices, std::vector<Meshlet>& meshlets) {
+    size_t n_meshlets = meshlets.size();
+    if (n_meshlets < 2) return;
+
+    // area weighted centroid and normal of every meshlet, and of the whole mesh
+    std::vector<glm::vec3> centroids(n_meshlets), normals(n_meshlets);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t i = 0; i < n_meshlets; i++) {
+        const Meshlet& m = meshlets[i];
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int k = m.firstIndex; k + 2 < m.firstIndex + m.indexCount; k += 3) {
+            const glm::vec3& a = vertices[indices[k]].Position;
+            const glm::vec3& b = vertices[indices[k + 1]].Position;
+            const glm::vec3& c = vertices[indices[k + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float twiceArea = glm::length(n);
+            centroid += (a + b + c) * (twiceArea / 3.0f);
+            normal += n;
+            area += twiceArea;
+        }
+        centroids[i] = area > 0 ? centroid / area : m.center;
+        normals[i] = normal;
+        meshCentroid += centroid;
+        meshArea += area;
+    }
+    if (meshArea > 0) meshCentroid /= meshArea;
+
+    std::vector<float> key(n_meshlets);
+    for (size_t i = 0; i < n_meshlets; i++) {
+        float len = glm::length(normals[i]);
+        key[i] = len > 0 ? glm::dot(centroids[i] - meshCentroid, normals[i] / len) : 0.0f;
+    }
+    std::vector<unsigned int> order(n_meshlets);
+    for (size_t i = 0; i < n_meshlets; i++) order[i] = i;
+    // stable so the result doesn't depend on the sort implementation
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return key[a] > key[b]; });
+
+    std::vector<unsigned int> out;
+    out.reserve(indices.size());
+    std::vector<Meshlet> sorted;
+    sorted.reserve(n_meshlets);
+    for (unsigned int i : order) {
+        Meshlet m = meshlets[i];
+        out.insert(out.end(), indices.begin() + m.firstIndex, indices.begin() + m.firstIndex + m.indexCount);
+        m.firstIndex = out.size() - m.indexCount;
+        sorted.push_back(m);
+    }
+    indices.swap(out);
+    meshlets.swap(sorted);
+}
+
+void optimizeVertexFetch(std::vector<VertexData>& vertices, std::vector<unsigned int>& indices) {
+    std::vector<unsigned int> remap(vertices.size(), (unsigned int)-1);
+    std::vector<VertexData> out;
+    out.reserve(vertices.size());
+    for (unsigned int& i : indices) {
+        if (remap[i] == (unsigned int)-1) {
+            remap[i] = out.size();
+            out.push_back(vertices[i]);
+        }
+        i = remap[i];
+    }
+    vertices.swap(out);
+}
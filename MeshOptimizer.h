@@ -0,0 +1,34 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+
+struct VertexData;
+struct Meshlet;
+
+// FIFO cache the statistics are measured against, a common size for post-transform caches
+#define VERTEX_CACHE_SIZE 16
+
+// Average cache miss ratio: transformed vertices per triangle with a FIFO post-transform cache of cacheSize entries.
+// 3 for a de-indexed mesh, about 0.5 to 0.7 for a well ordered one
+float computeACMR(const unsigned int* indices, size_t n_inds, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Merges bit identical vertices and remaps indices, returns how many were removed.
+// Many formats store every triangle's corners separately, which makes vertex reuse impossible.
+size_t weldVertices(std::vector<VertexData>& vertices, std::vector<unsigned int>& indices);
+
+// Reorders the triangles of an index range for the post-transform vertex cache (Forsyth's linear speed
+// optimizer), greedily emitting the triangle whose vertices are most recently used or have few triangles left.
+// Run it before buildMeshlets, which starts each cluster from the next unused triangle and so mostly keeps the order.
+void optimizeVertexCache(unsigned int* indices, size_t n_inds);
+
+// Overdraw ordering after Sander et al. with meshlets as the clusters: the ones on the outside, facing away from the
+// center of the mesh, are drawn first so the ones behind them fail the depth test. Moves the index ranges and
+// updates firstIndex. Triangles inside a meshlet keep their order, so the cache order isn't lost.
+void optimizeOverdraw(const std::vector<VertexData>& vertices, std::vector<unsigned int>& indices, std::vector<Meshlet>& meshlets);
+
+// Renumbers vertices in the order the indices first use them, so vertex fetches walk memory forward.
+// Unreferenced vertices are dropped
+void optimizeVertexFetch(std::vector<VertexData>& vertices, std::vector<unsigned int>& indices);
+
+#endif
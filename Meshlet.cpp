@@ -0,0 +1,183 @@
+#include "Meshlet.h"
+#include "Mesh.h"
+
+#include <cmath>
+
+const unsigned int NO_TRIANGLE = 0xFFFFFFFF;
+
+// cone cutoff that no direction can reach, disables backface culling for widely spread clusters
+const float CONE_DISABLED = 2.0f;
+
+Frustum::Frustum(const glm::mat4& m) {
+    // Gribb/Hartmann plane extraction, glm matrices are column major so row i is m[*][i]
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+    for (glm::vec4& p : planes) {
+        float len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        if (len > 0) p = p / len;
+    }
+}
+
+bool Frustum::sphereVisible(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& p : planes) {
+        if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) return false;
+    }
+    return true;
+}
+
+void computeMeshletBounds(const std::vector<VertexData>& vertices, const std::vector<unsigned int>& mverts, const unsigned int* tris, size_t n_tris, Meshlet& m) {
+    // Ritter's bounding sphere
+    glm::vec3 a = vertices[mverts[0]].Position;
+    glm::vec3 b = a;
+    for (unsigned int v : mverts) {
+        if (glm::distance(vertices[v].Position, a) > glm::distance(b, a)) b = vertices[v].Position;
+    }
+    glm::vec3 c = b;
+    for (unsigned int v : mverts) {
+        if (glm::distance(vertices[v].Position, b) > glm::distance(c, b)) c = vertices[v].Position;
+    }
+    m.center = (b + c) * 0.5f;
+    m.radius = glm::distance(b, c) / 2;
+    for (unsigned int v : mverts) {
+        float d = glm::distance(vertices[v].Position, m.center);
+        if (d > m.radius) {
+            float r = (m.radius + d) / 2;
+            m.center = m.center + (vertices[v].Position - m.center) * ((r - m.radius) / d);
+            m.radius = r;
+        }
+    }
+
+    // normal cone around the average face normal
+    // degenerate triangles keep a zero normal and are ignored
+    std::vector<glm::vec3> normals(n_tris, glm::vec3(0.0f));
+    glm::vec3 axis(0.0f);
+    for (size_t t = 0; t < n_tris; t++) {
+        glm::vec3 p0 = vertices[tris[3 * t]].Position;
+        glm::vec3 n = glm::cross(vertices[tris[3 * t + 1]].Position - p0, vertices[tris[3 * t + 2]].Position - p0);
+        float len = glm::length(n);
+        if (len == 0) continue;
+        normals[t] = n / len;
+        axis += normals[t];
+    }
+    m.coneApex = m.center;
+    m.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    m.coneCutoff = CONE_DISABLED;
+    float axis_len = glm::length(axis);
+    if (axis_len == 0) return;
+    axis = axis / axis_len;
+    float mindp = 1;
+    for (const glm::vec3& n : normals) {
+        if (n.x != 0 || n.y != 0 || n.z != 0) mindp = std::fmin(mindp, glm::dot(n, axis));
+    }
+    m.coneAxis = axis;
+    // spread close to a hemisphere or more, the cone would never cull anything
+    if (mindp <= 0.1f) return;
+    // move the apex back along the axis until it is behind every triangle
+    float maxt = 0;
+    for (size_t t = 0; t < n_tris; t++) {
+        const glm::vec3& n = normals[t];
+        if (n.x == 0 && n.y == 0 && n.z == 0) continue;
+        maxt = std::fmax(maxt, glm::dot(m.center - vertices[tris[3 * t]].Position, n) / glm::dot(n, axis));
+    }
+    m.coneApex = m.center - axis * maxt;
+    m.coneCutoff = std::sqrt(1 - mindp * mindp);
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<VertexData>& vertices, std::vector<unsigned int>& indices) {
+    std::vector<Meshlet> meshlets;
+    size_t n_tris = indices.size() / 3;
+    size_t n_vs = vertices.size();
+    if (n_tris == 0) return meshlets;
+
+    // vertex -> triangle adjacency, compressed rows
+    std::vector<unsigned int> offsets(n_vs + 1, 0);
+    for (unsigned int i : indices) offsets[i + 1]++;
+    for (size_t v = 0; v < n_vs; v++) offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> adj(3 * n_tris);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) adj[fill[indices[i]]++] = i / 3;
+
+    std::vector<char> emitted(n_tris, 0);
+    // slot of each vertex in the current meshlet, -1 if not in it
+    std::vector<int> slot(n_vs, -1);
+    std::vector<unsigned int> mverts;
+    std::vector<unsigned int> out;
+    out.reserve(indices.size());
+    mverts.reserve(MESHLET_MAX_VERTICES);
+    size_t first = 0;
+    size_t seed = 0;
+
+    auto newVerts = [&](unsigned int t) {
+        return (slot[indices[3 * t]] < 0) + (slot[indices[3 * t + 1]] < 0) + (slot[indices[3 * t + 2]] < 0);
+    };
+    auto finish = [&]() {
+        if (mverts.empty()) return;
+        Meshlet m;
+        m.firstIndex = first;
+        m.indexCount = out.size() - first;
+        m.vertexCount = mverts.size();
+        computeMeshletBounds(vertices, mverts, &out[first], m.indexCount / 3, m);
+        meshlets.push_back(m);
+        for (unsigned int v : mverts) slot[v] = -1;
+        mverts.clear();
+        first = out.size();
+    };
+
+    for (size_t emitted_count = 0; emitted_count < n_tris; emitted_count++) {
+        // grow through shared vertices, preferring triangles that add the fewest new ones
+        unsigned int best = NO_TRIANGLE;
+        int bestNew = 4;
+        for (unsigned int v : mverts) {
+            for (unsigned int k = offsets[v]; k < offsets[v + 1]; k++) {
+                unsigned int t = adj[k];
+                if (emitted[t]) continue;
+                int n = newVerts(t);
+                if (n < bestNew || (n == bestNew && t < best)) {
+                    best = t;
+                    bestNew = n;
+                }
+            }
+        }
+        if (best == NO_TRIANGLE) {
+            // nothing connected left, start over from the next unused triangle
+            finish();
+            while (emitted[seed]) seed++;
+            best = seed;
+        }
+        if (mverts.size() + newVerts(best) > MESHLET_MAX_VERTICES || (out.size() - first) / 3 + 1 > MESHLET_MAX_TRIANGLES) finish();
+
+        emitted[best] = 1;
+        for (size_t k = 0; k < 3; k++) {
+            unsigned int v = indices[3 * best + k];
+            if (slot[v] < 0) {
+                slot[v] = mverts.size();
+                mverts.push_back(v);
+            }
+            out.push_back(v);
+        }
+    }
+    finish();
+    indices.swap(out);
+    return meshlets;
+}
+
+std::vector<unsigned int> cullMeshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& mvp, const glm::vec3& localCamera) {
+    Frustum frustum(mvp);
+    std::vector<unsigned int> visible;
+    visible.reserve(meshlets.size());
+    for (unsigned int i = 0; i < meshlets.size(); i++) {
+        const Meshlet& m = meshlets[i];
+        if (!frustum.sphereVisible(m.center, m.radius)) continue;
+        glm::vec3 d = m.coneApex - localCamera;
+        float len = glm::length(d);
+        if (len > 0 && glm::dot(d, m.coneAxis) >= m.coneCutoff * len) continue;
+        visible.push_back(i);
+    }
+    return visible;
+}
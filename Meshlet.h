@@ -0,0 +1,45 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+
+struct VertexData;
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// small cluster of triangles stored contiguously in the mesh index buffer
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    unsigned int vertexCount;
+    // bounding sphere
+    glm::vec3 center;
+    float radius;
+    // backface cone, the cluster faces away from any camera with dot(normalize(apex - camera), axis) >= cutoff
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// six planes pointing inward, extracted from a projection * view (* model) matrix
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum(const glm::mat4& m);
+    bool sphereVisible(const glm::vec3& center, float radius) const;
+};
+
+// Partitions a triangle list into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES
+// triangles, growing each cluster through shared vertices, and reorders indices so every meshlet is one range.
+// Pure CPU, can run offline or at load time.
+std::vector<Meshlet> buildMeshlets(const std::vector<VertexData>& vertices, std::vector<unsigned int>& indices);
+
+// Frustum and normal cone culling. Everything is tested in the mesh's own space: pass projection * view * model
+// and the camera position transformed into model space, which keeps the test exact under any model transform.
+// Returns the indices of the visible meshlets in buffer order.
+std::vector<unsigned int> cullMeshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& mvp, const glm::vec3& localCamera);
+
+#endif
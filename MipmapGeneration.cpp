@@ -0,0 +1,249 @@
+#include "MipmapGeneration.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define MIPMAP_SSE
+#endif
+
+namespace {
+
+const float PI = 3.14159265358979f;
+// support of the windowed sincs in texels of the smaller level, and how fast the Kaiser window falls off
+const float KAISER_RADIUS = 3.0f;
+const float KAISER_ALPHA = 4.0f;
+const float LANCZOS_RADIUS = 3.0f;
+// output rows per parallelFor chunk, also bounds the 8-bit source rows a chunk converts to float
+const int ROWS_PER_CHUNK = 16;
+
+float sinc(float x) {
+    x *= PI;
+    return std::fabs(x) < 1e-6f ? 1.0f : std::sin(x) / x;
+}
+
+// modified Bessel function of the first kind, order 0, by its power series
+float bessel0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 32 && term > sum * 1e-8f; k++) {
+        float t = x / (2.0f * k);
+        term *= t * t;
+        sum += term;
+    }
+    return sum;
+}
+
+float kaiser(float x) {
+    if (std::fabs(x) >= KAISER_RADIUS) return 0.0f;
+    float t = x / KAISER_RADIUS;
+    return sinc(x) * bessel0(KAISER_ALPHA * std::sqrt(1.0f - t * t)) / bessel0(KAISER_ALPHA);
+}
+
+float lanczos(float x) {
+    if (std::fabs(x) >= LANCZOS_RADIUS) return 0.0f;
+    return sinc(x) * sinc(x / LANCZOS_RADIUS);
+}
+
+// source texels of every output texel along one axis, clamped to the edge and normalized. Indices never decrease,
+// so a range of outputs reads a contiguous range of the source
+struct Taps {
+    // into index and weight, one more than outputs
+    std::vector<size_t> start;
+    std::vector<int> index;
+    std::vector<float> weight;
+};
+
+Taps computeTaps(int n_in, int n_out, Mip_filter filter) {
+    Taps taps;
+    float scale = (float)n_in / n_out;
+    float radius = filter == Mip_filter::BOX ? 0.5f : filter == Mip_filter::KAISER ? KAISER_RADIUS : LANCZOS_RADIUS;
+    for (int i = 0; i < n_out; i++) {
+        size_t first = taps.index.size();
+        taps.start.push_back(first);
+        float center = (i + 0.5f) * scale;
+        int lo = (int)std::floor(center - radius * scale), hi = (int)std::ceil(center + radius * scale);
+        float sum = 0.0f;
+        for (int j = lo; j < hi; j++) {
+            float w;
+            // the box integrates its footprint, so odd sizes split their middle texel instead of dropping one
+            if (filter == Mip_filter::BOX) w = std::max(0.0f, std::min(j + 1.0f, center + 0.5f * scale) - std::max((float)j, center - 0.5f * scale));
+            else {
+                float x = (j + 0.5f - center) / scale;
+                w = filter == Mip_filter::KAISER ? kaiser(x) : lanczos(x);
+            }
+            if (w == 0.0f) continue;
+            int k = std::min(std::max(j, 0), n_in - 1);
+            if (taps.index.size() > first && taps.index.back() == k) taps.weight.back() += w;
+            else {
+                taps.index.push_back(k);
+                taps.weight.push_back(w);
+            }
+            sum += w;
+        }
+        for (size_t t = first; t < taps.weight.size(); t++) taps.weight[t] /= sum;
+    }
+    taps.start.push_back(taps.index.size());
+    return taps;
+}
+
+float srgbToLinear(float v) {
+    return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+// buckets of the linear to sRGB table, fine enough that a bucket spans at most about one code
+const int SRGB_BUCKETS = 4096;
+
+// linear values of the 8-bit sRGB codes, the linear values halfway (in sRGB) between neighboring codes, and the
+// lowest code of every linear bucket
+struct SrgbTables {
+    float linear[256];
+    float threshold[256];
+    unsigned char bucket[SRGB_BUCKETS + 1];
+
+    SrgbTables(void) {
+        for (int i = 0; i < 256; i++) linear[i] = srgbToLinear(i / 255.0f);
+        for (int i = 0; i < 255; i++) threshold[i] = srgbToLinear((i + 0.5f) / 255.0f);
+        threshold[255] = 2.0f;
+        int code = 0;
+        for (int b = 0; b <= SRGB_BUCKETS; b++) {
+            while ((float)b / SRGB_BUCKETS >= threshold[code]) code++;
+            bucket[b] = (unsigned char)code;
+        }
+    }
+};
+
+const SrgbTables& srgbTables(void) {
+    static SrgbTables tables;
+    return tables;
+}
+
+// rounds to the nearest code like the pow based conversion, a table lookup and a step or two instead of a pow.
+// v is in [0, 1]
+unsigned char linearToSrgb(const SrgbTables& tables, float v) {
+    int code = tables.bucket[(int)(v * SRGB_BUCKETS)];
+    while (v >= tables.threshold[code]) code++;
+    return (unsigned char)code;
+}
+
+unsigned char toUnorm8(float v) {
+    return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// acc[i] = sum of weights[t] * rows[t][i], 4 floats at a time so the sum stays in a register across the taps
+void filterRows(float* acc, const float* const* rows, const float* weights, size_t taps, size_t n) {
+    size_t i = 0;
+#ifdef MIPMAP_SSE
+    for (; i + 4 <= n; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (size_t t = 0; t < taps; t++) sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+        _mm_storeu_ps(acc + i, sum);
+    }
+#endif
+    for (; i < n; i++) {
+        float sum = 0.0f;
+        for (size_t t = 0; t < taps; t++) sum += weights[t] * rows[t][i];
+        acc[i] = sum;
+    }
+}
+
+// sum of weights[t] times the pixel at index[t] of a row with c channels, one register per pixel for RGBA
+void filterPixel(float* sum, const float* row, const int* index, const float* weights, size_t taps, int c) {
+#ifdef MIPMAP_SSE
+    if (c == 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (size_t t = 0; t < taps; t++) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(row + (size_t)index[t] * 4)));
+        _mm_storeu_ps(sum, acc);
+        return;
+    }
+#endif
+    for (int k = 0; k < c; k++) sum[k] = 0.0f;
+    for (size_t t = 0; t < taps; t++) {
+        const float* p = row + (size_t)index[t] * c;
+        for (int k = 0; k < c; k++) sum[k] += weights[t] * p[k];
+    }
+}
+
+struct Level {
+    int width, height, components;
+    // the first level reads the 8-bit image, the others the linear floats of the level before
+    const unsigned char* bytes;
+    const float* floats;
+};
+
+// filters src into dst (linear floats) and out (8-bit), vertically first so the inner loop runs along whole rows
+void downsample(const Level& src, bool gamma, Mip_filter filter, std::vector<float>& dst, ImageData& out) {
+    int c = src.components, w = out.width, h = out.height;
+    size_t srcRow = (size_t)src.width * c;
+    Taps xs = computeTaps(src.width, w, filter), ys = computeTaps(src.height, h, filter);
+    const SrgbTables& tables = srgbTables();
+    // which channels of a pixel are sRGB encoded
+    bool encoded[4] = { gamma, gamma, gamma, false };
+
+    size_t chunks = (h + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK;
+    ThreadPool::global().parallelFor(h, [&](size_t begin, size_t end, size_t) {
+        // the 8-bit rows this chunk reads, converted once
+        int lo = ys.index[ys.start[begin]], hi = ys.index[ys.start[end] - 1];
+        std::vector<float> converted;
+        if (src.bytes) {
+            converted.resize((size_t)(hi - lo + 1) * srcRow);
+            for (int y = lo; y <= hi; y++) {
+                const unsigned char* p = src.bytes + (size_t)y * srcRow;
+                float* q = converted.data() + (size_t)(y - lo) * srcRow;
+                for (size_t i = 0; i < srcRow; i += c) {
+                    for (int k = 0; k < c; k++) q[i + k] = encoded[k] ? tables.linear[p[i + k]] : p[i + k] / 255.0f;
+                }
+            }
+        }
+        std::vector<float> column(srcRow);
+        std::vector<const float*> rows;
+        for (size_t y = begin; y < end; y++) {
+            rows.clear();
+            for (size_t t = ys.start[y]; t < ys.start[y + 1]; t++) {
+                int r = ys.index[t];
+                rows.push_back(src.bytes ? converted.data() + (size_t)(r - lo) * srcRow : src.floats + (size_t)r * srcRow);
+            }
+            filterRows(column.data(), rows.data(), ys.weight.data() + ys.start[y], rows.size(), srcRow);
+
+            float* d = dst.data() + y * w * c;
+            unsigned char* o = out.pixels + y * w * c;
+            for (int x = 0; x < w; x++) {
+                float sum[4];
+                filterPixel(sum, column.data(), xs.index.data() + xs.start[x], xs.weight.data() + xs.start[x], xs.start[x + 1] - xs.start[x], c);
+                for (int k = 0; k < c; k++) {
+                    // the sincs overshoot next to hard edges
+                    float v = std::min(std::max(sum[k], 0.0f), 1.0f);
+                    d[x * c + k] = v;
+                    o[x * c + k] = encoded[k] ? linearToSrgb(tables, v) : toUnorm8(v);
+                }
+            }
+        }
+    }, chunks);
+}
+
+}
+
+std::vector<ImageData> buildMipmaps(const ImageData& image, bool srgb, Mip_filter filter) {
+    std::vector<ImageData> mips;
+    if (filter == Mip_filter::GPU || !image.pixels || image.components < 1 || image.components > 4) return mips;
+    bool gamma = srgb && image.components >= 3;
+    Level src{ image.width, image.height, image.components, image.pixels, nullptr };
+    std::vector<float> previous, next;
+    while (src.width > 1 || src.height > 1) {
+        ImageData level(std::max(src.width / 2, 1), std::max(src.height / 2, 1), image.components);
+        if (!level.pixels) return std::vector<ImageData>();
+        next.resize((size_t)level.width * level.height * level.components);
+        downsample(src, gamma, filter, next, level);
+        std::swap(previous, next);
+        src = Level{ level.width, level.height, level.components, nullptr, previous.data() };
+        mips.push_back(std::move(level));
+    }
+    return mips;
+}
+
+bool generateMipmaps(ImageData& image, bool srgb, Mip_filter filter) {
+    image.mips = buildMipmaps(image, srgb, filter);
+    return !image.mips.empty();
+}
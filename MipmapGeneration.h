@@ -0,0 +1,28 @@
+#ifndef MIPMAP_GENERATION_HH
+#define MIPMAP_GENERATION_HH
+
+#include "Texture.h"
+
+#include <vector>
+
+enum class Mip_filter {
+    // leaves the chain to glGenerateMipmap at upload, usually a box filter
+    GPU,
+    // average of the pixels each texel covers
+    BOX,
+    // windowed sinc, sharper than the box without its ringing. the default for textures the engine loads
+    KAISER,
+    // Lanczos 3, the sharpest, rings slightly on hard edges
+    LANCZOS
+};
+
+// CPU mip chain. Each level is filtered from the one before it, halving both sides (rounded down, at least 1)
+// down to 1x1. sRGB color channels are converted to linear first and back after, alpha and images that aren't sRGB
+// are filtered as they are; like uploadTexture2D only 3 and 4 channel images count as sRGB. Edges clamp.
+// Rows of a level are filtered in parallel on the global ThreadPool, the vertical pass 4 floats at a time.
+// returns levels 1 and down, empty if the image is empty or the filter is GPU
+std::vector<ImageData> buildMipmaps(const ImageData& image, bool srgb, Mip_filter filter = Mip_filter::KAISER);
+// fills image.mips, which uploadTexture2D then uses instead of glGenerateMipmap. false if buildMipmaps returns nothing
+bool generateMipmaps(ImageData& image, bool srgb, Mip_filter filter = Mip_filter::KAISER);
+
+#endif
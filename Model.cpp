@@ -1,64 +1,746 @@
 #include "Model.h"
+#include "MeshOptimizer.h"
+#include "ModelCache.h"
+#include "NormalGeneration.h"
+#include "TextureAtlas.h"
+#include "TextureRegistry.h"
+#include "ThreadPool.h"
 
 #include <glad/glad.h> 
 #include <glm/glm/glm.hpp>
-#include <stb/stb_image.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <tuple>
 
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
+namespace {
 
-Model::Model(std::string const& path, bool gamma) : 
-    gammaCorrection{ gamma }
+// lists every file ASSIMP opens besides the model itself, e.g. an .obj's .mtl, for the cache to hash
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+    RecordingIOSystem(const std::string& source, std::vector<std::string>& files) : source{ source }, files{ files } {}
+
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+        // missing files too, the cache goes stale once they appear
+        if (source != file && std::find(files.begin(), files.end(), file) == files.end()) files.push_back(file);
+        return Assimp::DefaultIOSystem::Open(file, mode);
+    }
+
+private:
+    std::string source;
+    std::vector<std::string>& files;
+};
+
+}
+
+ImportProfile ImportProfile::raw(void) {
+    return ImportProfile{ aiProcess_Triangulate | aiProcess_FlipUVs, false, false, false, false, false, false, Mip_filter::GPU, false };
+}
+
+ImportProfile ImportProfile::optimized(void) {
+    return ImportProfile{ aiProcess_Triangulate | aiProcess_FlipUVs, true, true, true, true, false, false, Mip_filter::KAISER, false };
+}
+
+ImportProfile ImportProfile::compressed(void) {
+    ImportProfile profile = optimized();
+    profile.compressTextures = true;
+    return profile;
+}
+
+Model::Model(std::string const& path, bool gamma, Vertex_format format, Retain_type retainData, ImportProfile importProfile) : 
+    gammaCorrection{ gamma },
+    vertexFormat{ format },
+    retain{ retainData },
+    profile{ importProfile },
+    importStats{},
+    streaming{ false }
 {
     loadModel(path);
 }
 
+Model::Model(std::string const& path, bool gamma, Vertex_format format, Retain_type retainData, ImportProfile importProfile, bool load) :
+    directory{ path.substr(0, path.find_last_of('/')) },
+    gammaCorrection{ gamma },
+    vertexFormat{ format },
+    retain{ retainData },
+    profile{ importProfile },
+    importStats{},
+    streaming{ !load }
+{
+    if (load) loadModel(path);
+}
+
+bool Model::import(std::string const& path, ModelData& data, bool gamma, ImportProfile importProfile) {
+    // never loaded, only its settings are read
+    Model settings(path, gamma, Vertex_format::FULL, Retain_type::ALL, importProfile, false);
+    return settings.importModel(path, data);
+}
+
+Model::~Model(void) {
+    for (const TextureData& texture : textures_loaded) TextureRegistry::global().release(texture.id);
+}
+
 void Model::Draw(Shader& shader) {
-    for (unsigned int i = 0; i < meshes.size(); i++) meshes[i].Draw(shader);
+    refreshResident();
+    if (!packed()) {
+        for (unsigned int i = 0; i < meshes.size(); i++) meshes[i].Draw(shader);
+        return;
+    }
+    // groups are sorted by buffer so each VAO is bound once
+    size_t bound = (size_t)-1;
+    for (const PackedGroup& group : packedGroups) {
+        if (group.buffer != bound) {
+            bound = group.buffer;
+            glBindVertexArray(packedBuffers[bound].VAO);
+        }
+        Mesh::bindTextures(shader, group.textures);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, group.counts.data(), GL_UNSIGNED_INT, group.offsets.data(), group.counts.size(), group.baseVertices.data());
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
 }
 
-void Model::loadModel(std::string const& path) {
-    // read file via ASSIMP
-    Assimp::Importer importer;
-    // make processing options configurable
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-    // check for errors
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << "\n";
+void Model::Draw(Shader& shader, const glm::mat4& model) {
+    scene.update();
+    refreshResident();
+    if (!packed()) {
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            shader.setUniform_Mat4("model", placement(model, i < meshNodes.size() ? meshNodes[i] : -1));
+            meshes[i].Draw(shader);
+        }
+        return;
+    }
+    size_t bound = (size_t)-1;
+    for (const PackedGroup& group : packedGroups) {
+        if (group.buffer != bound) {
+            bound = group.buffer;
+            glBindVertexArray(packedBuffers[bound].VAO);
+        }
+        shader.setUniform_Mat4("model", placement(model, group.node));
+        Mesh::bindTextures(shader, group.textures);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, group.counts.data(), GL_UNSIGNED_INT, group.offsets.data(), group.counts.size(), group.baseVertices.data());
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Model::Draw(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, float viewportHeight, float pixelError) {
+    scene.update();
+    float pixelScale = 0.5f * viewportHeight * projection[1][1];
+    requestResident(view, model, pixelScale);
+    refreshResident();
+    if (!packed()) {
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            glm::mat4 m = placement(model, i < meshNodes.size() ? meshNodes[i] : -1);
+            shader.setUniform_Mat4("model", m);
+            meshes[i].Draw(shader, meshes[i].selectLod(view * m, pixelScale, pixelError));
+        }
+        return;
+    }
+
+    std::vector<int> counts;
+    std::vector<const void*> offsets;
+    size_t bound = (size_t)-1;
+    for (const PackedGroup& group : packedGroups) {
+        glm::mat4 m = placement(model, group.node);
+        glm::mat4 modelView = view * m;
+        counts.clear();
+        offsets.clear();
+        for (size_t k = 0; k < group.meshes.size(); k++) {
+            const Mesh& mesh = meshes[group.meshes[k]];
+            const MeshLod& lod = mesh.lods[mesh.selectLod(modelView, pixelScale, pixelError)];
+            counts.push_back(lod.indexCount);
+            offsets.push_back((const char*)group.offsets[k] + sizeof(unsigned int) * lod.firstIndex);
+        }
+        if (group.buffer != bound) {
+            bound = group.buffer;
+            glBindVertexArray(packedBuffers[bound].VAO);
+        }
+        shader.setUniform_Mat4("model", m);
+        Mesh::bindTextures(shader, group.textures);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), counts.size(), group.baseVertices.data());
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Model::DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t count, size_t first) {
+    if (!count) return;
+    scene.update();
+    refreshResident();
+    const glm::mat4 identity(1.0f);
+    if (!packed()) {
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            shader.setUniform_Mat4("model", placement(identity, i < meshNodes.size() ? meshNodes[i] : -1));
+            meshes[i].DrawInstanced(shader, instances, count, first);
+        }
+        return;
+    }
+    // there's no instanced multi draw, the group still shares the VAO, uniform and textures
+    size_t bound = (size_t)-1;
+    for (const PackedGroup& group : packedGroups) {
+        if (group.buffer != bound) {
+            bound = group.buffer;
+            glBindVertexArray(packedBuffers[bound].VAO);
+            instances.attach(first);
+        }
+        shader.setUniform_Mat4("model", placement(identity, group.node));
+        Mesh::bindTextures(shader, group.textures);
+        for (size_t k = 0; k < group.counts.size(); k++) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, group.counts[k], GL_UNSIGNED_INT, group.offsets[k], count, group.baseVertices[k]);
+        }
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Model::refreshResident(void) {
+    if (residentSlots.empty()) return;
+    for (const ResidentSlot& s : residentSlots) meshes[s.mesh].textures[s.slot].id = residentTextures[s.texture]->ID;
+    // the meshes of a group share their texture list
+    for (PackedGroup& group : packedGroups) {
+        const std::vector<TextureData>& textures = meshes[group.meshes[0]].textures;
+        for (size_t k = 0; k < group.textures.size(); k++) group.textures[k].id = textures[k].id;
+    }
+}
+
+void Model::requestResident(const glm::mat4& view, const glm::mat4& model, float pixelScale) {
+    if (residentSlots.empty() || !profile.residency) return;
+    // the densest use of a texture is the one kept, several slots of a mesh share its value
+    std::vector<float> uvPerPixel(meshes.size(), -1.0f);
+    for (const ResidentSlot& s : residentSlots) {
+        float& density = uvPerPixel[s.mesh];
+        if (density < 0) density = meshes[s.mesh].uvPerPixel(view * placement(model, s.mesh < meshNodes.size() ? meshNodes[s.mesh] : -1), pixelScale);
+        ResidentTexture& texture = *residentTextures[s.texture];
+        profile.residency->request(texture, density * std::max(texture.width, texture.height));
+    }
+}
+
+glm::mat4 Model::placement(const glm::mat4& model, int node) const {
+    if (node < 0) return model;
+    return multiply(model, scene.world(node));
+}
+
+void Model::DrawCulled(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model) {
+    scene.update();
+    refreshResident();
+    // cull in the space of each mesh, the camera sits at the origin of view space
+    auto cullSpace = [&](int node, glm::mat4& mvp, glm::vec3& localCamera) {
+        glm::mat4 m = placement(model, node);
+        shader.setUniform_Mat4("model", m);
+        mvp = projection * view * m;
+        localCamera = glm::vec3(glm::inverse(view * m) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    };
+    glm::mat4 mvp;
+    glm::vec3 localCamera;
+    if (!packed()) {
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            cullSpace(i < meshNodes.size() ? meshNodes[i] : -1, mvp, localCamera);
+            meshes[i].DrawCulled(shader, mvp, localCamera);
+        }
         return;
     }
+
+    std::vector<int> counts;
+    std::vector<const void*> offsets;
+    std::vector<int> baseVertices;
+    size_t bound = (size_t)-1;
+    for (const PackedGroup& group : packedGroups) {
+        cullSpace(group.node, mvp, localCamera);
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        for (size_t k = 0; k < group.meshes.size(); k++) {
+            const Mesh& mesh = meshes[group.meshes[k]];
+            if (mesh.meshlets.empty()) {
+                counts.push_back(group.counts[k]);
+                offsets.push_back(group.offsets[k]);
+                baseVertices.push_back(group.baseVertices[k]);
+                continue;
+            }
+            // neighbouring visible meshlets of a mesh merge into one range
+            for (unsigned int i : cullMeshlets(mesh.meshlets, mvp, localCamera)) {
+                const Meshlet& m = mesh.meshlets[i];
+                const char* offset = (const char*)group.offsets[k] + sizeof(unsigned int) * m.firstIndex;
+                if (!counts.empty() && baseVertices.back() == group.baseVertices[k] && (const char*)offsets.back() + sizeof(unsigned int) * counts.back() == offset) counts.back() += m.indexCount;
+                else {
+                    counts.push_back(m.indexCount);
+                    offsets.push_back(offset);
+                    baseVertices.push_back(group.baseVertices[k]);
+                }
+            }
+        }
+        if (counts.empty()) continue;
+        if (group.buffer != bound) {
+            bound = group.buffer;
+            glBindVertexArray(packedBuffers[bound].VAO);
+        }
+        Mesh::bindTextures(shader, group.textures);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), counts.size(), baseVertices.data());
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Model::pack(void) {
+    // a streaming model still gets meshes added
+    if (packed() || streaming || meshes.empty()) return;
+    // one buffer per vertex format, normally there is only one
+    std::vector<size_t> bufferOf(meshes.size());
+    std::vector<size_t> vertexTotals, indexTotals;
+    std::vector<size_t> baseVertex(meshes.size()), firstIndex(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        size_t b = 0;
+        while (b < packedBuffers.size() && packedBuffers[b].format != meshes[i].format) b++;
+        if (b == packedBuffers.size()) {
+            PackedBuffer buffer;
+            buffer.format = meshes[i].format;
+            packedBuffers.push_back(std::move(buffer));
+            vertexTotals.push_back(0);
+            indexTotals.push_back(0);
+        }
+        bufferOf[i] = b;
+        baseVertex[i] = vertexTotals[b];
+        firstIndex[i] = indexTotals[b];
+        vertexTotals[b] += meshes[i].vertexCount;
+        indexTotals[b] += meshes[i].indexCount;
+    }
+
+    // copy on the GPU, works the same for meshes that have no CPU copy
+    for (size_t b = 0; b < packedBuffers.size(); b++) {
+        PackedBuffer& buffer = packedBuffers[b];
+        buffer.VAO = GLVertexArray::create();
+        buffer.VBO = GLBuffer::create();
+        buffer.EBO = GLBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexTotals[b] * vertexSize(buffer.format), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, indexTotals[b] * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const PackedBuffer& buffer = packedBuffers[bufferOf[i]];
+        meshes[i].copyBuffers(buffer.VBO, baseVertex[i] * vertexSize(buffer.format), buffer.EBO, firstIndex[i] * sizeof(unsigned int));
+    }
+    for (PackedBuffer& buffer : packedBuffers) {
+        glBindVertexArray(buffer.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+        setupVertexAttributes(buffer.format);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.EBO);
+        glBindVertexArray(0);
+    }
+
+    // group by buffer, node and identical texture lists, in first use order within a buffer.
+    // a group is drawn under one "model" matrix, so meshes of different nodes can't share it
+    std::map<std::tuple<size_t, int, std::vector<std::pair<unsigned int, std::string>>>, size_t> groupOf;
+    for (size_t b = 0; b < packedBuffers.size(); b++) {
+        for (size_t i = 0; i < meshes.size(); i++) {
+            if (bufferOf[i] != b) continue;
+            int node = i < meshNodes.size() ? meshNodes[i] : -1;
+            std::vector<std::pair<unsigned int, std::string>> material;
+            for (const TextureData& t : meshes[i].textures) material.push_back({ t.id, t.type });
+            auto it = groupOf.find({ b, node, material });
+            if (it == groupOf.end()) {
+                it = groupOf.insert({ { b, node, material }, packedGroups.size() }).first;
+                PackedGroup group;
+                group.buffer = b;
+                group.node = node;
+                group.textures = meshes[i].textures;
+                packedGroups.push_back(group);
+            }
+            PackedGroup& group = packedGroups[it->second];
+            group.meshes.push_back(i);
+            group.counts.push_back(meshes[i].lods[0].indexCount);
+            group.offsets.push_back((const void*)(firstIndex[i] * sizeof(unsigned int)));
+            group.baseVertices.push_back(baseVertex[i]);
+        }
+    }
+
+    for (Mesh& mesh : meshes) mesh.releaseBuffers();
+}
+
+void Model::loadModel(std::string const& path) {
     // retrieve the directory path of the filepath
     directory = path.substr(0, path.find_last_of('/'));
+    ModelData data;
+    if (!importModel(path, data)) return;
 
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    // GL work stays on this thread, textures first so no mesh needs a placeholder
+    beginLoad(data);
+    for (size_t i = 0; i < data.textures.size(); i++) uploadTexture(data, i);
+    meshes.reserve(meshes.size() + data.meshes.size());
+    for (size_t i = 0; i < data.meshes.size(); i++) uploadMesh(data, i, 0);
+    finishLoad(data);
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+bool Model::importModel(std::string const& path, ModelData& data) const {
+    data.directory = directory;
+    uint64_t sourceHash;
+    if (!hashFile(path, sourceHash)) {
+        std::cout << "ERROR::MODEL:: can't read " << path << "\n";
+        return false;
+    }
+    // a compiled model is only valid for the profile it was optimized with
+    unsigned char settings[4] = { (unsigned char)profile.weld, (unsigned char)profile.optimizeVertexCache, (unsigned char)profile.optimizeOverdraw, (unsigned char)profile.generateLods };
+    sourceHash = hashBytes((const unsigned char*)&profile.postProcess, sizeof(profile.postProcess), hashBytes(settings, sizeof(settings), sourceHash));
+    std::string cachePath = path + MODEL_CACHE_EXTENSION;
+    if (!importCache(cachePath, sourceHash, data)) {
+        // read file via ASSIMP
+        std::vector<std::string> dependencies;
+        Assimp::Importer importer;
+        // the importer owns the handler
+        importer.SetIOHandler(new RecordingIOSystem(path, dependencies));
+        // normals and tangents are generated in processMesh, in parallel, instead of by assimp
+        const aiScene* scene = importer.ReadFile(path, profile.postProcess);
+        // check for errors
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << "\n";
+            return false;
+        }
+
+        // list ASSIMP's meshes in node order so the result doesn't depend on scheduling
+        std::vector<aiMesh*> order;
+        std::vector<int> nodes;
+        processNode(scene->mRootNode, scene, -1, data, order, nodes);
+
+        // bones get their indices here, before the meshes are processed in parallel, so they are the same every load
+        bool animated = scene->mNumAnimations > 0;
+        for (aiMesh* mesh : order) animated = animated || mesh->mNumBones > 0;
+        if (animated) {
+            data.skeleton = importSkeleton(scene);
+            for (aiMesh* mesh : order) {
+                for (unsigned int b = 0; b < mesh->mNumBones; b++) data.skeleton.addBone(mesh->mBones[b]->mName.C_Str(), toGlm(&mesh->mBones[b]->mOffsetMatrix.a1));
+            }
+            for (unsigned int a = 0; a < scene->mNumAnimations; a++) data.animations.push_back(importAnimation(scene->mAnimations[a], data.skeleton));
+        }
+
+        // gather the texture references first, it's cheap and decides which images need decoding
+        size_t n_meshes = order.size();
+        data.meshes.resize(n_meshes);
+        for (size_t i = 0; i < n_meshes; i++) {
+            aiMaterial* material = scene->mMaterials[order[i]->mMaterialIndex];
+            // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+            // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
+            // Same applies to other texture as the following list summarizes:
+            // diffuse: texture_diffuseN
+            // specular: texture_specularN
+            // normal: texture_normalN
+            std::vector<TextureData>& textures = data.meshes[i].textures;
+
+            // 1. diffuse maps
+            std::vector<TextureData> diffuseMaps = loadMaterialTextures(data, material, aiTextureType_DIFFUSE, "texture_diffuse");
+            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+            // 2. specular maps
+            std::vector<TextureData> specularMaps = loadMaterialTextures(data, material, aiTextureType_SPECULAR, "texture_specular");
+            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+            // 3. normal maps
+            std::vector<TextureData> normalMaps = loadMaterialTextures(data, material, aiTextureType_HEIGHT, "texture_normal");
+            textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+            // 4. height maps
+            std::vector<TextureData> heightMaps = loadMaterialTextures(data, material, aiTextureType_AMBIENT, "texture_height");
+            textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        }
+
+        // convert meshes on the pool, one job per mesh
+        std::vector<ImportStats> stats(n_meshes);
+        ThreadPool::global().parallelFor(n_meshes, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) {
+                std::vector<TextureData> textures = std::move(data.meshes[i].textures);
+                data.meshes[i] = processMesh(order[i], data.skeleton, stats[i]);
+                data.meshes[i].textures = std::move(textures);
+                data.meshes[i].format = vertexFormat;
+                data.meshes[i].retain = retain;
+                // skinned vertices are placed by the bones, which already include the node transforms
+                data.meshes[i].node = order[i]->mNumBones > 0 ? -1 : nodes[i];
+            }
+        }, n_meshes);
+
+        ImportStats& total = data.stats;
+        total = ImportStats{};
+        for (const ImportStats& s : stats) {
+            total.verticesBefore += s.verticesBefore;
+            total.verticesAfter += s.verticesAfter;
+            total.triangles += s.triangles;
+            total.acmrBefore += s.acmrBefore * s.triangles;
+            total.acmrAfter += s.acmrAfter * s.triangles;
+        }
+        if (total.triangles > 0) {
+            total.acmrBefore /= total.triangles;
+            total.acmrAfter /= total.triangles;
+        }
+        if (profile.report) {
+            std::cout << "MODEL:: " << path << ": " << total.triangles << " triangles, " << total.verticesBefore << " -> " << total.verticesAfter
+                << " vertices, ACMR " << total.acmrBefore << " -> " << total.acmrAfter << "\n";
+        }
+
+        // the cache has no skeleton or animations, animated models always go through ASSIMP
+        if (!animated) writeModelCache(cachePath, sourceHash, dependencies, data.meshes, data.scene);
+    }
+
+    size_t n_textures = data.textures.size();
+    data.images.resize(n_textures);
+    data.compressed.resize(n_textures);
+    // streamed textures are read by the residency's loader once the model reaches the GL thread
+    if (profile.residency) return true;
+    // textures already resident, e.g. through another model, are shared instead of decoded again
+    for (size_t i = 0; i < n_textures; i++) data.textures[i].id = TextureRegistry::global().acquireResident(directory + '/' + data.textures[i].path, srgb(data.textures[i].type));
+    ThreadPool::global().parallelFor(n_textures, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) {
+            if (data.textures[i].id) continue;
+            std::string texturePath = directory + '/' + data.textures[i].path;
+            // the atlas needs the decoded images
+            bool compress = (profile.compressTextures && !profile.atlasTextures) || isCompressedTextureFile(texturePath);
+            if (compress && loadCompressedTexture(texturePath, srgb(data.textures[i].type), data.compressed[i], data.textures[i].type == "texture_normal")) continue;
+            data.images[i] = ImageData(texturePath);
+        }
+    }, n_textures);
+    if (profile.atlasTextures) atlasTextures(data);
+    // atlas pages keep glGenerateMipmap, their gutters are sized for a box filter
+    if (profile.mipFilter != Mip_filter::GPU) {
+        ThreadPool::global().parallelFor(n_textures, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) generateMipmaps(data.images[i], srgb(data.textures[i].type), profile.mipFilter);
+        }, n_textures);
+    }
+    return true;
+}
+
+void Model::atlasTextures(ModelData& data) const {
+    // candidates grouped by the types of their textures, every group is one atlas with a layer per type
+    std::map<std::vector<std::string>, std::vector<size_t>> groups;
+    for (size_t i = 0; i < data.meshes.size(); i++) {
+        const MeshData& mesh = data.meshes[i];
+        if (mesh.textures.empty()) continue;
+        bool decoded = true;
+        std::vector<std::string> types;
+        for (const TextureData& texture : mesh.textures) {
+            decoded = decoded && data.images[texture.id].pixels;
+            types.push_back(texture.type);
+        }
+        const VertexData* vs = mesh.vertices.data();
+        size_t n_vs = mesh.vertices.size();
+        if (data.cache) {
+            vs = data.cache->vertices(data.cache->mesh(i));
+            n_vs = data.cache->mesh(i).vertexCount;
+        }
+        if (decoded && texCoordsInUnitSquare(vs, n_vs)) groups[types].push_back(i);
+    }
+
+    for (auto& group : groups) {
+        const std::vector<std::string>& types = group.first;
+        TextureAtlas atlas((int)types.size());
+        // meshes with the same textures share an entry
+        std::map<std::vector<unsigned int>, size_t> entryOf;
+        std::vector<std::pair<size_t, size_t>> placed;
+        for (size_t i : group.second) {
+            std::vector<unsigned int> material;
+            std::vector<const ImageData*> images;
+            for (const TextureData& texture : data.meshes[i].textures) {
+                material.push_back(texture.id);
+                images.push_back(&data.images[texture.id]);
+            }
+            auto it = entryOf.find(material);
+            size_t entry;
+            if (it != entryOf.end()) entry = it->second;
+            else if (atlas.add(images, entry)) entryOf[material] = entry;
+            else continue;
+            placed.push_back({ i, entry });
+        }
+        // a single image saves no binds
+        if (atlas.size() < 2) continue;
+        atlas.build();
+
+        // the pages become textures of the model, uploaded like the others but not shared through the registry
+        if (data.firstAtlasPage == (size_t)-1) data.firstAtlasPage = data.textures.size();
+        size_t firstPage = data.textures.size();
+        for (size_t p = 0; p < atlas.pageCount(); p++) {
+            for (size_t layer = 0; layer < types.size(); layer++) {
+                data.textures.push_back(TextureData{ 0, types[layer], "" });
+                data.images.push_back(std::move(atlas.pages[p * types.size() + layer]));
+                data.compressed.emplace_back();
+            }
+        }
+        for (const std::pair<size_t, size_t>& p : placed) {
+            MeshData& mesh = data.meshes[p.first];
+            const AtlasRegion& region = atlas.regions[p.second];
+            // compiled meshes are remapped in a copy, the mapping is read only
+            if (data.cache) {
+                const ModelCacheMesh& m = data.cache->mesh(p.first);
+                mesh.vertices.assign(data.cache->vertices(m), data.cache->vertices(m) + m.vertexCount);
+            }
+            remapTexCoords(mesh.vertices.data(), mesh.vertices.size(), region);
+            for (size_t layer = 0; layer < mesh.textures.size(); layer++) mesh.textures[layer].id = (unsigned int)(firstPage + region.page * types.size() + layer);
+        }
+    }
+
+    // images only meshes in an atlas used aren't uploaded on their own
+    if (data.firstAtlasPage == (size_t)-1) return;
+    // sized after the pages were added, meshes in an atlas point at them
+    std::vector<bool> used(data.textures.size(), false);
+    for (const MeshData& mesh : data.meshes) {
+        for (const TextureData& texture : mesh.textures) used[texture.id] = true;
+    }
+    data.inAtlas.assign(data.firstAtlasPage, false);
+    for (size_t j = 0; j < data.firstAtlasPage; j++) {
+        if (used[j] || !data.images[j].pixels) continue;
+        data.inAtlas[j] = true;
+        data.images[j] = ImageData();
+    }
+}
+
+bool Model::importCache(std::string const& cachePath, uint64_t sourceHash, ModelData& data) const {
+    std::unique_ptr<ModelCache> cache(new ModelCache(cachePath, sourceHash));
+    if (!cache->valid()) return false;
+    const ModelCacheHeader& info = cache->info();
+
+    // resolve the texture references of every material
+    std::vector<std::vector<TextureData>> materials(info.materialCount);
+    for (uint32_t i = 0; i < info.materialCount; i++) {
+        const ModelCacheMaterial& material = cache->material(i);
+        for (uint32_t j = 0; j < material.textureCount; j++) {
+            const ModelCacheTexture& t = cache->texture(material.firstTexture + j);
+            TextureData texture;
+            texture.type = cache->string(t.type);
+            texture.path = cache->string(t.path);
+            texture.id = data.textureReference(texture.path, texture.type, srgb(texture.type));
+            materials[i].push_back(texture);
+        }
+    }
+
+    // depth first, so every node is appended after its parent and keeps its record's index as id
+    for (uint32_t i = 0; i < info.nodeCount; i++) {
+        const ModelCacheNode& node = cache->node(i);
+        glm::mat4 local;
+        std::memcpy(&local[0][0], node.local, sizeof(node.local));
+        data.scene.addNode(node.parent, local, cache->string(node.name));
+    }
+
+    // vertices and indices stay in the mapping, they go to the GPU straight from there
+    data.meshes.resize(info.meshCount);
+    for (uint32_t i = 0; i < info.meshCount; i++) {
+        const ModelCacheMesh& m = cache->mesh(i);
+        const Meshlet* clusters = cache->meshlets(m);
+        data.meshes[i].textures = materials[m.material];
+        data.meshes[i].meshlets.assign(clusters, clusters + m.meshletCount);
+        const MeshLod* levels = cache->lods(m);
+        data.meshes[i].lods.assign(levels, levels + m.lodCount);
+        data.meshes[i].format = vertexFormat;
+        data.meshes[i].node = m.node;
+    }
+    data.cache = std::move(cache);
+    return true;
+}
+
+void Model::beginLoad(ModelData& data) {
+    scene = std::move(data.scene);
+}
+
+void Model::uploadTexture(ModelData& data, size_t i) {
+    TextureData& texture = data.textures[i];
+    if (i < data.inAtlas.size() && data.inAtlas[i]) return;
+    if (profile.residency) {
+        data.resident.resize(data.textures.size(), (size_t)-1);
+        data.resident[i] = residentTextures.size();
+        residentTextures.push_back(profile.residency->load(directory + '/' + texture.path, srgb(texture.type)));
+        for (const ModelData::PendingTexture& pending : data.pendingTextures) {
+            if (pending.texture == i) residentSlots.push_back({ pending.mesh, pending.slot, data.resident[i] });
+        }
+        refreshResident();
+        return;
+    }
+    if (i >= data.firstAtlasPage) {
+        texture.id = uploadAtlasPage(data.images[i], srgb(texture.type));
+        if (texture.id) atlasPages.emplace_back(texture.id);
+        data.images[i] = ImageData();
+    }
+    else if (!texture.id) {
+        std::string texturePath = directory + '/' + texture.path;
+        if (data.compressed[i].empty()) texture.id = TextureRegistry::global().acquire(texturePath, data.images[i], srgb(texture.type));
+        else texture.id = TextureRegistry::global().acquire(texturePath, data.compressed[i], srgb(texture.type));
+        data.images[i] = ImageData();
+        data.compressed[i] = CompressedImage();
+    }
+    for (const ModelData::PendingTexture& pending : data.pendingTextures) {
+        if (pending.texture == i) meshes[pending.mesh].textures[pending.slot].id = texture.id;
+    }
+}
+
+void Model::uploadMesh(ModelData& data, size_t i, unsigned int placeholder) {
+    MeshData& mesh = data.meshes[i];
+    for (size_t slot = 0; slot < mesh.textures.size(); slot++) {
+        TextureData& texture = mesh.textures[slot];
+        unsigned int j = texture.id;
+        texture.id = data.textures[j].id;
+        if (profile.residency) {
+            // the placeholder until its texture is loaded, which then adds the slot
+            if (j < data.resident.size() && data.resident[j] != (size_t)-1) residentSlots.push_back({ meshes.size(), slot, data.resident[j] });
+            else data.pendingTextures.push_back({ meshes.size(), slot, j });
+            texture.id = placeholder;
+            continue;
+        }
+        // resident textures already have their id, only the ones still waiting for upload are patched later
+        if (!texture.id && (data.images[j].pixels || !data.compressed[j].empty())) {
+            texture.id = placeholder;
+            data.pendingTextures.push_back({ meshes.size(), slot, j });
+        }
+    }
+    meshNodes.push_back(mesh.node);
+    if (!data.cache) {
+        meshes.emplace_back(std::move(mesh));
+        return;
+    }
+    const ModelCacheMesh& m = data.cache->mesh(i);
+    // meshes moved into an atlas carry remapped copies of their vertices
+    const VertexData* vs = mesh.vertices.empty() ? data.cache->vertices(m) : mesh.vertices.data();
+    meshes.emplace_back(vs, m.vertexCount, data.cache->indices(m), m.indexCount, std::move(mesh.textures),
+        std::move(mesh.meshlets), std::move(mesh.lods), mesh.format);
+}
+
+void Model::finishLoad(ModelData& data) {
+    // the registry references move over with the textures
+    size_t shared = std::min(data.textures.size(), data.firstAtlasPage);
+    textures_loaded.insert(textures_loaded.end(), data.textures.begin(), data.textures.begin() + shared);
+    data.textures.clear();
+    skeleton = std::move(data.skeleton);
+    animations = std::move(data.animations);
+    importStats = data.stats;
+    data.pendingTextures.clear();
+    data.resident.clear();
+    data.cache.reset();
+    streaming = false;
+}
+
+void Model::processNode(aiNode* node, const aiScene* scene, int parent, ModelData& data, std::vector<aiMesh*>& order, std::vector<int>& nodes) const {
+    int id = data.scene.addNode(parent, toGlm(&node->mTransformation.a1), node->mName.C_Str());
     // process each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         // the node object only contains indices to index the actual objects in the scene. 
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        order.push_back(scene->mMeshes[node->mMeshes[i]]);
+        nodes.push_back(id);
     }
     // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, id, data, order, nodes);
     }
 
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+MeshData Model::processMesh(aiMesh* mesh, const Skeleton& skeleton, ImportStats& stats) const {
     // data to fill
-    std::vector<VertexData> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<TextureData> textures;
+    MeshData data;
+    std::vector<VertexData>& vertices = data.vertices;
+    std::vector<unsigned int>& indices = data.indices;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(3 * mesh->mNumFaces);
 
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        VertexData vertex;
+        // zeroed so attributes the file doesn't have are well defined, bone ids of -1 mean no influence
+        VertexData vertex{};
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) vertex.m_BoneIDs[j] = -1;
         glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
         // positions
         vector.x = mesh->mVertices[i].x;
@@ -81,15 +763,17 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
             vec.y = mesh->mTextureCoords[0][i].y;
             vertex.TexCoords = vec;
             // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
+            if (mesh->mTangents) {
+                vector.x = mesh->mTangents[i].x;
+                vector.y = mesh->mTangents[i].y;
+                vector.z = mesh->mTangents[i].z;
+                vertex.Tangent = vector;
+                // bitangent
+                vector.x = mesh->mBitangents[i].x;
+                vector.y = mesh->mBitangents[i].y;
+                vector.z = mesh->mBitangents[i].z;
+                vertex.Bitangent = vector;
+            }
         }
         else vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 
@@ -97,96 +781,115 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     }
     // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         // retrieve all indices of the face and store them in the indices vector
         for (unsigned int j = 0; j < face.mNumIndices; j++) indices.push_back(face.mIndices[j]);
     }
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-    // Same applies to other texture as the following list summarizes:
-    // diffuse: texture_diffuseN
-    // specular: texture_specularN
-    // normal: texture_normalN
-
-    // 1. diffuse maps
-    std::vector<TextureData> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-    // 2. specular maps
-    std::vector<TextureData> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-    // 3. normal maps
-    std::vector<TextureData> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-    // 4. height maps
-    std::vector<TextureData> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
-}
-
-std::vector<TextureData> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
+    // bone influences, the strongest MAX_BONE_INFLUENCE per vertex are kept
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+        const aiBone* bone = mesh->mBones[b];
+        auto it = skeleton.boneIndex.find(bone->mName.C_Str());
+        if (it == skeleton.boneIndex.end()) continue;
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            const aiVertexWeight& weight = bone->mWeights[w];
+            if (weight.mVertexId >= vertices.size() || weight.mWeight <= 0) continue;
+            VertexData& vertex = vertices[weight.mVertexId];
+            int slot = 0;
+            for (int j = 1; j < MAX_BONE_INFLUENCE; j++) {
+                if (vertex.m_Weights[j] < vertex.m_Weights[slot]) slot = j;
+            }
+            if (weight.mWeight <= vertex.m_Weights[slot]) continue;
+            vertex.m_BoneIDs[slot] = it->second;
+            vertex.m_Weights[slot] = weight.mWeight;
+        }
+    }
+    if (mesh->mNumBones > 0) {
+        // dropped influences would otherwise shrink the vertex towards the origin
+        for (VertexData& vertex : vertices) {
+            float sum = 0;
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++) sum += vertex.m_Weights[j];
+            if (sum > 0) {
+                for (int j = 0; j < MAX_BONE_INFLUENCE; j++) vertex.m_Weights[j] /= sum;
+            }
+        }
+    }
+    stats.verticesBefore = vertices.size();
+    stats.triangles = indices.size() / 3;
+    stats.acmrBefore = computeACMR(indices.data(), indices.size());
+    // before normal generation, so corners that only differed by being stored separately are smoothed over
+    if (profile.weld) weldVertices(vertices, indices);
+    // fill in whatever the file didn't provide
+    bool needNormals = !mesh->HasNormals();
+    bool needTangents = mesh->mTextureCoords[0] && !mesh->mTangents;
+    if (needNormals || needTangents) generateNormalsAndTangents(vertices, indices, needNormals, needTangents);
+    if (profile.optimizeVertexCache) optimizeVertexCache(indices.data(), indices.size());
+    // cluster while still off the GL thread
+    data.meshlets = buildMeshlets(vertices, indices);
+    if (profile.optimizeOverdraw) optimizeOverdraw(vertices, indices, data.meshlets);
+    size_t fullCount = indices.size();
+    if (profile.generateLods) {
+        data.lods = buildLodChain(vertices, indices);
+        for (size_t i = 1; i < data.lods.size() && profile.optimizeVertexCache; i++) optimizeVertexCache(&indices[data.lods[i].firstIndex], data.lods[i].indexCount);
+    }
+    // every level goes through the remap, the full mesh first so its vertices come first
+    if (profile.optimizeVertexCache) optimizeVertexFetch(vertices, indices);
+    stats.verticesAfter = vertices.size();
+    stats.acmrAfter = computeACMR(indices.data(), fullCount);
+    return data;
+}
+
+std::vector<TextureData> Model::loadMaterialTextures(ModelData& data, aiMaterial* mat, aiTextureType type, std::string typeName) const {
     std::vector<TextureData> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
         aiString str;
         mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
-        if (!skip) {   // if texture hasn't been loaded already, load it
-            TextureData texture;
-            texture.id = TextureFromFile(str.C_Str(), directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-        }
+        unsigned int j = data.textureReference(str.C_Str(), typeName, srgb(typeName));
+        textures.push_back(data.textures[j]);
+        textures.back().id = j;
     }
     return textures;
 }
 
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma) {
-    std::string filename = std::string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-        else std::cout << "undefined stbi image format\n";
+unsigned int ModelData::textureReference(std::string const& path, std::string const& type, bool srgb) {
+    // check if texture was seen before and if so, reference it instead of loading it again
+    TextureKey key{ path, srgb };
+    auto it = textureIndex.find(key);
+    if (it != textureIndex.end()) return it->second;
+    // if texture hasn't been seen yet, queue it for loading
+    textureIndex[key] = textures.size();
+    TextureData texture;
+    texture.id = 0;
+    texture.type = type;
+    texture.path = path;
+    textures.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    return textures.size() - 1;
+}
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+size_t ModelData::meshBytes(size_t i) const {
+    size_t n_vs = meshes[i].vertices.size();
+    size_t n_inds = meshes[i].indices.size();
+    if (cache) {
+        n_vs = cache->mesh(i).vertexCount;
+        n_inds = cache->mesh(i).indexCount;
+    }
+    // AUTO resolves to a compact format or FULL, FULL is the largest
+    Vertex_format format = meshes[i].format == Vertex_format::AUTO ? Vertex_format::FULL : meshes[i].format;
+    return n_vs * vertexSize(format) + n_inds * sizeof(unsigned int);
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+size_t ModelData::textureBytes(size_t i) const {
+    if (!compressed[i].empty()) return compressed[i].bytes();
+    const ImageData& image = images[i];
+    if (!image.pixels) return 0;
+    // the mip chain adds a third
+    return (size_t)image.width * image.height * image.components * 4 / 3;
+}
 
-        stbi_image_free(data);
-    }
-    else {
-        std::cout << "Texture failed to load at path: " << path << "\n";
-        stbi_image_free(data);
+void ModelData::releaseTextures(void) {
+    // atlas pages are owned by the model once uploaded
+    textures.resize(std::min(textures.size(), firstAtlasPage));
+    for (TextureData& texture : textures) {
+        TextureRegistry::global().release(texture.id);
+        texture.id = 0;
     }
-
-    return textureID;
-}
\ No newline at end of file
+}
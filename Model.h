@@ -1,43 +1,252 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include "Animation.h"
 #include "Mesh.h"
+#include "MipmapGeneration.h"
+#include "ModelCache.h"
+#include "SceneGraph.h"
 #include "Shader.h"
+#include "Texture.h"
+#include "TextureCompression.h"
+#include "TextureRegistry.h"
+#include "TextureResidency.h"
 
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// one vertex and index buffer holding every packed mesh of a vertex format
+struct PackedBuffer {
+    Vertex_format format;
+    GLVertexArray VAO;
+    GLBuffer VBO, EBO;
+};
+
+// meshes of one packed buffer that share a material and a node, drawn with a single glMultiDrawElementsBaseVertex
+struct PackedGroup {
+    size_t buffer;
+    // scene node that places the group, -1 for none
+    int node;
+    std::vector<TextureData> textures;
+    std::vector<unsigned int> meshes;
+    // draw parameters of each mesh, in the same order
+    std::vector<int> counts;
+    std::vector<const void*> offsets;
+    std::vector<int> baseVertices;
+};
+
+// how much work an import puts into the meshes. Part of the compiled cache's key, changing it recompiles the model
+struct ImportProfile {
+    // ASSIMP post processing steps, normals and tangents are generated by processMesh
+    unsigned int postProcess;
+    // merges bit identical vertices, many formats come in with every triangle's corners separate
+    bool weld;
+    // orders triangles for the post-transform vertex cache before clustering, and vertices by first use after
+    bool optimizeVertexCache;
+    // draws outward facing meshlets first
+    bool optimizeOverdraw;
+    // simplifies every mesh into a chain of levels of detail, stored after its indices
+    bool generateLods;
+    // block compresses textures on their first load and reads the KTX2 cache next to them afterwards, which writes
+    // into the asset directories. Normal maps go to BC5. Only the compressed profile turns it on
+    bool compressTextures;
+    // moves small textures of meshes with uvs inside [0, 1] into shared atlas pages, so pack merges meshes that used
+    // different images into one draw. Those textures are decoded instead of compressed. Off in both profiles, pages clamp
+    bool atlasTextures;
+    // filter of the mip chains of decoded textures, built on the loading threads. GPU leaves them to the driver
+    Mip_filter mipFilter;
+    // prints the ImportStats of every import
+    bool report;
+    // streams the textures through it instead of loading them whole, it has to outlive the model. Their finer levels
+    // come in as the Draw overload that takes the viewport reports them needed, call its update once per frame.
+    // compressTextures, atlasTextures and mipFilter don't apply then. Not part of the cache key
+    TextureResidency* residency = nullptr;
+
+    // meshes as ASSIMP delivers them
+    static ImportProfile raw(void);
+    // welding, both orderings, levels of detail and Kaiser filtered mips
+    static ImportProfile optimized(void);
+    // optimized with texture compression
+    static ImportProfile compressed(void);
+};
+
+// what an import did to the meshes, summed over all of them. Zero when the model came from its compiled cache
+struct ImportStats {
+    size_t verticesBefore, verticesAfter, triangles;
+    // transformed vertices per triangle with a VERTEX_CACHE_SIZE entry FIFO, averaged over all triangles
+    float acmrBefore, acmrAfter;
+};
+
+// everything a model reads from disk, filled off the GL thread and turned into GL objects afterwards, piece by piece
+struct ModelData {
+    // mesh textures index into textures until they are uploaded
+    std::vector<MeshData> meshes;
+    // the texture paths are relative to it
+    std::string directory;
+    // set when the meshes come from a compiled model, their vertices and indices then stay in the mapping
+    std::unique_ptr<ModelCache> cache;
+    // unique texture files in first use order. a non zero id holds a reference in TextureRegistry::global()
+    std::vector<TextureData> textures;
+    // one entry per file and color space, a file used as a diffuse and as a linear map is two textures
+    std::unordered_map<TextureKey, unsigned int, TextureKeyHash> textureIndex;
+    // decoded images of the textures that weren't resident yet, empty for the others
+    std::vector<ImageData> images;
+    // the same for textures that were loaded block compressed, which leaves their decoded image empty
+    std::vector<CompressedImage> compressed;
+    // textures from here on are atlas pages, which belong to the model instead of the registry
+    size_t firstAtlasPage = (size_t)-1;
+    // textures whose meshes all moved into an atlas, they aren't uploaded
+    std::vector<bool> inAtlas;
+    Skeleton skeleton;
+    std::vector<AnimationClip> animations;
+    SceneGraph scene;
+    ImportStats stats{};
+
+    // a mesh slot that was given a placeholder because its texture wasn't uploaded yet
+    struct PendingTexture {
+        size_t mesh, slot, texture;
+    };
+    std::vector<PendingTexture> pendingTextures;
+    // index into the model's resident textures of each texture uploaded through ImportProfile::residency, -1 before.
+    // their ids stay 0, the registry doesn't own them
+    std::vector<size_t> resident;
+
+    // index of path in textures, added if it wasn't seen yet in that color space
+    unsigned int textureReference(std::string const& path, std::string const& type, bool srgb);
+    // bytes the upload of mesh i or texture i sends to the GPU, an upper bound for AUTO meshes
+    size_t meshBytes(size_t i) const;
+    size_t textureBytes(size_t i) const;
+    // drops the registry references of a load that won't finish, needs the GL context
+    void releaseTextures(void);
+};
+
 class Model
 {
 public:
-    // stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    // textures referenced by this model, each holds a reference in TextureRegistry::global()
     std::vector<TextureData> textures_loaded;
     std::vector<Mesh> meshes;
     std::string directory;
+    // diffuse maps are stored as sRGB, normal, specular and height maps are linear data either way
     bool gammaCorrection;
+    // GPU vertex layout of the meshes, AUTO picks a compact one per mesh
+    Vertex_format vertexFormat;
+    // whether meshes keep their vertices and indices on the CPU after upload
+    Retain_type retain;
+    ImportProfile profile;
+    ImportStats importStats;
+    // node hierarchy of the file. Each mesh is placed by the world transform of its node, which can be moved at run time
+    SceneGraph scene;
+    // node of each mesh, -1 for skinned meshes, which their bones place
+    std::vector<int> meshNodes;
+    // node hierarchy, bones and clips, empty for models without animation data
+    Skeleton skeleton;
+    std::vector<AnimationClip> animations;
+    // filled by pack, empty otherwise
+    std::vector<PackedBuffer> packedBuffers;
+    std::vector<PackedGroup> packedGroups;
+    // pages of the texture atlas, see ImportProfile::atlasTextures
+    std::vector<GLTexture> atlasPages;
 
     // constructor, expects a filepath to a 3D model.
-    Model(std::string const& path, bool gamma = false);
+    Model(std::string const& path, bool gamma = false, Vertex_format format = Vertex_format::FULL, Retain_type retainData = Retain_type::NONE, ImportProfile importProfile = ImportProfile::optimized());
+    // releases the textures
+    ~Model(void);
+    // the moved from model is left empty, so its destructor releases nothing
+    Model(Model&& other) = default;
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // CPU half of a load on its own, for callers without a GL context such as SoftwareRasterizer. Textures that
+    // aren't resident are decoded into data.images unless the profile compresses them. false if the file can't be read
+    static bool import(std::string const& path, ModelData& data, bool gamma = false, ImportProfile importProfile = ImportProfile::raw());
 
-    // draws the model, and thus all its meshes
+    // draws the model, and thus all its meshes, with whatever "model" uniform is set. Node transforms are ignored
     void Draw(Shader& shader);
+    // places every mesh at model * the world transform of its node, setting the shader's "model" uniform per mesh
+    void Draw(Shader& shader, const glm::mat4& model);
+    // same, with the level of detail of every mesh picked so its error projects to at most pixelError pixels.
+    // takes the matrices the shader is given and the viewport height in pixels, assumes a perspective projection
+    void Draw(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, float viewportHeight, float pixelError = 1.0f);
+    // draws count instances of the model, starting at instance first, with one instanced call per mesh.
+    // the "model" uniform is set to the node transform of each mesh, see InstanceBuffer for the shader inputs
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t count, size_t first = 0);
+    // draws only the meshlets of each mesh that are in view and face the camera, placed like Draw(shader, model).
+    // takes the same matrices the shader is given
+    void DrawCulled(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model);
+
+    // merges all meshes into one vertex and index buffer per vertex format and releases their own buffers.
+    // Draw and DrawCulled then cost one draw call per material instead of one per mesh.
+    void pack(void);
+    bool packed(void) const { return !packedBuffers.empty(); }
+    // true while a ModelStreamer is still filling the model, meshes holds the ones uploaded so far
+    bool loading(void) const { return streaming; }
 
 private:
+    friend class ModelStreamer;
+
+    bool streaming;
+    // textures streamed through ImportProfile::residency and the mesh slots that bind them. A resident texture's name
+    // changes with its levels, so the slots are refreshed before every draw
+    struct ResidentSlot {
+        size_t mesh, slot, texture;
+    };
+    std::vector<std::shared_ptr<ResidentTexture>> residentTextures;
+    std::vector<ResidentSlot> residentSlots;
+
+    // only takes the settings, ModelStreamer fills the model over several frames
+    Model(std::string const& path, bool gamma, Vertex_format format, Retain_type retainData, ImportProfile importProfile, bool load);
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // a compiled copy is kept next to the source and used instead of ASSIMP as long as the source is unchanged.
     void loadModel(std::string const& path);
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene);
+    // CPU half of loading: reads the source or its compiled copy, processes the meshes and decodes the images that
+    // aren't resident. Reads nothing but the settings and touches no GL, so it can run on any thread
+    bool importModel(std::string const& path, ModelData& data) const;
+    // packs the decoded images of meshes that can share pages and remaps their uvs, part of importModel
+    void atlasTextures(ModelData& data) const;
+
+    // reads a compiled model, false if the cache is missing or stale
+    bool importCache(std::string const& cachePath, uint64_t sourceHash, ModelData& data) const;
+
+    // GL half, one piece at a time. beginLoad takes the node hierarchy so meshes draw in place as soon as they are up.
+    // Meshes uploaded before their textures bind placeholder instead
+    void beginLoad(ModelData& data);
+    void uploadTexture(ModelData& data, size_t i);
+    void uploadMesh(ModelData& data, size_t i, unsigned int placeholder);
+    // takes over the textures, skeleton and clips once every piece is uploaded
+    void finishLoad(ModelData& data);
+
+    // whether textures of the type are stored as sRGB
+    bool srgb(std::string const& type) const { return gammaCorrection && type == "texture_diffuse"; }
+
+    // points the mesh slots and packed groups at the current names of the resident textures
+    void refreshResident(void);
+    // reports how densely every resident texture is sampled, from the same arguments as the level of detail selection
+    void requestResident(const glm::mat4& view, const glm::mat4& model, float pixelScale);
+
+    // model * world transform of node
+    glm::mat4 placement(const glm::mat4& model, int node) const;
+
+    // walks the node tree recursively, adds it to data.scene and lists the meshes in draw order with their nodes.
+    // Processing happens later, in parallel.
+    void processNode(aiNode* node, const aiScene* scene, int parent, ModelData& data, std::vector<aiMesh*>& order, std::vector<int>& nodes) const;
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    // converts the vertices and indices and optimizes them as the profile says, CPU only so it can run on any thread
+    MeshData processMesh(aiMesh* mesh, const Skeleton& skeleton, ImportStats& stats) const;
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    std::vector<TextureData> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    // lists the material textures of a given type, texture ids index into data.textures until the images are uploaded.
+    // paths not seen before are added to data.textures.
+    std::vector<TextureData> loadMaterialTextures(ModelData& data, aiMaterial* mat, aiTextureType type, std::string typeName) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "ModelCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char MODEL_CACHE_MAGIC[4] = { 'M', 'D', 'L', 'C' };
+
+////////////////////////////
+/// MappedFile Definitions ///
+////////////////////////////
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) :
+    data{ nullptr }, size{ 0 }, file{ INVALID_HANDLE_VALUE }, mapping{ nullptr }
+{
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length) || length.QuadPart == 0) return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return;
+    data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data) size = length.QuadPart;
+}
+
+MappedFile::~MappedFile(void) {
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const std::string& path) :
+    data{ nullptr }, size{ 0 }
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data = (const unsigned char*)p;
+            size = st.st_size;
+        }
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile(void) {
+    if (data) munmap((void*)data, size);
+}
+#endif
+
+uint64_t hashBytes(const unsigned char* data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool hashFile(const std::string& path, uint64_t& hash) {
+    MappedFile file(path);
+    if (!file.data) return false;
+    hash = hashBytes(file.data, file.size);
+    return true;
+}
+
+uint64_t hashDependencies(const std::vector<std::string>& paths) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const std::string& path : paths) {
+        uint64_t h;
+        if (!hashFile(path, h)) h = 0;
+        hash = hashBytes((const unsigned char*)&h, sizeof(h), hash);
+    }
+    return hash;
+}
+
+////////////////////////////
+/// Cache Writing ///
+////////////////////////////
+
+size_t alignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool writeModelCache(const std::string& path, uint64_t sourceHash, const std::vector<std::string>& dependencies,
+    const std::vector<MeshData>& meshes, const SceneGraph& scene) {
+    std::vector<ModelCacheMesh> meshRecords(meshes.size());
+    std::vector<ModelCacheMaterial> materials;
+    std::vector<ModelCacheTexture> textures;
+    std::string strings;
+    // identical texture lists become one material, identical strings are stored once
+    std::map<std::vector<std::pair<std::string, std::string>>, uint32_t> materialIds;
+    std::map<std::string, uint32_t> stringIds;
+    auto addString = [&](const std::string& s) {
+        auto it = stringIds.find(s);
+        if (it != stringIds.end()) return it->second;
+        uint32_t offset = strings.size();
+        strings.append(s.c_str(), s.size() + 1);
+        stringIds[s] = offset;
+        return offset;
+    };
+    for (size_t i = 0; i < meshes.size(); i++) {
+        std::vector<std::pair<std::string, std::string>> key;
+        for (const TextureData& t : meshes[i].textures) key.push_back({ t.type, t.path });
+        auto it = materialIds.find(key);
+        if (it == materialIds.end()) {
+            ModelCacheMaterial material{ (uint32_t)textures.size(), (uint32_t)key.size() };
+            for (auto& t : key) textures.push_back({ addString(t.first), addString(t.second) });
+            it = materialIds.emplace(key, (uint32_t)materials.size()).first;
+            materials.push_back(material);
+        }
+        meshRecords[i].material = it->second;
+    }
+    // nodes in depth first order, which is also the order they are read back in
+    std::vector<ModelCacheNode> nodes(scene.size());
+    std::vector<int32_t> position(scene.size());
+    for (size_t s = 0; s < scene.size(); s++) {
+        unsigned int id = scene.nodeAt(s);
+        position[id] = s;
+        int parent = scene.parent(id);
+        nodes[s].parent = parent < 0 ? -1 : position[parent];
+        nodes[s].name = addString(scene.name(id));
+        std::memcpy(nodes[s].local, &scene.local(id)[0][0], sizeof(nodes[s].local));
+    }
+    for (size_t i = 0; i < meshes.size(); i++) meshRecords[i].node = meshes[i].node < 0 ? -1 : position[meshes[i].node];
+    std::vector<uint32_t> dependencyRecords;
+    for (const std::string& d : dependencies) dependencyRecords.push_back(addString(d));
+
+    ModelCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_CACHE_MAGIC, 4);
+    header.version = MODEL_CACHE_VERSION;
+    header.vertexSize = sizeof(VertexData);
+    header.meshletSize = sizeof(Meshlet);
+    header.sourceHash = sourceHash;
+    header.dependencyHash = hashDependencies(dependencies);
+    header.meshCount = meshes.size();
+    header.materialCount = materials.size();
+    header.textureCount = textures.size();
+    header.stringSize = strings.size();
+    header.nodeCount = nodes.size();
+    header.dependencyCount = dependencyRecords.size();
+    size_t offset = sizeof(ModelCacheHeader);
+    header.meshOffset = offset = alignUp(offset, 16);
+    offset += meshRecords.size() * sizeof(ModelCacheMesh);
+    header.materialOffset = offset = alignUp(offset, 16);
+    offset += materials.size() * sizeof(ModelCacheMaterial);
+    header.textureOffset = offset = alignUp(offset, 16);
+    offset += textures.size() * sizeof(ModelCacheTexture);
+    header.dependencyOffset = offset = alignUp(offset, 16);
+    offset += dependencyRecords.size() * sizeof(uint32_t);
+    header.nodeOffset = offset = alignUp(offset, 16);
+    offset += nodes.size() * sizeof(ModelCacheNode);
+    header.stringOffset = offset;
+    offset += strings.size();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        ModelCacheMesh& m = meshRecords[i];
+        m.vertexCount = meshes[i].vertices.size();
+        m.indexCount = meshes[i].indices.size();
+        m.meshletCount = meshes[i].meshlets.size();
+        m.lodCount = meshes[i].lods.size();
+        m.vertexOffset = offset = alignUp(offset, 16);
+        offset += m.vertexCount * sizeof(VertexData);
+        m.indexOffset = offset = alignUp(offset, 16);
+        offset += m.indexCount * sizeof(unsigned int);
+        m.meshletOffset = offset = alignUp(offset, 16);
+        offset += m.meshletCount * sizeof(Meshlet);
+        m.lodOffset = offset = alignUp(offset, 16);
+        offset += m.lodCount * sizeof(MeshLod);
+    }
+    header.fileSize = offset;
+
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        std::cout << "ERROR::MODEL_CACHE:: can't write " << tmp << "\n";
+        return false;
+    }
+    size_t written = 0;
+    bool ok = true;
+    auto put = [&](size_t at, const void* p, size_t n) {
+        static const char zeros[16] = {};
+        while (ok && written < at) {
+            size_t pad = std::min(at - written, sizeof(zeros));
+            ok = std::fwrite(zeros, 1, pad, f) == pad;
+            written += pad;
+        }
+        if (ok && n) ok = std::fwrite(p, 1, n, f) == n;
+        written += n;
+    };
+    put(0, &header, sizeof(header));
+    put(header.meshOffset, meshRecords.data(), meshRecords.size() * sizeof(ModelCacheMesh));
+    put(header.materialOffset, materials.data(), materials.size() * sizeof(ModelCacheMaterial));
+    put(header.textureOffset, textures.data(), textures.size() * sizeof(ModelCacheTexture));
+    put(header.dependencyOffset, dependencyRecords.data(), dependencyRecords.size() * sizeof(uint32_t));
+    put(header.nodeOffset, nodes.data(), nodes.size() * sizeof(ModelCacheNode));
+    put(header.stringOffset, strings.data(), strings.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const ModelCacheMesh& m = meshRecords[i];
+        put(m.vertexOffset, meshes[i].vertices.data(), m.vertexCount * sizeof(VertexData));
+        put(m.indexOffset, meshes[i].indices.data(), m.indexCount * sizeof(unsigned int));
+        put(m.meshletOffset, meshes[i].meshlets.data(), m.meshletCount * sizeof(Meshlet));
+        put(m.lodOffset, meshes[i].lods.data(), m.lodCount * sizeof(MeshLod));
+    }
+    ok = std::fclose(f) == 0 && ok;
+    // rename doesn't replace an existing file everywhere
+    std::remove(path.c_str());
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cout << "ERROR::MODEL_CACHE:: failed writing " << path << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////
+/// ModelCache Definitions ///
+////////////////////////////
+
+ModelCache::ModelCache(const std::string& path, uint64_t sourceHash) :
+    file{ path }, header{ nullptr }, meshes{ nullptr }, materials{ nullptr }, textures{ nullptr }, nodes{ nullptr }, strings{ nullptr }
+{
+    if (!file.data || file.size < sizeof(ModelCacheHeader)) return;
+    const ModelCacheHeader* h = (const ModelCacheHeader*)file.data;
+    if (std::memcmp(h->magic, MODEL_CACHE_MAGIC, 4) != 0 || h->version != MODEL_CACHE_VERSION) return;
+    if (h->vertexSize != sizeof(VertexData) || h->meshletSize != sizeof(Meshlet)) return;
+    if (h->sourceHash != sourceHash || h->fileSize != file.size) return;
+
+    // every range has to lie inside the file, a truncated or corrupt cache is treated as stale
+    auto inside = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset <= file.size && count <= (file.size - offset) / size;
+    };
+    if (!inside(h->meshOffset, h->meshCount, sizeof(ModelCacheMesh))) return;
+    if (!inside(h->materialOffset, h->materialCount, sizeof(ModelCacheMaterial))) return;
+    if (!inside(h->textureOffset, h->textureCount, sizeof(ModelCacheTexture))) return;
+    if (!inside(h->nodeOffset, h->nodeCount, sizeof(ModelCacheNode))) return;
+    if (!inside(h->dependencyOffset, h->dependencyCount, sizeof(uint32_t))) return;
+    if (!inside(h->stringOffset, h->stringSize, 1)) return;
+    const ModelCacheMesh* ms = (const ModelCacheMesh*)(file.data + h->meshOffset);
+    const ModelCacheMaterial* mats = (const ModelCacheMaterial*)(file.data + h->materialOffset);
+    const ModelCacheTexture* texs = (const ModelCacheTexture*)(file.data + h->textureOffset);
+    const ModelCacheNode* ns = (const ModelCacheNode*)(file.data + h->nodeOffset);
+    const char* strs = (const char*)(file.data + h->stringOffset);
+    const uint32_t* deps = (const uint32_t*)(file.data + h->dependencyOffset);
+    for (uint32_t i = 0; i < h->meshCount; i++) {
+        const ModelCacheMesh& m = ms[i];
+        if (!inside(m.vertexOffset, m.vertexCount, sizeof(VertexData))) return;
+        if (!inside(m.indexOffset, m.indexCount, sizeof(unsigned int))) return;
+        if (!inside(m.meshletOffset, m.meshletCount, sizeof(Meshlet))) return;
+        if (!inside(m.lodOffset, m.lodCount, sizeof(MeshLod))) return;
+        const MeshLod* levels = (const MeshLod*)(file.data + m.lodOffset);
+        for (uint32_t j = 0; j < m.lodCount; j++) {
+            if (levels[j].firstIndex > m.indexCount || levels[j].indexCount > m.indexCount - levels[j].firstIndex) return;
+        }
+        // indices and meshlets aren't walked, the file is only written from an import and its size is checked.
+        // Indices into no vertices at all are the one case that can't come from there
+        if (m.indexCount && !m.vertexCount) return;
+        if (m.material >= h->materialCount) return;
+        if (m.node < -1 || m.node >= (int64_t)h->nodeCount) return;
+    }
+    for (uint32_t i = 0; i < h->materialCount; i++) {
+        if (mats[i].firstTexture > h->textureCount || mats[i].textureCount > h->textureCount - mats[i].firstTexture) return;
+    }
+    if (h->stringSize && strs[h->stringSize - 1] != '\0') return;
+    for (uint32_t i = 0; i < h->textureCount; i++) {
+        if (texs[i].type >= h->stringSize || texs[i].path >= h->stringSize) return;
+    }
+    for (uint32_t i = 0; i < h->nodeCount; i++) {
+        if (ns[i].parent < -1 || ns[i].parent >= (int64_t)i || ns[i].name >= h->stringSize) return;
+    }
+    for (uint32_t i = 0; i < h->dependencyCount; i++) {
+        if (deps[i] >= h->stringSize) return;
+    }
+
+    // last, it reads every dependency. Textures are only referenced, editing one doesn't change the meshes
+    std::vector<std::string> hashed;
+    for (uint32_t i = 0; i < h->dependencyCount; i++) hashed.push_back(strs + deps[i]);
+    if (hashDependencies(hashed) != h->dependencyHash) return;
+
+    header = h;
+    meshes = ms;
+    materials = mats;
+    textures = texs;
+    nodes = ns;
+    strings = strs;
+}
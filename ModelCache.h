@@ -0,0 +1,140 @@
+#ifndef MODEL_CACHE_HH
+#define MODEL_CACHE_HH
+
+#include "Mesh.h"
+#include "SceneGraph.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compiled model format, written after an Assimp import and loaded with a header read and pointer fixups.
+// All sections are raw arrays of the in-memory structs, so the file is only valid for the build that wrote it,
+// which the header checks through the version and struct sizes.
+// layout: header | meshes | materials | textures | dependencies | nodes | strings | vertex, index and meshlet data
+// (16 byte aligned)
+
+#define MODEL_CACHE_EXTENSION ".mcache"
+#define MODEL_CACHE_VERSION 5
+
+struct ModelCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t meshletSize;
+    // FNV-1a of the source file's contents
+    uint64_t sourceHash;
+    // FNV-1a over the hashes of every other file the import read, see hashDependencies. Textures aren't included
+    uint64_t dependencyHash;
+    uint64_t fileSize;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t textureCount;
+    uint32_t stringSize;
+    uint32_t nodeCount;
+    uint32_t dependencyCount;
+    uint64_t meshOffset;
+    uint64_t materialOffset;
+    uint64_t textureOffset;
+    uint64_t stringOffset;
+    uint64_t nodeOffset;
+    // string offsets of the paths of the other files
+    uint64_t dependencyOffset;
+};
+
+struct ModelCacheMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t meshletOffset;
+    uint64_t lodOffset;
+    uint32_t vertexCount;
+    // every level of detail included
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    uint32_t lodCount;
+    uint32_t material;
+    // -1 for meshes without a node
+    int32_t node;
+};
+
+// a material is a run of texture records
+struct ModelCacheMaterial {
+    uint32_t firstTexture;
+    uint32_t textureCount;
+};
+
+// offsets of null terminated strings in the string section
+struct ModelCacheTexture {
+    uint32_t type;
+    uint32_t path;
+};
+
+// scene graph nodes in depth first order, parents index earlier records
+struct ModelCacheNode {
+    int32_t parent;
+    uint32_t name;
+    float local[16];
+};
+
+// read only view of a whole file, memory mapped where the platform allows it
+class MappedFile {
+public:
+    const unsigned char* data;
+    size_t size;
+
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile(void);
+
+private:
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+};
+
+// 64 bit FNV-1a, used to tell whether a source asset changed
+uint64_t hashBytes(const unsigned char* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+// false if the file can't be read
+bool hashFile(const std::string& path, uint64_t& hash);
+// combined hash of a list of files, a missing file counts too so the result changes once it appears
+uint64_t hashDependencies(const std::vector<std::string>& paths);
+
+// writes meshes, their texture references and the node hierarchy, identical texture lists share a material.
+// dependencies are the other files the import read, e.g. an .obj's .mtl.
+// goes through a temporary file so a crash never leaves a half written cache behind.
+bool writeModelCache(const std::string& path, uint64_t sourceHash, const std::vector<std::string>& dependencies,
+    const std::vector<MeshData>& meshes, const SceneGraph& scene);
+
+// a validated cache file, everything points into the mapping
+class ModelCache {
+public:
+    // opens and validates the header and section ranges, valid() is false for a missing, stale or truncated file.
+    // Stale includes any change to a dependency
+    ModelCache(const std::string& path, uint64_t sourceHash);
+
+    bool valid(void) const { return header != nullptr; }
+    const ModelCacheHeader& info(void) const { return *header; }
+    const ModelCacheMesh& mesh(size_t i) const { return meshes[i]; }
+    const ModelCacheMaterial& material(size_t i) const { return materials[i]; }
+    const ModelCacheTexture& texture(size_t i) const { return textures[i]; }
+    const ModelCacheNode& node(size_t i) const { return nodes[i]; }
+    const char* string(uint32_t offset) const { return strings + offset; }
+
+    const VertexData* vertices(const ModelCacheMesh& m) const { return (const VertexData*)(file.data + m.vertexOffset); }
+    const unsigned int* indices(const ModelCacheMesh& m) const { return (const unsigned int*)(file.data + m.indexOffset); }
+    const Meshlet* meshlets(const ModelCacheMesh& m) const { return (const Meshlet*)(file.data + m.meshletOffset); }
+    const MeshLod* lods(const ModelCacheMesh& m) const { return (const MeshLod*)(file.data + m.lodOffset); }
+
+private:
+    MappedFile file;
+    const ModelCacheHeader* header;
+    const ModelCacheMesh* meshes;
+    const ModelCacheMaterial* materials;
+    const ModelCacheTexture* textures;
+    const ModelCacheNode* nodes;
+    const char* strings;
+};
+
+#endif
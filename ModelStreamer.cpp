@@ -0,0 +1,147 @@
+#include "ModelStreamer.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+
+ModelStreamer::ModelStreamer(size_t bytesPerFrame, double msPerFrame) :
+    byteBudget{ bytesPerFrame },
+    timeBudget{ msPerFrame },
+    stopping{ false }
+{
+    // 1x1 mid grey, neutral for diffuse and specular maps
+    placeholderTexture = GLTexture::create();
+    unsigned char grey[4] = { 128, 128, 128, 255 };
+    glBindTexture(GL_TEXTURE_2D, placeholderTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // imports one model at a time, the per mesh and per image work inside it runs on the pool.
+    // a separate thread instead of a pool job, so the render thread never picks up a whole import while it
+    // helps the pool in a parallelFor of its own. Helpers only run their own chunks, which keeps it off the
+    // import's per mesh jobs as well
+    loader = std::thread([this] {
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !importing.empty(); });
+                if (stopping) return;
+                job = importing.front();
+                importing.pop_front();
+            }
+            // nobody but us holds the model anymore, skip the work
+            if (job->model.use_count() > 1) job->imported = job->model->importModel(job->path, job->data);
+            std::lock_guard<std::mutex> lock(mutex);
+            imported.push_back(job);
+        }
+    });
+}
+
+ModelStreamer::~ModelStreamer(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    loader.join();
+    // nothing of these is uploaded yet
+    for (std::shared_ptr<Job>& job : imported) {
+        job->data.releaseTextures();
+        job->model->streaming = false;
+    }
+    for (std::shared_ptr<Job>& job : uploading) {
+        if (!job->imported) {
+            job->model->streaming = false;
+            continue;
+        }
+        // meshes that are up bind the textures, so the model takes the references over as if it had finished.
+        // slots still on the placeholder, which goes with the streamer, are left without a texture
+        for (const ModelData::PendingTexture& pending : job->data.pendingTextures) {
+            if (pending.texture >= job->texture) job->model->meshes[pending.mesh].textures[pending.slot].id = 0;
+        }
+        job->model->finishLoad(job->data);
+    }
+    for (std::shared_ptr<Job>& job : importing) job->model->streaming = false;
+}
+
+std::shared_ptr<Model> ModelStreamer::load(std::string const& path, bool gamma, Vertex_format format, Retain_type retainData, ImportProfile importProfile) {
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->model = std::shared_ptr<Model>(new Model(path, gamma, format, retainData, importProfile, false));
+    job->path = path;
+    job->imported = false;
+    job->mesh = 0;
+    job->texture = 0;
+    // the caller's reference has to exist before the loader can see the job, or it looks abandoned
+    std::shared_ptr<Model> model = job->model;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        importing.push_back(job);
+    }
+    wake.notify_one();
+    return model;
+}
+
+size_t ModelStreamer::pending(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return importing.size() + imported.size() + uploading.size();
+}
+
+bool ModelStreamer::uploadNext(Job& job, size_t& bytes) {
+    Model& model = *job.model;
+    ModelData& data = job.data;
+    // geometry first so something shows up early, it draws with the placeholder until its textures follow
+    if (job.mesh < data.meshes.size()) {
+        bytes += data.meshBytes(job.mesh);
+        model.uploadMesh(data, job.mesh++, placeholderTexture);
+        return true;
+    }
+    if (job.texture < data.textures.size()) {
+        bytes += data.textureBytes(job.texture);
+        model.uploadTexture(data, job.texture++);
+        return true;
+    }
+    model.finishLoad(data);
+    return false;
+}
+
+void ModelStreamer::update(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!imported.empty()) {
+            std::shared_ptr<Job>& job = imported.front();
+            if (job->imported) job->model->beginLoad(job->data);
+            uploading.push_back(job);
+            imported.pop_front();
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    bool first = true;
+    while (!uploading.empty()) {
+        Job& job = *uploading.front();
+        if (job.model.use_count() == 1 || !job.imported) {
+            // abandoned or failed, an empty model counts as loaded
+            job.data.releaseTextures();
+            job.model->streaming = false;
+            uploading.pop_front();
+            continue;
+        }
+        // stop before a piece that would overshoot the byte budget, unless nothing went through yet
+        if (!first) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (timeBudget > 0 && ms >= timeBudget) break;
+            if (byteBudget > 0) {
+                size_t next = 0;
+                if (job.mesh < job.data.meshes.size()) next = job.data.meshBytes(job.mesh);
+                else if (job.texture < job.data.textures.size()) next = job.data.textureBytes(job.texture);
+                if (bytes + next > byteBudget) break;
+            }
+        }
+        first = false;
+        if (!uploadNext(job, bytes)) uploading.pop_front();
+    }
+}
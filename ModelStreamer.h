@@ -0,0 +1,72 @@
+#ifndef MODEL_STREAMER_HH
+#define MODEL_STREAMER_HH
+
+#include "GLHandle.h"
+#include "Model.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads models without stalling the render loop. load returns an empty model at once, a loader thread imports
+// it (mesh processing and image decoding fan out on the global ThreadPool) and update, called once per frame
+// with the GL context current, creates its buffers and textures until the frame's budget is used up.
+// A model that is still loading draws the meshes uploaded so far, their textures are a flat grey placeholder
+// until the real ones arrive. Callers that want a stand-in for the whole model can draw one while
+// loading() is true and meshes is still empty.
+class ModelStreamer {
+public:
+    // upload budget of one update, bytes sent to the GPU and milliseconds spent. 0 means no limit.
+    // one piece (a mesh or a texture) always goes through, so a piece bigger than the budget still loads
+    size_t byteBudget;
+    double timeBudget;
+
+    ModelStreamer(size_t bytesPerFrame = 8 << 20, double msPerFrame = 2.0);
+    // stops the loader, unfinished models stay as far as they got and keep the textures they use. Needs the GL context
+    ~ModelStreamer(void);
+    ModelStreamer(const ModelStreamer&) = delete;
+    ModelStreamer& operator=(const ModelStreamer&) = delete;
+
+    // same arguments as the Model constructor. A load whose model is dropped by everyone else is abandoned.
+    // if the file can't be read the model ends up empty, like a failed synchronous load
+    std::shared_ptr<Model> load(std::string const& path, bool gamma = false, Vertex_format format = Vertex_format::FULL, Retain_type retainData = Retain_type::NONE, ImportProfile importProfile = ImportProfile::optimized());
+    // uploads within the budget, render thread only
+    void update(void);
+    // loads that aren't completely uploaded yet
+    size_t pending(void);
+
+    // the texture meshes bind while theirs is still on the way
+    unsigned int placeholder(void) const { return placeholderTexture; }
+
+private:
+    struct Job {
+        std::shared_ptr<Model> model;
+        std::string path;
+        ModelData data;
+        bool imported;
+        // next mesh and texture to upload
+        size_t mesh, texture;
+    };
+
+    // waiting for and done with the import, shared with the loader thread
+    std::deque<std::shared_ptr<Job>> importing;
+    std::deque<std::shared_ptr<Job>> imported;
+    // render thread only
+    std::deque<std::shared_ptr<Job>> uploading;
+
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    GLTexture placeholderTexture;
+
+    // false once the job has nothing left to upload
+    bool uploadNext(Job& job, size_t& bytes);
+};
+
+#endif
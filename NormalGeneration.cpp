@@ -0,0 +1,270 @@
+#include "NormalGeneration.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define NORMALS_SSE
+#endif
+
+namespace {
+
+// fixed so the chunk layout, and with it the floating point summation order, never depends on the machine
+const size_t MAX_CHUNKS = 8;
+const size_t MIN_TRIS_PER_CHUNK = 4096;
+
+// 4 wide float helper, one xyz vector per register
+#ifdef NORMALS_SSE
+struct V4 {
+    __m128 m;
+};
+inline V4 load3(const float* p) { return { _mm_set_ps(0, p[2], p[1], p[0]) }; }
+inline V4 load4(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void store4(float* p, V4 a) { _mm_storeu_ps(p, a.m); }
+inline V4 operator+(V4 a, V4 b) { return { _mm_add_ps(a.m, b.m) }; }
+inline V4 operator-(V4 a, V4 b) { return { _mm_sub_ps(a.m, b.m) }; }
+inline V4 operator*(V4 a, float s) { return { _mm_mul_ps(a.m, _mm_set1_ps(s)) }; }
+inline V4 cross(V4 a, V4 b) {
+    __m128 a_yzx = _mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b.m, b.m, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a.m, b_yzx), _mm_mul_ps(a_yzx, b.m));
+    return { _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)) };
+}
+inline float dot3(V4 a, V4 b) {
+    __m128 p = _mm_mul_ps(a.m, b.m);
+    __m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(p, y), z));
+}
+#else
+struct V4 {
+    float m[4];
+};
+inline V4 load3(const float* p) { return { { p[0], p[1], p[2], 0 } }; }
+inline V4 load4(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+inline void store4(float* p, V4 a) { std::memcpy(p, a.m, sizeof(a.m)); }
+inline V4 operator+(V4 a, V4 b) { return { { a.m[0] + b.m[0], a.m[1] + b.m[1], a.m[2] + b.m[2], a.m[3] + b.m[3] } }; }
+inline V4 operator-(V4 a, V4 b) { return { { a.m[0] - b.m[0], a.m[1] - b.m[1], a.m[2] - b.m[2], a.m[3] - b.m[3] } }; }
+inline V4 operator*(V4 a, float s) { return { { a.m[0] * s, a.m[1] * s, a.m[2] * s, a.m[3] * s } }; }
+inline V4 cross(V4 a, V4 b) {
+    return { { a.m[1] * b.m[2] - a.m[2] * b.m[1], a.m[2] * b.m[0] - a.m[0] * b.m[2], a.m[0] * b.m[1] - a.m[1] * b.m[0], 0 } };
+}
+inline float dot3(V4 a, V4 b) { return a.m[0] * b.m[0] + a.m[1] * b.m[1] + a.m[2] * b.m[2]; }
+#endif
+
+inline void store3(float* p, V4 a) {
+    float tmp[4];
+    store4(tmp, a);
+    p[0] = tmp[0];
+    p[1] = tmp[1];
+    p[2] = tmp[2];
+}
+
+inline V4 normalize(V4 a) {
+    float len = std::sqrt(dot3(a, a));
+    return len > 0 ? a * (1 / len) : a;
+}
+
+size_t chunkCount(size_t n_tris) {
+    return std::max<size_t>(1, std::min(MAX_CHUNKS, n_tris / MIN_TRIS_PER_CHUNK));
+}
+
+// maps every vertex to the first vertex sharing its exact position
+std::vector<unsigned int> weld(AttributeView positions, size_t n_vs) {
+    struct Key {
+        float p[3];
+        bool operator==(const Key& o) const { return std::memcmp(p, o.p, sizeof(p)) == 0; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            unsigned int b[3];
+            std::memcpy(b, k.p, sizeof(b));
+            return (b[0] * 73856093u) ^ (b[1] * 19349663u) ^ (b[2] * 83492791u);
+        }
+    };
+    std::vector<unsigned int> canon(n_vs);
+    std::unordered_map<Key, unsigned int, KeyHash> first;
+    first.reserve(n_vs);
+    for (unsigned int v = 0; v < n_vs; v++) {
+        Key k{ { positions[v][0], positions[v][1], positions[v][2] } };
+        canon[v] = first.emplace(k, v).first->second;
+    }
+    return canon;
+}
+
+// direction of growing u on the face, and which way v turns from it: 1 or -1, 0 if the uv mapping is degenerate.
+// Faces of a mirrored uv layout are -1
+int faceTangent(AttributeView positions, AttributeView texcoords, const unsigned int* i, V4& T) {
+    V4 p0 = load3(positions[i[0]]);
+    V4 e1 = load3(positions[i[1]]) - p0;
+    V4 e2 = load3(positions[i[2]]) - p0;
+    float du1 = texcoords[i[1]][0] - texcoords[i[0]][0], dv1 = texcoords[i[1]][1] - texcoords[i[0]][1];
+    float du2 = texcoords[i[2]][0] - texcoords[i[0]][0], dv2 = texcoords[i[2]][1] - texcoords[i[0]][1];
+    float r = du1 * dv2 - du2 * dv1;
+    // no usable direction
+    if (std::fabs(r) < 1e-20f) return 0;
+    T = (e1 * dv2 - e2 * dv1) * (1 / r);
+    V4 B = (e2 * du1 - e1 * du2) * (1 / r);
+    return dot3(cross(cross(e1, e2), T), B) < 0 ? -1 : 1;
+}
+
+// angle between two edges seen along n, what MikkTSpace weights a corner's tangent by
+float cornerAngle(V4 n, V4 a, V4 b) {
+    a = normalize(a - n * dot3(n, a));
+    b = normalize(b - n * dot3(n, b));
+    return std::acos(std::min(std::max(dot3(a, b), -1.0f), 1.0f));
+}
+
+// gives the faces of the minority handedness their own copy of every vertex they share with the other side, the
+// split MikkTSpace makes along mirrored uv seams
+void splitMirroredVertices(std::vector<VertexData>& vertices, std::vector<unsigned int>& indices) {
+    const size_t stride = sizeof(VertexData) / sizeof(float);
+    AttributeView pos{ &vertices[0].Position.x, stride };
+    AttributeView uvs{ &vertices[0].TexCoords.x, stride };
+    size_t n_tris = indices.size() / 3;
+    std::vector<int> sides(n_tris);
+    // faces of either handedness around every vertex
+    std::vector<unsigned int> count(2 * vertices.size(), 0);
+    for (size_t t = 0; t < n_tris; t++) {
+        V4 T;
+        sides[t] = faceTangent(pos, uvs, &indices[3 * t], T);
+        if (sides[t] == 0) continue;
+        for (int k = 0; k < 3; k++) count[2 * indices[3 * t + k] + (sides[t] < 0)]++;
+    }
+    const unsigned int NONE = ~0u;
+    std::vector<unsigned int> twin(vertices.size(), NONE);
+    for (size_t t = 0; t < n_tris; t++) {
+        if (sides[t] == 0) continue;
+        for (int k = 0; k < 3; k++) {
+            unsigned int& v = indices[3 * t + k];
+            if (v >= twin.size() || count[2 * v] == 0 || count[2 * v + 1] == 0) continue;
+            // the side with fewer faces moves
+            int minority = count[2 * v + 1] <= count[2 * v] ? -1 : 1;
+            if (sides[t] != minority) continue;
+            if (twin[v] == NONE) {
+                twin[v] = (unsigned int)vertices.size();
+                VertexData copy = vertices[v];
+                vertices.push_back(copy);
+            }
+            v = twin[v];
+        }
+    }
+}
+
+}
+
+void generateNormals(AttributeView positions, AttributeView normals, size_t n_vs, const unsigned int* indices, size_t n_inds, bool weldPositions) {
+    ThreadPool& pool = ThreadPool::global();
+    size_t n_tris = n_inds / 3;
+    std::vector<unsigned int> canon;
+    if (weldPositions) canon = weld(positions, n_vs);
+    auto id = [&canon](unsigned int v) { return canon.empty() ? v : canon[v]; };
+
+    // area weighted face normals into per-chunk buffers
+    size_t chunks = chunkCount(n_tris);
+    std::vector<std::vector<float>> acc(chunks);
+    pool.parallelFor(n_tris, [&](size_t begin, size_t end, size_t c) {
+        std::vector<float>& sum = acc[c];
+        sum.assign(4 * n_vs, 0.0f);
+        for (size_t t = begin; t < end; t++) {
+            unsigned int i0 = id(indices[3 * t]), i1 = id(indices[3 * t + 1]), i2 = id(indices[3 * t + 2]);
+            V4 p0 = load3(positions[i0]);
+            V4 n = cross(load3(positions[i1]) - p0, load3(positions[i2]) - p0);
+            store4(&sum[4 * i0], load4(&sum[4 * i0]) + n);
+            store4(&sum[4 * i1], load4(&sum[4 * i1]) + n);
+            store4(&sum[4 * i2], load4(&sum[4 * i2]) + n);
+        }
+    }, chunks);
+
+    // reduce in chunk order
+    pool.parallelFor(n_vs, [&](size_t begin, size_t end, size_t) {
+        for (size_t v = begin; v < end; v++) {
+            size_t s = id(v);
+            V4 n = load4(&acc[0][4 * s]);
+            for (size_t c = 1; c < chunks; c++) n = n + load4(&acc[c][4 * s]);
+            store3(normals[v], normalize(n));
+        }
+    });
+}
+
+void generateTangents(AttributeView positions, AttributeView normals, AttributeView texcoords, AttributeView tangents, size_t n_vs, const unsigned int* indices, size_t n_inds) {
+    ThreadPool& pool = ThreadPool::global();
+    size_t n_tris = n_inds / 3;
+
+    // per-chunk sums of the angle weighted corner tangents (xyz) and the angles (w), one sum per handedness,
+    // 8 floats a vertex
+    size_t chunks = chunkCount(n_tris);
+    std::vector<std::vector<float>> acc(chunks);
+    pool.parallelFor(n_tris, [&](size_t begin, size_t end, size_t c) {
+        std::vector<float>& sum = acc[c];
+        sum.assign(8 * n_vs, 0.0f);
+        for (size_t t = begin; t < end; t++) {
+            const unsigned int* i = &indices[3 * t];
+            V4 T;
+            int side = faceTangent(positions, texcoords, i, T);
+            if (side == 0) continue;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = i[k];
+                V4 N = load3(normals[v]);
+                V4 p = load3(positions[v]);
+                float angle = cornerAngle(N, load3(positions[i[(k + 1) % 3]]) - p, load3(positions[i[(k + 2) % 3]]) - p);
+                // projected into the vertex's tangent plane before it's summed
+                float* s = &sum[8 * v + (side < 0 ? 4 : 0)];
+                store4(s, load4(s) + normalize(T - N * dot3(N, T)) * angle);
+                s[3] += angle;
+            }
+        }
+    }, chunks);
+
+    pool.parallelFor(n_vs, [&](size_t begin, size_t end, size_t) {
+        for (size_t v = begin; v < end; v++) {
+            V4 sides[2] = { load4(&acc[0][8 * v]), load4(&acc[0][8 * v + 4]) };
+            for (size_t c = 1; c < chunks; c++) {
+                sides[0] = sides[0] + load4(&acc[c][8 * v]);
+                sides[1] = sides[1] + load4(&acc[c][8 * v + 4]);
+            }
+            // opposite handedness never mixes, a vertex shared by both keeps the side with more angle around it
+            float positive[4], negative[4];
+            store4(positive, sides[0]);
+            store4(negative, sides[1]);
+            int side = negative[3] > positive[3] ? 1 : 0;
+            V4 N = load3(normals[v]);
+            V4 T = normalize(sides[side] - N * dot3(N, sides[side]));
+            store3(tangents[v], T);
+            tangents[v][3] = side ? -1.0f : 1.0f;
+        }
+    });
+}
+
+std::vector<float> generateNormals(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, bool weldPositions) {
+    std::vector<float> normals(vertices.size(), 0.0f);
+    size_t n_vs = vertices.size() / 3;
+    generateNormals({ const_cast<float*>(vertices.data()), 3 }, { normals.data(), 3 }, n_vs, indices.data(), indices.size(), weldPositions);
+    return normals;
+}
+
+void generateNormalsAndTangents(std::vector<VertexData>& vertices, std::vector<unsigned int>& indices, bool normals, bool tangents) {
+    if (vertices.empty()) return;
+    const size_t stride = sizeof(VertexData) / sizeof(float);
+    AttributeView pos{ &vertices[0].Position.x, stride };
+    AttributeView nrm{ &vertices[0].Normal.x, stride };
+    if (normals) generateNormals(pos, nrm, vertices.size(), indices.data(), indices.size(), true);
+    if (tangents) {
+        // after the normals, the copies share them. The split can grow vertices, so the views are taken after it
+        splitMirroredVertices(vertices, indices);
+        pos = { &vertices[0].Position.x, stride };
+        nrm = { &vertices[0].Normal.x, stride };
+        AttributeView uvs{ &vertices[0].TexCoords.x, stride };
+        std::vector<float> tan(4 * vertices.size());
+        generateTangents(pos, nrm, uvs, { tan.data(), 4 }, vertices.size(), indices.data(), indices.size());
+        for (size_t v = 0; v < vertices.size(); v++) {
+            vertices[v].Tangent = glm::vec3(tan[4 * v], tan[4 * v + 1], tan[4 * v + 2]);
+            vertices[v].Bitangent = glm::cross(vertices[v].Normal, vertices[v].Tangent) * tan[4 * v + 3];
+        }
+    }
+}
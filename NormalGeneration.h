@@ -0,0 +1,36 @@
+#ifndef NORMAL_GENERATION_HH
+#define NORMAL_GENERATION_HH
+
+#include <vector>
+
+struct VertexData;
+
+// strided view of a float attribute, lets the same kernels read Shape's flat arrays and Mesh's VertexData
+struct AttributeView {
+    float* data;
+    // distance between consecutive elements in floats
+    size_t stride;
+
+    float* operator[](size_t i) const { return data + i * stride; }
+};
+
+// Generic parallel normal and tangent generation
+// Face contributions are accumulated on the global ThreadPool into a fixed number of per-chunk buffers
+// and summed in chunk order, so results are bit identical from run to run and machine to machine.
+// weldPositions smooths across vertices that were split only for texture or material seams
+// (what Assimp's aiProcess_GenSmoothNormals does), leave it off when splits are meant as hard edges.
+void generateNormals(AttributeView positions, AttributeView normals, size_t n_vs, const unsigned int* indices, size_t n_inds, bool weldPositions = false);
+
+// Tangent basis weighted like MikkTSpace: every corner's face tangent is projected into the plane of
+// the vertex normal and weighted by the corner's angle, faces of opposite uv handedness are summed apart.
+// The bitangent handedness goes in w, bitangent = w * cross(normal, tangent). tangents needs 4 floats per element.
+// A vertex shared by both handednesses (the seam of a mirrored uv layout) keeps the side with more angle around it,
+// MikkTSpace splits such vertices, which generateNormalsAndTangents does before it calls this.
+void generateTangents(AttributeView positions, AttributeView normals, AttributeView texcoords, AttributeView tangents, size_t n_vs, const unsigned int* indices, size_t n_inds);
+
+// convenience overloads for the engine's vertex layouts
+std::vector<float> generateNormals(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, bool weldPositions = false);
+// with tangents, vertices on mirrored uv seams are split first, which appends vertices and rewrites indices
+void generateNormalsAndTangents(std::vector<VertexData>& vertices, std::vector<unsigned int>& indices, bool normals = true, bool tangents = true);
+
+#endif
@@ -1,4 +1,4 @@
-#include "Runtimefunctions.h"
+#include "RuntimeFunctions.h"
 #include "Camera.h"
 
 #include <stb/stb_image_comp.h>
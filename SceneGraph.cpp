@@ -0,0 +1,102 @@
+#include "SceneGraph.h"
+#include "MatrixMath.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+// subtrees smaller than this are cheaper to update on the calling thread than to split up
+const size_t PARALLEL_SUBTREE = 4096;
+
+SceneGraph::SceneGraph(void) :
+    lastUpdated{ 0 }
+{}
+
+unsigned int SceneGraph::addNode(int parent, const glm::mat4& local, const std::string& name) {
+    unsigned int id = slots.size();
+    size_t slot = ids.size();
+    int parentSlot = -1;
+    if (parent >= 0) {
+        parentSlot = slots[parent];
+        slot = parentSlot + sizes[parentSlot];
+        for (int p = parentSlot; p >= 0; p = parents[p]) sizes[p]++;
+    }
+    if (slot < ids.size()) {
+        // everything from slot on moves back by one
+        for (int& p : parents) {
+            if (p >= (int)slot) p++;
+        }
+        for (size_t s = slot; s < ids.size(); s++) slots[ids[s]]++;
+    }
+    parents.insert(parents.begin() + slot, parentSlot);
+    sizes.insert(sizes.begin() + slot, 1);
+    locals.insert(locals.begin() + slot, local);
+    worlds.insert(worlds.begin() + slot, local);
+    dirty.insert(dirty.begin() + slot, 1);
+    ids.insert(ids.begin() + slot, id);
+    slots.push_back(slot);
+    names.push_back(name);
+    if (!name.empty()) nameIndex.emplace(name, id);
+    changed.push_back(id);
+    return id;
+}
+
+void SceneGraph::setLocal(unsigned int node, const glm::mat4& local) {
+    size_t slot = slots[node];
+    locals[slot] = local;
+    if (dirty[slot]) return;
+    dirty[slot] = 1;
+    changed.push_back(node);
+}
+
+int SceneGraph::parent(unsigned int node) const {
+    int p = parents[slots[node]];
+    return p < 0 ? -1 : (int)ids[p];
+}
+
+int SceneGraph::find(const std::string& name) const {
+    auto it = nameIndex.find(name);
+    return it == nameIndex.end() ? -1 : (int)it->second;
+}
+
+void SceneGraph::updateRange(size_t first, size_t end) {
+    // parents come first, so one pass in slot order resolves the range
+    for (size_t s = first; s < end; s++) {
+        int p = parents[s];
+        if (p < 0) worlds[s] = locals[s];
+        else multiply(&worlds[p][0][0], &locals[s][0][0], &worlds[s][0][0]);
+        dirty[s] = 0;
+    }
+}
+
+void SceneGraph::updateSubtree(size_t slot) {
+    size_t end = slot + sizes[slot];
+    if (sizes[slot] < PARALLEL_SUBTREE) {
+        updateRange(slot, end);
+        return;
+    }
+    updateRange(slot, slot + 1);
+    // the children's subtrees only read the world of slot, so they are independent of each other
+    std::vector<size_t> children;
+    for (size_t c = slot + 1; c < end; c += sizes[c]) children.push_back(c);
+    ThreadPool::global().parallelFor(children.size(), [&](size_t begin, size_t last, size_t) {
+        for (size_t i = begin; i < last; i++) updateRange(children[i], children[i] + sizes[children[i]]);
+    });
+}
+
+void SceneGraph::update(void) {
+    lastUpdated = 0;
+    if (changed.empty()) return;
+    std::vector<size_t> roots;
+    roots.reserve(changed.size());
+    for (unsigned int id : changed) roots.push_back(slots[id]);
+    changed.clear();
+    // in slot order a changed ancestor comes before its descendants, which its update already covers
+    std::sort(roots.begin(), roots.end());
+    size_t covered = 0;
+    for (size_t slot : roots) {
+        if (slot < covered) continue;
+        updateSubtree(slot);
+        covered = slot + sizes[slot];
+        lastUpdated += sizes[slot];
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SCENE_GRAPH_HH
+#define SCENE_GRAPH_HH
+
+#include <glm/glm/glm.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Transform hierarchy in flat arrays. Nodes are stored depth first, so every parent comes before its children
+// and every subtree is one contiguous range of slots. Callers hold stable node ids, slots move when nodes are inserted.
+// setLocal only marks the node, update recomputes the changed subtrees, so moving one node costs work
+// proportional to its subtree no matter how large the scene is.
+class SceneGraph {
+public:
+    SceneGraph(void);
+
+    // parent -1 adds a root. The node goes to the end of its parent's subtree, which shifts every later slot:
+    // building depth first, as the importers do, only ever appends
+    unsigned int addNode(int parent, const glm::mat4& local = glm::mat4(1.0f), const std::string& name = "");
+    void setLocal(unsigned int node, const glm::mat4& local);
+
+    const glm::mat4& local(unsigned int node) const { return locals[slots[node]]; }
+    // as of the last update
+    const glm::mat4& world(unsigned int node) const { return worlds[slots[node]]; }
+    int parent(unsigned int node) const;
+    const std::string& name(unsigned int node) const { return names[node]; }
+    // node with that name, -1 if there is none
+    int find(const std::string& name) const;
+    size_t size(void) const { return ids.size(); }
+    // node at a depth first position
+    unsigned int nodeAt(size_t slot) const { return ids[slot]; }
+
+    // recomputes the world transforms below every node changed since the last update.
+    // big subtrees are split over the global ThreadPool by child
+    void update(void);
+    // world transforms the last update computed
+    size_t updated(void) const { return lastUpdated; }
+
+private:
+    // by slot
+    std::vector<int> parents;
+    // number of nodes in the subtree, the node included
+    std::vector<unsigned int> sizes;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<char> dirty;
+    std::vector<unsigned int> ids;
+
+    // by id
+    std::vector<unsigned int> slots;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, unsigned int> nameIndex;
+
+    // nodes marked since the last update, ids since slots can move in between
+    std::vector<unsigned int> changed;
+    size_t lastUpdated;
+
+    // worlds of the slots [first, end), whose parents are outside or already up to date
+    void updateRange(size_t first, size_t end);
+    void updateSubtree(size_t slot);
+};
+
+#endif
@@ -66,7 +66,7 @@ Shader::Shader(const std::string vertexPath, const std::string geometryPath, con
     glCompileShader(fragment);
     checkCompileErrors(fragment, "FRAGMENT");
     // shader Program
-    ID = glCreateProgram();
+    ID = GLProgram(glCreateProgram());
     glAttachShader(ID, vertex);
     if (!geometryCode.empty()) glAttachShader(ID, geometry);
     glAttachShader(ID, fragment);
@@ -110,10 +110,6 @@ void Shader::setUniform_Mat3(const char* name, glm::mat3 value) {
     glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
-Shader::~Shader(void) {
-    glDeleteProgram(ID);
-}
-
 void Shader::checkCompileErrors(unsigned int id, std::string type) {
     int success;
     char infoLog[1024];
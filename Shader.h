@@ -1,13 +1,15 @@
 #ifndef SHADER_HH
 #define SHADER_HH
 
+#include "GLHandle.h"
+
 #include <glm/glm/glm.hpp>
 
 #include <string>
 
 class Shader {
 public:
-    unsigned int ID;
+    GLProgram ID;
 
     Shader(const std::string vertexPath, const std::string geometryPath, const std::string fragmentPath);
 
@@ -21,8 +23,6 @@ public:
     void setUniform_Mat4(const char* name, glm::mat4 value);
     void setUniform_Mat3(const char* name, glm::mat3 value);
 
-    ~Shader(void);
-
 private:
     void checkCompileErrors(unsigned int shader, std::string type);
 };
@@ -0,0 +1,311 @@
+#include "Simplification.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// how much stronger open borders and seams resist moving than the surface
+const float BOUNDARY_WEIGHT = 10.0f;
+// a collapse may turn a neighbouring triangle by at most about 75 degrees, which also keeps it from ending up a sliver
+const float MAX_TURN_COS = 0.25f;
+// a level has to drop at least this share of triangles to be kept
+const float LOD_MIN_REDUCTION = 0.1f;
+
+enum Vertex_kind {
+    // inside the surface, free to collapse onto any neighbour
+    MANIFOLD,
+    // on an open border, only slides along it
+    BORDER,
+    // one of two vertices at one position with different attributes, slides along the seam with its partner
+    SEAM,
+    // anything else, never moves
+    LOCKED
+};
+
+// symmetric 4x4 error matrix of a set of planes, error(p) = p'Ap + 2b.p + c, normalized by the summed weight
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double w;
+
+    void addPlane(const glm::vec3& n, float d, float weight) {
+        a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z;
+        a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a22 += weight * n.z * n.z;
+        b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+        c += weight * d * d;
+        w += weight;
+    }
+    void add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        w += q.w;
+    }
+    // squared distance
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2 * (b0 * x + b1 * y + b2 * z) + c;
+        return w > 0 ? std::fabs(e) / w : 0;
+    }
+};
+
+struct Collapse {
+    unsigned int from, to;
+    double cost;
+};
+
+// vertices with bit identical positions share one representative, the lowest index, and form a ring through wedge
+void buildPositionRemap(const VertexData* vertices, size_t n_vs, std::vector<unsigned int>& remap, std::vector<unsigned int>& wedge) {
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const {
+            unsigned int h[3];
+            std::memcpy(h, &p, sizeof(h));
+            return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+        }
+    };
+    struct PositionEqual {
+        bool operator()(const glm::vec3& a, const glm::vec3& b) const { return std::memcmp(&a, &b, sizeof(a)) == 0; }
+    };
+    std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> first;
+    first.reserve(n_vs);
+    remap.resize(n_vs);
+    wedge.resize(n_vs);
+    for (size_t v = 0; v < n_vs; v++) {
+        auto it = first.emplace(vertices[v].Position, v).first;
+        remap[v] = it->second;
+        wedge[v] = v;
+        if (remap[v] != v) {
+            // link into the ring after the representative
+            wedge[v] = wedge[remap[v]];
+            wedge[remap[v]] = v;
+        }
+    }
+}
+
+std::vector<unsigned int> simplifyMesh(const VertexData* vertices, size_t n_vs, const unsigned int* indices, size_t n_inds, size_t targetIndexCount, float maxError, float* error) {
+    std::vector<unsigned int> result(indices, indices + n_inds);
+    double resultError = 0;
+    std::vector<unsigned int> remap, wedge;
+    buildPositionRemap(vertices, n_vs, remap, wedge);
+    auto position = [&](unsigned int v) -> const glm::vec3& { return vertices[v].Position; };
+
+    // quadrics live on the position representatives and accumulate as vertices collapse into each other
+    std::vector<Quadric> quadrics(n_vs);
+    std::memset((void*)quadrics.data(), 0, n_vs * sizeof(Quadric));
+    for (size_t i = 0; i + 2 < n_inds; i += 3) {
+        const glm::vec3& p0 = position(indices[i]);
+        glm::vec3 n = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+        float len = glm::length(n);
+        if (len == 0) continue;
+        n /= len;
+        for (size_t k = 0; k < 3; k++) quadrics[remap[indices[i + k]]].addPlane(n, -glm::dot(n, p0), 0.5f * len);
+    }
+    // open edges are found again every pass, but their quadrics are only added once, from the input
+    bool boundaryQuadrics = false;
+
+    std::vector<unsigned int> offsets, targets, fill;
+    std::vector<unsigned int> openOut, openIn, openOutTarget, openInSource;
+    std::vector<unsigned int> triOffsets, triAdj;
+    std::vector<unsigned char> kind;
+    std::vector<unsigned int> collapseTo(n_vs);
+    std::vector<char> locked(n_vs);
+    std::vector<Collapse> collapses;
+
+    while (result.size() > targetIndexCount) {
+        size_t n_tris = result.size() / 3;
+
+        // outgoing edges of every vertex, compressed rows
+        offsets.assign(n_vs + 1, 0);
+        for (size_t i = 0; i < result.size(); i++) offsets[result[i] + 1]++;
+        for (size_t v = 0; v < n_vs; v++) offsets[v + 1] += offsets[v];
+        targets.resize(result.size());
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < n_tris; t++) {
+            for (size_t k = 0; k < 3; k++) targets[fill[result[3 * t + k]]++] = result[3 * t + (k + 1) % 3];
+        }
+        auto hasEdge = [&](unsigned int a, unsigned int b) {
+            for (unsigned int k = offsets[a]; k < offsets[a + 1]; k++) {
+                if (targets[k] == b) return true;
+            }
+            return false;
+        };
+
+        // an edge without its reverse is open: a border, or a seam if the reverse exists between other vertices at the same positions
+        openOut.assign(n_vs, 0);
+        openIn.assign(n_vs, 0);
+        openOutTarget.assign(n_vs, 0);
+        openInSource.assign(n_vs, 0);
+        for (unsigned int a = 0; a < n_vs; a++) {
+            for (unsigned int k = offsets[a]; k < offsets[a + 1]; k++) {
+                unsigned int b = targets[k];
+                if (hasEdge(b, a)) continue;
+                openOut[a]++;
+                openOutTarget[a] = b;
+                openIn[b]++;
+                openInSource[b] = a;
+            }
+        }
+        kind.assign(n_vs, LOCKED);
+        for (unsigned int v = 0; v < n_vs; v++) {
+            unsigned int w = wedge[v];
+            if (w == v) {
+                if (openOut[v] == 0 && openIn[v] == 0) kind[v] = MANIFOLD;
+                else if (openOut[v] == 1 && openIn[v] == 1) kind[v] = BORDER;
+            }
+            else if (wedge[w] == v && openOut[v] == 1 && openIn[v] == 1 && openOut[w] == 1 && openIn[w] == 1) {
+                // a seam if the open edges of the pair run opposite ways between the same positions
+                if (remap[openOutTarget[v]] == remap[openInSource[w]] && remap[openInSource[v]] == remap[openOutTarget[w]]) kind[v] = SEAM;
+            }
+        }
+
+        if (!boundaryQuadrics) {
+            boundaryQuadrics = true;
+            for (size_t t = 0; t < n_tris; t++) {
+                const glm::vec3& p0 = position(result[3 * t]);
+                glm::vec3 n = glm::cross(position(result[3 * t + 1]) - p0, position(result[3 * t + 2]) - p0);
+                if (glm::length(n) == 0) continue;
+                n = glm::normalize(n);
+                for (size_t k = 0; k < 3; k++) {
+                    unsigned int a = result[3 * t + k], b = result[3 * t + (k + 1) % 3];
+                    if (hasEdge(b, a)) continue;
+                    // plane through the edge, perpendicular to the triangle, keeps the edge from moving sideways
+                    glm::vec3 edge = position(b) - position(a);
+                    float length = glm::length(edge);
+                    if (length == 0) continue;
+                    glm::vec3 en = glm::normalize(glm::cross(edge, n));
+                    float d = -glm::dot(en, position(a));
+                    quadrics[remap[a]].addPlane(en, d, BOUNDARY_WEIGHT * length * length);
+                    quadrics[remap[b]].addPlane(en, d, BOUNDARY_WEIGHT * length * length);
+                }
+            }
+        }
+
+        // triangles around every position, for the flip test
+        triOffsets.assign(n_vs + 1, 0);
+        for (size_t i = 0; i < result.size(); i++) triOffsets[remap[result[i]] + 1]++;
+        for (size_t v = 0; v < n_vs; v++) triOffsets[v + 1] += triOffsets[v];
+        triAdj.resize(result.size());
+        fill.assign(triOffsets.begin(), triOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++) triAdj[fill[remap[result[i]]]++] = i / 3;
+
+        // partner of the seam vertex w that pairs with target t, -1 if the seam doesn't continue there
+        auto seamPartner = [&](unsigned int w, unsigned int t) -> int {
+            if (remap[openOutTarget[w]] == remap[t]) return openOutTarget[w];
+            if (remap[openInSource[w]] == remap[t]) return openInSource[w];
+            return -1;
+        };
+        auto allowed = [&](unsigned int from, unsigned int to) {
+            switch (kind[from]) {
+                case MANIFOLD:
+                    return true;
+                case BORDER:
+                    return openOutTarget[from] == to || openInSource[from] == to;
+                case SEAM:
+                    return (openOutTarget[from] == to || openInSource[from] == to) && seamPartner(wedge[from], to) >= 0;
+                default:
+                    return false;
+            }
+        };
+
+        collapses.clear();
+        for (size_t t = 0; t < n_tris; t++) {
+            for (size_t k = 0; k < 3; k++) {
+                unsigned int a = result[3 * t + k], b = result[3 * t + (k + 1) % 3];
+                // every undirected edge once, seen from its lower representative
+                if (remap[a] >= remap[b] && hasEdge(b, a)) continue;
+                double ab = allowed(a, b) ? quadrics[remap[a]].error(position(b)) : DBL_MAX;
+                double ba = allowed(b, a) ? quadrics[remap[b]].error(position(a)) : DBL_MAX;
+                if (ab == DBL_MAX && ba == DBL_MAX) continue;
+                if (ab <= ba) collapses.push_back({ a, b, ab });
+                else collapses.push_back({ b, a, ba });
+            }
+        }
+        if (collapses.empty()) break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+            return x.cost < y.cost || (x.cost == y.cost && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+        });
+
+        // each collapse removes about two triangles, stop the pass once enough are scheduled
+        size_t toRemove = (result.size() - targetIndexCount) / 3;
+        size_t scheduled = 0;
+        double maxCost = (double)maxError * maxError;
+        for (size_t v = 0; v < n_vs; v++) collapseTo[v] = v;
+        std::fill(locked.begin(), locked.end(), 0);
+        auto flips = [&](unsigned int from, unsigned int to) {
+            unsigned int rf = remap[from], rt = remap[to];
+            for (unsigned int k = triOffsets[rf]; k < triOffsets[rf + 1]; k++) {
+                unsigned int t = triAdj[k];
+                unsigned int r[3] = { remap[result[3 * t]], remap[result[3 * t + 1]], remap[result[3 * t + 2]] };
+                // triangles on the edge disappear
+                if (r[0] == rt || r[1] == rt || r[2] == rt) continue;
+                glm::vec3 p[3], q[3];
+                for (size_t c = 0; c < 3; c++) {
+                    p[c] = position(r[c]);
+                    q[c] = r[c] == rf ? position(rt) : p[c];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                if (glm::dot(before, after) <= MAX_TURN_COS * glm::length(before) * glm::length(after)) return true;
+            }
+            return false;
+        };
+        for (const Collapse& c : collapses) {
+            if (scheduled >= toRemove || c.cost > maxCost) break;
+            unsigned int rf = remap[c.from], rt = remap[c.to];
+            if (locked[rf] || locked[rt]) continue;
+            if (flips(c.from, c.to)) continue;
+            if (kind[c.from] == SEAM) {
+                unsigned int w = wedge[c.from];
+                collapseTo[w] = seamPartner(w, c.to);
+            }
+            collapseTo[c.from] = c.to;
+            quadrics[rt].add(quadrics[rf]);
+            resultError = std::max(resultError, c.cost);
+            // the neighbourhood changed, nothing around it moves again this pass
+            for (unsigned int k = triOffsets[rf]; k < triOffsets[rf + 1]; k++) {
+                unsigned int t = triAdj[k];
+                for (size_t j = 0; j < 3; j++) locked[remap[result[3 * t + j]]] = 1;
+            }
+            scheduled += 2;
+        }
+        if (scheduled == 0) break;
+
+        // moved vertices now point at their targets, triangles that lost an edge go away
+        size_t out = 0;
+        for (size_t t = 0; t < n_tris; t++) {
+            unsigned int a = collapseTo[result[3 * t]], b = collapseTo[result[3 * t + 1]], c = collapseTo[result[3 * t + 2]];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a]) continue;
+            result[out++] = a;
+            result[out++] = b;
+            result[out++] = c;
+        }
+        result.resize(out);
+    }
+    if (error) *error = (float)std::sqrt(resultError);
+    return result;
+}
+
+std::vector<MeshLod> buildLodChain(const std::vector<VertexData>& vertices, std::vector<unsigned int>& indices, size_t maxLevels, float ratio) {
+    std::vector<MeshLod> lods;
+    lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+    if (indices.empty()) return lods;
+    std::vector<unsigned int> level(indices);
+    float error = 0.0f;
+    while (lods.size() < maxLevels) {
+        size_t target = (size_t)(level.size() / 3 * ratio) * 3;
+        float levelError;
+        std::vector<unsigned int> next = simplifyMesh(vertices.data(), vertices.size(), level.data(), level.size(), target, FLT_MAX, &levelError);
+        if (next.empty() || next.size() > level.size() * (1.0f - LOD_MIN_REDUCTION)) break;
+        // each level starts from the one before, so the errors add up
+        error += levelError;
+        level.swap(next);
+        lods.push_back({ (unsigned int)indices.size(), (unsigned int)level.size(), error });
+        indices.insert(indices.end(), level.begin(), level.end());
+    }
+    return lods;
+}
@@ -0,0 +1,31 @@
+#ifndef SIMPLIFICATION_HH
+#define SIMPLIFICATION_HH
+
+#include <cstddef>
+#include <vector>
+
+struct VertexData;
+
+// levels a chain stops at, counting the full mesh
+#define LOD_MAX_LEVELS 6
+
+// a level of detail, a range of the mesh's index buffer drawn instead of the full mesh
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    // largest distance, in mesh space, the level's surface can be from the full mesh. 0 for the full mesh
+    float error;
+};
+
+// Quadric error metric simplification (Garland and Heckbert) by edge collapse onto existing vertices, so the result
+// indexes the same vertex buffer. Vertices that share a position but not their attributes (UV and normal seams)
+// only collapse along the seam and together, open borders only along the border, anything more complex stays put.
+// Stops at targetIndexCount or once the next collapse would exceed maxError (mesh space distance).
+// error receives the error of the result.
+std::vector<unsigned int> simplifyMesh(const VertexData* vertices, size_t n_vs, const unsigned int* indices, size_t n_inds, size_t targetIndexCount, float maxError, float* error = nullptr);
+
+// Appends up to maxLevels - 1 simplified levels after the indices, each aiming at ratio of the triangles of the
+// one before, and returns all levels with the full mesh [0, n_inds) first. Stops early when a level barely shrinks.
+std::vector<MeshLod> buildLodChain(const std::vector<VertexData>& vertices, std::vector<unsigned int>& indices, size_t maxLevels = LOD_MAX_LEVELS, float ratio = 0.5f);
+
+#endif
@@ -0,0 +1,542 @@
+#include "SoftwareRasterizer.h"
+#include "MatrixMath.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <emmintrin.h>
+#define RASTER_SSE
+#endif
+
+namespace {
+
+// window coordinates are snapped to this many steps per pixel, what GL implementations commonly use.
+// Triangles are set up in these units as integers, so coverage is exact
+const int SUBPIXEL = 256;
+// the sides of the clip volume are widened this much so only triangles far off screen get cut, the tiles
+// take care of the rest without changing the interpolated values
+const float GUARD_BAND = 4.0f;
+const size_t MIN_PARALLEL_VERTICES = 4096;
+// triangles clipped by all six planes have at most this many vertices
+const int MAX_CLIPPED = 9;
+
+struct ShadedVertex {
+    glm::vec4 clip;
+    // world space
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+ShadedVertex lerp(const ShadedVertex& a, const ShadedVertex& b, float t) {
+    return ShadedVertex{ a.clip + (b.clip - a.clip) * t, a.normal + (b.normal - a.normal) * t, a.uv + (b.uv - a.uv) * t };
+}
+
+struct RasterTriangle {
+    int minX, minY, maxX, maxY;
+    // edge function of the edge opposite vertex i in subpixels: A x + B y + C, inside where it is >= 0.
+    // C carries the top-left rule: it is one less for other edges, so their pixel centers are left out
+    int64_t A[3], B[3], C[3];
+    // 1 / sum of the edge functions, turns them into barycentrics
+    float invArea;
+    float z[3];
+    float invW[3];
+    // attributes divided by w for perspective correct interpolation
+    glm::vec3 normal[3];
+    glm::vec2 uv[3];
+};
+
+struct RasterPoint {
+    int minX, minY, maxX, maxY;
+    float z;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+uint32_t packColor(const glm::vec4& c) {
+    auto unorm = [](float v) { return (uint32_t)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); };
+    return unorm(c.x) | (unorm(c.y) << 8) | (unorm(c.z) << 16) | (unorm(c.w) << 24);
+}
+
+float srgbToLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// expanded like GL_RED, GL_RG, GL_RGB and GL_RGBA uploads
+glm::vec4 texel(const ImageData& image, int x, int y, bool srgb) {
+    x %= image.width;
+    y %= image.height;
+    if (x < 0) x += image.width;
+    if (y < 0) y += image.height;
+    const unsigned char* p = image.pixels + ((size_t)y * image.width + x) * image.components;
+    glm::vec4 c(0.0f, 0.0f, 0.0f, 1.0f);
+    for (int k = 0; k < image.components; k++) c[k] = p[k] / 255.0f;
+    if (srgb && image.components >= 3) {
+        for (int k = 0; k < 3; k++) c[k] = srgbToLinear(c[k]);
+    }
+    return c;
+}
+
+// GL_LINEAR with GL_REPEAT, mipmaps aren't modelled
+glm::vec4 sample(const ImageData& image, const glm::vec2& uv, bool srgb) {
+    float x = uv.x * image.width - 0.5f;
+    float y = uv.y * image.height - 0.5f;
+    int x0 = (int)std::floor(x);
+    int y0 = (int)std::floor(y);
+    float fx = x - x0;
+    float fy = y - y0;
+    glm::vec4 bottom = texel(image, x0, y0, srgb) * (1 - fx) + texel(image, x0 + 1, y0, srgb) * fx;
+    glm::vec4 top = texel(image, x0, y0 + 1, srgb) * (1 - fx) + texel(image, x0 + 1, y0 + 1, srgb) * fx;
+    return bottom * (1 - fy) + top * fy;
+}
+
+uint32_t shade(const RasterMaterial& material, const glm::vec3& normal, const glm::vec2& uv) {
+    if (material.shading == Shading_type::NORMALS) return packColor(glm::vec4(glm::normalize(normal) * 0.5f + glm::vec3(0.5f), 1.0f));
+    glm::vec4 albedo = material.color;
+    if (material.texture && material.texture->pixels) {
+        glm::vec4 t = sample(*material.texture, uv, material.srgbTexture);
+        albedo = glm::vec4(albedo.x * t.x, albedo.y * t.y, albedo.z * t.z, albedo.w * t.w);
+    }
+    if (material.shading == Shading_type::UNLIT) return packColor(albedo);
+    float diffuse = std::max(glm::dot(glm::normalize(normal), -glm::normalize(material.lightDirection)), 0.0f);
+    float light = material.ambient + diffuse;
+    return packColor(glm::vec4(glm::vec3(albedo) * light, albedo.w));
+}
+
+float snap(float v) {
+    return std::floor(v * SUBPIXEL + 0.5f) / SUBPIXEL;
+}
+
+// window coordinate in subpixels, |v| stays below 2^24 pixels within the guard band of any sane viewport
+int64_t toFixed(float v) {
+    return (int64_t)std::floor((double)v * SUBPIXEL + 0.5);
+}
+
+int64_t floorDiv(int64_t a, int64_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+// Sutherland-Hodgman against dot(plane, clip) >= 0
+int clipPolygon(const ShadedVertex* in, int n, ShadedVertex* out, const glm::vec4& plane) {
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        const ShadedVertex& a = in[i];
+        const ShadedVertex& b = in[(i + 1) % n];
+        float da = glm::dot(plane, a.clip);
+        float db = glm::dot(plane, b.clip);
+        if (da >= 0) out[m++] = a;
+        if ((da >= 0) != (db >= 0)) out[m++] = lerp(a, b, da / (da - db));
+    }
+    return m;
+}
+
+void setupTriangle(const ShadedVertex* v, int width, int height, bool cull, std::vector<RasterTriangle>& out) {
+    RasterTriangle tri;
+    int64_t x[3], y[3];
+    for (int i = 0; i < 3; i++) {
+        float invW = 1.0f / v[i].clip.w;
+        x[i] = toFixed((v[i].clip.x * invW * 0.5f + 0.5f) * width);
+        y[i] = toFixed((v[i].clip.y * invW * 0.5f + 0.5f) * height);
+        tri.z[i] = v[i].clip.z * invW * 0.5f + 0.5f;
+        tri.invW[i] = invW;
+        tri.normal[i] = v[i].normal * invW;
+        tri.uv[i] = v[i].uv * invW;
+    }
+    // counter clockwise in window space (y up) is front facing
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0 || (cull && area < 0)) return;
+    if (area < 0) {
+        // back faces are wound the other way round so the edge functions stay positive inside
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(tri.z[1], tri.z[2]);
+        std::swap(tri.invW[1], tri.invW[2]);
+        std::swap(tri.normal[1], tri.normal[2]);
+        std::swap(tri.uv[1], tri.uv[2]);
+        area = -area;
+    }
+    for (int i = 0; i < 3; i++) {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        tri.A[i] = y[a] - y[b];
+        tri.B[i] = x[b] - x[a];
+        // left edges run down, top edges run left on a counter clockwise triangle
+        bool topLeft = y[b] < y[a] || (y[b] == y[a] && x[b] < x[a]);
+        tri.C[i] = -(tri.A[i] * x[a] + tri.B[i] * y[a]) - (topLeft ? 0 : 1);
+    }
+    tri.invArea = 1.0f / (float)area;
+    // pixels whose centers lie inside the bounds, centers are at SUBPIXEL / 2
+    const int64_t half = SUBPIXEL / 2;
+    tri.minX = (int)std::max<int64_t>(0, -floorDiv(half - std::min(x[0], std::min(x[1], x[2])), SUBPIXEL));
+    tri.minY = (int)std::max<int64_t>(0, -floorDiv(half - std::min(y[0], std::min(y[1], y[2])), SUBPIXEL));
+    tri.maxX = (int)std::min<int64_t>(width - 1, floorDiv(std::max(x[0], std::max(x[1], x[2])) - half, SUBPIXEL));
+    tri.maxY = (int)std::min<int64_t>(height - 1, floorDiv(std::max(y[0], std::max(y[1], y[2])) - half, SUBPIXEL));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY) return;
+    out.push_back(tri);
+}
+
+void clipAndSetup(const ShadedVertex& a, const ShadedVertex& b, const ShadedVertex& c, int width, int height, bool cull, std::vector<RasterTriangle>& out) {
+    static const glm::vec4 planes[6] = {
+        glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), glm::vec4(0.0f, 0.0f, -1.0f, 1.0f),
+        glm::vec4(1.0f, 0.0f, 0.0f, GUARD_BAND), glm::vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),
+        glm::vec4(0.0f, 1.0f, 0.0f, GUARD_BAND), glm::vec4(0.0f, -1.0f, 0.0f, GUARD_BAND)
+    };
+    ShadedVertex polygon[MAX_CLIPPED] = { a, b, c };
+    int outside = 0;
+    for (int p = 0; p < 6; p++) {
+        int behind = (glm::dot(planes[p], a.clip) < 0) + (glm::dot(planes[p], b.clip) < 0) + (glm::dot(planes[p], c.clip) < 0);
+        if (behind == 3) return;
+        if (behind) outside |= 1 << p;
+    }
+    int n = 3;
+    if (outside) {
+        ShadedVertex scratch[MAX_CLIPPED];
+        for (int p = 0; p < 6 && n >= 3; p++) {
+            if (!(outside & (1 << p))) continue;
+            n = clipPolygon(polygon, n, scratch, planes[p]);
+            std::copy(scratch, scratch + n, polygon);
+        }
+    }
+    // fan, which keeps the winding of the original triangle
+    for (int i = 1; i + 1 < n; i++) {
+        ShadedVertex fan[3] = { polygon[0], polygon[i], polygon[i + 1] };
+        setupTriangle(fan, width, height, cull, out);
+    }
+}
+
+void rasterTriangle(const RasterTriangle& tri, int rx0, int ry0, int rx1, int ry1, const RasterMaterial& material, uint32_t* color, float* depth, int width) {
+    int x0 = std::max(tri.minX, rx0), x1 = std::min(tri.maxX, rx1);
+    int y0 = std::max(tri.minY, ry0), y1 = std::min(tri.maxY, ry1);
+    if (x0 > x1 || y0 > y1) return;
+    // rows start on a multiple of 4 inside the tile, lanes outside [x0, x1] are masked
+    int xs = x0 - (x0 & 3);
+    auto shadePixel = [&](size_t at, const float* w) {
+        float b0 = w[0] * tri.invArea, b1 = w[1] * tri.invArea, b2 = w[2] * tri.invArea;
+        float invW = 1.0f / (b0 * tri.invW[0] + b1 * tri.invW[1] + b2 * tri.invW[2]);
+        glm::vec3 normal = (tri.normal[0] * b0 + tri.normal[1] * b1 + tri.normal[2] * b2) * invW;
+        glm::vec2 uv = (tri.uv[0] * b0 + tri.uv[1] * b1 + tri.uv[2] * b2) * invW;
+        color[at] = shade(material, normal, uv);
+    };
+    // edge functions at the center of pixel (x, y) and their step from one pixel to the next
+    auto edgeAt = [&](int i, int x, int y) {
+        return tri.A[i] * ((int64_t)x * SUBPIXEL + SUBPIXEL / 2) + tri.B[i] * ((int64_t)y * SUBPIXEL + SUBPIXEL / 2) + tri.C[i];
+    };
+#ifdef RASTER_SSE
+    __m128i step[3];
+    for (int i = 0; i < 3; i++) step[i] = _mm_set1_epi64x(4 * tri.A[i] * SUBPIXEL);
+    __m128 z0 = _mm_set1_ps(tri.z[0]), z1 = _mm_set1_ps(tri.z[1]), z2 = _mm_set1_ps(tri.z[2]);
+    __m128 invArea = _mm_set1_ps(tri.invArea);
+    for (int y = y0; y <= y1; y++) {
+        size_t row = (size_t)y * width;
+        // two lanes of 64 bit edge values per register, the sign bits are the outside test
+        __m128i e[3][2];
+        for (int i = 0; i < 3; i++) {
+            int64_t e0 = edgeAt(i, xs, y), dx = tri.A[i] * SUBPIXEL;
+            e[i][0] = _mm_set_epi64x(e0 + dx, e0);
+            e[i][1] = _mm_set_epi64x(e0 + 3 * dx, e0 + 2 * dx);
+        }
+        for (int x = xs; x <= x1; x += 4) {
+            int outside = 0;
+            for (int i = 0; i < 3; i++) {
+                outside |= _mm_movemask_pd(_mm_castsi128_pd(e[i][0])) | (_mm_movemask_pd(_mm_castsi128_pd(e[i][1])) << 2);
+            }
+            int span = 0;
+            for (int k = 0; k < 4; k++) span |= (x + k >= x0 && x + k <= x1) << k;
+            int covered = ~outside & span;
+            int64_t es[3][4];
+            if (covered) {
+                for (int i = 0; i < 3; i++) {
+                    _mm_storeu_si128((__m128i*)es[i], e[i][0]);
+                    _mm_storeu_si128((__m128i*)(es[i] + 2), e[i][1]);
+                }
+            }
+            for (int i = 0; i < 3; i++) {
+                e[i][0] = _mm_add_epi64(e[i][0], step[i]);
+                e[i][1] = _mm_add_epi64(e[i][1], step[i]);
+            }
+            if (!covered) continue;
+            // the barycentrics only need float precision
+            float ws[3][4];
+            for (int i = 0; i < 3; i++) {
+                for (int k = 0; k < 4; k++) ws[i][k] = (float)es[i][k];
+            }
+            __m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ws[0]), z0), _mm_mul_ps(_mm_loadu_ps(ws[1]), z1)),
+                _mm_mul_ps(_mm_loadu_ps(ws[2]), z2)), invArea);
+            // whole groups load the depth at once, the ends of a span go lane by lane so nothing past the row is read
+            __m128 d;
+            if (span == 0xf) d = _mm_loadu_ps(depth + row + x);
+            else {
+                float lanes[4];
+                for (int k = 0; k < 4; k++) lanes[k] = span & (1 << k) ? depth[row + x + k] : 0.0f;
+                d = _mm_loadu_ps(lanes);
+            }
+            int bits = covered & _mm_movemask_ps(_mm_cmplt_ps(z, d));
+            if (!bits) continue;
+            float zs[4];
+            _mm_storeu_ps(zs, z);
+            for (int k = 0; k < 4; k++) {
+                if (!(bits & (1 << k))) continue;
+                size_t at = row + x + k;
+                depth[at] = zs[k];
+                float wk[3] = { ws[0][k], ws[1][k], ws[2][k] };
+                shadePixel(at, wk);
+            }
+        }
+    }
+#else
+    (void)xs;
+    for (int y = y0; y <= y1; y++) {
+        size_t row = (size_t)y * width;
+        int64_t e[3];
+        for (int i = 0; i < 3; i++) e[i] = edgeAt(i, x0, y);
+        for (int x = x0; x <= x1; x++) {
+            bool inside = e[0] >= 0 && e[1] >= 0 && e[2] >= 0;
+            float w[3] = { (float)e[0], (float)e[1], (float)e[2] };
+            for (int i = 0; i < 3; i++) e[i] += tri.A[i] * SUBPIXEL;
+            if (!inside) continue;
+            float z = (w[0] * tri.z[0] + w[1] * tri.z[1] + w[2] * tri.z[2]) * tri.invArea;
+            size_t at = row + x;
+            if (!(z < depth[at])) continue;
+            depth[at] = z;
+            shadePixel(at, w);
+        }
+    }
+#endif
+}
+
+// sets primitives up and bins them into tiles in parallel, RASTER_BATCH at a time, then draws every tile as one job.
+// Chunks cover consecutive primitives and tiles walk them in chunk order, so each pixel sees submission order
+template <class Prim>
+void process(int width, int height, size_t count, const std::function<void(size_t, std::vector<Prim>&)>& setup,
+    const std::function<void(const Prim&, int, int, int, int)>& raster)
+{
+    int tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    int tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    size_t tiles = (size_t)tilesX * tilesY;
+    size_t chunks = ThreadPool::global().size();
+    std::vector<std::vector<Prim>> prims(chunks);
+    std::vector<std::vector<uint32_t>> bins(chunks * tiles);
+    for (size_t first = 0; first < count; first += RASTER_BATCH) {
+        size_t n = std::min<size_t>(RASTER_BATCH, count - first);
+        // chunks past n aren't run, so they are emptied here
+        for (auto& p : prims) p.clear();
+        for (auto& b : bins) b.clear();
+        ThreadPool::global().parallelFor(n, [&](size_t begin, size_t end, size_t c) {
+            std::vector<Prim>& own = prims[c];
+            for (size_t i = begin; i < end; i++) setup(first + i, own);
+            for (uint32_t j = 0; j < own.size(); j++) {
+                const Prim& p = own[j];
+                for (int ty = p.minY / RASTER_TILE_SIZE; ty <= p.maxY / RASTER_TILE_SIZE; ty++) {
+                    for (int tx = p.minX / RASTER_TILE_SIZE; tx <= p.maxX / RASTER_TILE_SIZE; tx++) bins[c * tiles + ty * tilesX + tx].push_back(j);
+                }
+            }
+        }, chunks);
+        ThreadPool::global().parallelFor(tiles, [&](size_t begin, size_t end, size_t) {
+            for (size_t t = begin; t < end; t++) {
+                int rx0 = (t % tilesX) * RASTER_TILE_SIZE, ry0 = (t / tilesX) * RASTER_TILE_SIZE;
+                int rx1 = std::min(width, rx0 + RASTER_TILE_SIZE) - 1, ry1 = std::min(height, ry0 + RASTER_TILE_SIZE) - 1;
+                for (size_t c = 0; c < chunks; c++) {
+                    for (uint32_t j : bins[c * tiles + t]) raster(prims[c][j], rx0, ry0, rx1, ry1);
+                }
+            }
+        }, tiles);
+    }
+}
+
+std::vector<ShadedVertex> transformVertices(const VertexData* vs, size_t n_vs, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model) {
+    glm::mat4 mvp = multiply(projection, multiply(view, model));
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    std::vector<ShadedVertex> out(n_vs);
+    ThreadPool::global().parallelFor(n_vs, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) {
+            out[i].clip = mvp * glm::vec4(vs[i].Position, 1.0f);
+            out[i].normal = normalMatrix * vs[i].Normal;
+            out[i].uv = vs[i].TexCoords;
+        }
+    }, n_vs < MIN_PARALLEL_VERTICES ? 1 : 0);
+    return out;
+}
+
+}
+
+///////////////////////////////////////
+/// SoftwareRasterizer Definitions ///
+///////////////////////////////////////
+
+SoftwareRasterizer::SoftwareRasterizer(int w, int h) :
+    width{ std::max(w, 1) },
+    height{ std::max(h, 1) },
+    color((size_t)width * height, 0),
+    depth((size_t)width * height, 1.0f)
+{}
+
+void SoftwareRasterizer::clear(const glm::vec4& clearColor, float clearDepth) {
+    std::fill(color.begin(), color.end(), packColor(clearColor));
+    std::fill(depth.begin(), depth.end(), clearDepth);
+}
+
+void SoftwareRasterizer::drawTriangles(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds, const glm::mat4& projection,
+    const glm::mat4& view, const glm::mat4& model, const RasterMaterial& material)
+{
+    size_t n_tris = n_inds / 3;
+    for (size_t i = 0; i < n_tris * 3; i++) {
+        if (inds[i] >= n_vs) {
+            std::cout << "ERROR::RASTERIZER:: index " << inds[i] << " out of range of " << n_vs << " vertices\n";
+            return;
+        }
+    }
+    std::vector<ShadedVertex> verts = transformVertices(vs, n_vs, projection, view, model);
+    process<RasterTriangle>(width, height, n_tris, [&](size_t t, std::vector<RasterTriangle>& out) {
+        clipAndSetup(verts[inds[3 * t]], verts[inds[3 * t + 1]], verts[inds[3 * t + 2]], width, height, material.cullBackFaces, out);
+    }, [&](const RasterTriangle& tri, int x0, int y0, int x1, int y1) {
+        rasterTriangle(tri, x0, y0, x1, y1, material, color.data(), depth.data(), width);
+    });
+}
+
+void SoftwareRasterizer::drawPoints(const VertexData* vs, size_t n_vs, float pointSize, const glm::mat4& projection, const glm::mat4& view,
+    const glm::mat4& model, const RasterMaterial& material)
+{
+    std::vector<ShadedVertex> verts = transformVertices(vs, n_vs, projection, view, model);
+    float half = 0.5f * std::max(pointSize, 1.0f);
+    process<RasterPoint>(width, height, n_vs, [&](size_t i, std::vector<RasterPoint>& out) {
+        const glm::vec4& c = verts[i].clip;
+        if (!(c.w > 0) || std::fabs(c.x) > c.w || std::fabs(c.y) > c.w || std::fabs(c.z) > c.w) return;
+        float x = snap((c.x / c.w * 0.5f + 0.5f) * width);
+        float y = snap((c.y / c.w * 0.5f + 0.5f) * height);
+        // pixels whose centers are inside [x - half, x + half)
+        RasterPoint p;
+        p.minX = std::max(0, (int)std::ceil(x - half - 0.5f));
+        p.minY = std::max(0, (int)std::ceil(y - half - 0.5f));
+        p.maxX = std::min(width - 1, (int)std::ceil(x + half - 0.5f) - 1);
+        p.maxY = std::min(height - 1, (int)std::ceil(y + half - 0.5f) - 1);
+        if (p.minX > p.maxX || p.minY > p.maxY) return;
+        p.z = c.z / c.w * 0.5f + 0.5f;
+        p.normal = verts[i].normal;
+        p.uv = verts[i].uv;
+        out.push_back(p);
+    }, [&](const RasterPoint& p, int x0, int y0, int x1, int y1) {
+        x0 = std::max(x0, p.minX);
+        x1 = std::min(x1, p.maxX);
+        y0 = std::max(y0, p.minY);
+        y1 = std::min(y1, p.maxY);
+        if (x0 > x1 || y0 > y1) return;
+        uint32_t shaded = shade(material, p.normal, p.uv);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                size_t at = (size_t)y * width + x;
+                if (!(p.z < depth[at])) continue;
+                depth[at] = p.z;
+                color[at] = shaded;
+            }
+        }
+    });
+}
+
+void SoftwareRasterizer::draw(const Mesh& mesh, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, const RasterMaterial& material) {
+    if (mesh.vertices.empty() || mesh.indices.empty()) {
+        std::cout << "ERROR::RASTERIZER:: mesh has no CPU data, load it with Retain_type::ALL\n";
+        return;
+    }
+    drawTriangles(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.lods[0].indexCount, projection, view, model, material);
+}
+
+void SoftwareRasterizer::draw(Model& model, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& placement, RasterMaterial material) {
+    model.scene.update();
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        const Mesh& mesh = model.meshes[i];
+        material.texture = nullptr;
+        material.srgbTexture = model.gammaCorrection;
+        for (const TextureData& texture : mesh.textures) {
+            if (texture.type != "texture_diffuse") continue;
+            material.texture = image(model.directory + '/' + texture.path);
+            break;
+        }
+        int node = i < model.meshNodes.size() ? model.meshNodes[i] : -1;
+        draw(mesh, projection, view, node < 0 ? placement : multiply(placement, model.scene.world(node)), material);
+    }
+}
+
+void SoftwareRasterizer::draw(const MeshData& mesh, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, const RasterMaterial& material) {
+    if (mesh.vertices.empty() || mesh.indices.empty()) {
+        std::cout << "ERROR::RASTERIZER:: mesh has no CPU data, compiled meshes are drawn through their ModelData\n";
+        return;
+    }
+    size_t n_inds = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+    drawTriangles(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), n_inds, projection, view, model, material);
+}
+
+void SoftwareRasterizer::draw(ModelData& data, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& placement, RasterMaterial material) {
+    data.scene.update();
+    for (size_t i = 0; i < data.meshes.size(); i++) {
+        const MeshData& mesh = data.meshes[i];
+        material.texture = nullptr;
+        for (const TextureData& texture : mesh.textures) {
+            if (texture.type != "texture_diffuse" || texture.id >= data.textures.size()) continue;
+            // ids index data.textures until upload, atlas pages only exist as images
+            if (texture.id < data.images.size() && data.images[texture.id].pixels) material.texture = &data.images[texture.id];
+            else material.texture = image(data.directory + '/' + data.textures[texture.id].path);
+            break;
+        }
+        // compiled meshes stay in the mapping, except for vertices remapped into an atlas
+        const VertexData* vs = mesh.vertices.data();
+        size_t n_vs = mesh.vertices.size();
+        const unsigned int* inds = mesh.indices.data();
+        if (data.cache) {
+            const ModelCacheMesh& m = data.cache->mesh(i);
+            if (mesh.vertices.empty()) {
+                vs = data.cache->vertices(m);
+                n_vs = m.vertexCount;
+            }
+            if (mesh.indices.empty()) inds = data.cache->indices(m);
+        }
+        size_t n_inds = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+        glm::mat4 model = mesh.node < 0 ? placement : multiply(placement, data.scene.world(mesh.node));
+        drawTriangles(vs, n_vs, inds, n_inds, projection, view, model, material);
+    }
+}
+
+const ImageData* SoftwareRasterizer::image(const std::string& path) {
+    auto it = images.find(path);
+    if (it == images.end()) it = images.emplace(path, ImageData(path)).first;
+    return it->second.pixels ? &it->second : nullptr;
+}
+
+bool SoftwareRasterizer::writePPM(const std::string& path) const {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        std::cout << "ERROR::RASTERIZER:: can't write " << path << "\n";
+        return false;
+    }
+    std::fprintf(f, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row(3 * (size_t)width);
+    bool ok = true;
+    for (int y = height - 1; y >= 0 && ok; y--) {
+        for (int x = 0; x < width; x++) {
+            uint32_t c = color[(size_t)y * width + x];
+            row[3 * x] = c & 0xff;
+            row[3 * x + 1] = (c >> 8) & 0xff;
+            row[3 * x + 2] = (c >> 16) & 0xff;
+        }
+        ok = std::fwrite(row.data(), 1, row.size(), f) == row.size();
+    }
+    return std::fclose(f) == 0 && ok;
+}
+
+double imageDifference(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, int tolerance) {
+    if (a.size() != b.size()) return 1.0;
+    if (a.empty()) return 0.0;
+    size_t different = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        for (int k = 0; k < 32; k += 8) {
+            int d = (int)((a[i] >> k) & 0xff) - (int)((b[i] >> k) & 0xff);
+            if (d > tolerance || -d > tolerance) {
+                different++;
+                break;
+            }
+        }
+    }
+    return (double)different / a.size();
+}
@@ -0,0 +1,90 @@
+#ifndef SOFTWARE_RASTERIZER_HH
+#define SOFTWARE_RASTERIZER_HH
+
+#include "Mesh.h"
+#include "Model.h"
+#include "Texture.h"
+
+#include <glm/glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// pixels per side of a tile, a multiple of the 4 pixels the inner loop does at once
+#define RASTER_TILE_SIZE 64
+// primitives set up and binned before the tiles are drawn, bounds the scratch memory of large draws
+#define RASTER_BATCH 65536
+
+// built in stand ins for the usual forward shaders
+enum class Shading_type {
+    // color times the texture
+    UNLIT,
+    // world space normal mapped to [0, 1]
+    NORMALS,
+    // UNLIT lit by one directional light plus ambient
+    LAMBERT
+};
+
+struct RasterMaterial {
+    Shading_type shading = Shading_type::LAMBERT;
+    glm::vec4 color = glm::vec4(1.0f);
+    // diffuse texture, sampled bilinearly with repeat. Rows in upload order like uploadTexture2D
+    const ImageData* texture = nullptr;
+    // the texture holds sRGB values, decoded like an sRGB texture would be
+    bool srgbTexture = false;
+    // world space direction the light travels in
+    glm::vec3 lightDirection = glm::vec3(-0.3f, -1.0f, -0.5f);
+    float ambient = 0.2f;
+    // culls clockwise triangles, like glEnable(GL_CULL_FACE) with the default front face
+    bool cullBackFaces = false;
+};
+
+// CPU rendering for machines without a GPU, following the GL conventions so the images compare with glReadPixels:
+// pixel centers at half integers, depth range [0, 1] with GL_LESS, counter clockwise front faces, rows bottom up
+// and RGBA8 pixels. Vertices are snapped to 1/256 pixel and covered with exact integer edge functions, shared edges
+// are filled once (top-left rule).
+// Primitives are set up and binned into tiles in parallel, then every tile is drawn by one job in submission order,
+// 4 pixels at a time with SSE where the target has it.
+class SoftwareRasterizer {
+public:
+    int width, height;
+    // width * height each, bottom row first
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+
+    SoftwareRasterizer(int w, int h);
+
+    void clear(const glm::vec4& clearColor, float clearDepth = 1.0f);
+    // triangles of inds, clipped against the view volume like GL does
+    void drawTriangles(const VertexData* vs, size_t n_vs, const unsigned int* inds, size_t n_inds, const glm::mat4& projection,
+        const glm::mat4& view, const glm::mat4& model, const RasterMaterial& material);
+    // squares of pointSize pixels, dropped when their center is outside the view volume
+    void drawPoints(const VertexData* vs, size_t n_vs, float pointSize, const glm::mat4& projection, const glm::mat4& view,
+        const glm::mat4& model, const RasterMaterial& material);
+    // the full level of detail of a mesh that kept its CPU data (Retain_type::ALL)
+    void draw(const Mesh& mesh, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, const RasterMaterial& material);
+    // every mesh placed by its node like Model::Draw(shader, model), with its first diffuse texture.
+    // skinned meshes are drawn in bind pose
+    void draw(Model& model, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& placement, RasterMaterial material);
+    // the same without GL, straight from Model::import. Textures come from data.images or are decoded from their files,
+    // material.srgbTexture is used as given
+    void draw(const MeshData& mesh, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, const RasterMaterial& material);
+    void draw(ModelData& data, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& placement, RasterMaterial material);
+
+    // binary PPM, top row first
+    bool writePPM(const std::string& path) const;
+
+private:
+    // images of the model textures, decoded on first use
+    std::unordered_map<std::string, ImageData> images;
+
+    // nullptr if the file can't be decoded
+    const ImageData* image(const std::string& path);
+};
+
+// fraction of pixels where some channel differs by more than tolerance, 1 if the sizes differ
+double imageDifference(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, int tolerance);
+
+#endif
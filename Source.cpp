@@ -1,8 +1,9 @@
 //#include "Geometry.h"
 #include "Shader.h"
 #include "Camera.h"
-#include "Runtimefunctions.h"
+#include "RuntimeFunctions.h"
 #include "HighLevelRendering.h"
+#include "TextureRegistry.h"
 
 #include "ChaosGame.h"
 
@@ -103,6 +104,8 @@ int main() {
     }
 
     delete[] vs;
+    // GL objects have to go while the context exists
+    TextureRegistry::global().shutdown();
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,117 @@
+#include "Tessellation.h"
+#include "Geometry.h"
+#include "Camera.h"
+#include "RuntimeFunctions.h"
+
+#include <algorithm>
+#include <cmath>
+
+const double pi = 3.14159265358979323846;
+
+std::vector<unsigned int> trianglularDecomp_Sphere(size_t vs_size, size_t layers, size_t npts);
+
+// points around the circumference, roughly sqrt(2) apart so neighbouring levels differ by half the triangles
+const size_t LEVEL_POINTS[] = { 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384 };
+
+std::vector<unsigned int> trianglularDecomp_Cone(size_t npts) {
+    // sides wind counter clockwise seen from outside, base cap faces -z
+    std::vector<unsigned int> indices;
+    indices.reserve(3 * (2 * npts - 2));
+    unsigned int apex = npts;
+    for (unsigned int i = 0; i < npts; i++) {
+        indices.insert(indices.end(), { i, static_cast<unsigned int>((i + 1) % npts), apex });
+    }
+    for (unsigned int i = 1; i + 1 < npts; i++) {
+        indices.insert(indices.end(), { 0, i + 1, i });
+    }
+    return indices;
+}
+
+std::vector<unsigned int> trianglularDecomp_Bicone(size_t npts) {
+    std::vector<unsigned int> indices;
+    indices.reserve(6 * npts);
+    unsigned int top = npts;
+    unsigned int bot = npts + 1;
+    for (unsigned int i = 0; i < npts; i++) {
+        unsigned int j = (i + 1) % npts;
+        indices.insert(indices.end(), { i, j, top });
+        indices.insert(indices.end(), { j, i, bot });
+    }
+    return indices;
+}
+
+/////////////////////////////////////
+/// Tessellated Shape Definitions ///
+/////////////////////////////////////
+
+TessellatedShape::TessellatedShape(const std::vector<float>& vs, const std::vector<unsigned int>& inds) {
+    vertices = vs;
+    indices = inds;
+    generateColorData();
+    generateTexCoords();
+    generateNormals();
+    sendVertexData();
+}
+
+//////////////////////////////////
+/// Adaptive Shape Definitions ///
+//////////////////////////////////
+
+AdaptiveShape::AdaptiveShape(Curved_type type, float radius, float zp, float zm, float targetEdgePixels) :
+    type{ type },
+    radius{ radius },
+    zp{ zp },
+    zm{ zm },
+    targetEdgePixels{ targetEdgePixels },
+    hysteresis{ 0.25f }
+{}
+
+size_t AdaptiveShape::basePoints(int level) {
+    return LEVEL_POINTS[std::clamp(level, 0, MAX_LEVEL)];
+}
+
+float AdaptiveShape::idealLevel(const glm::vec3& center, const Camera& camera, float scale) const {
+    // pixels covered by one world unit at the object's distance for the current perspective projection
+    float r = radius * scale;
+    float d = std::max(glm::length(camera.Position - center) - r, 0.1f);
+    float ppu = SCR_HEIGHT / (2 * d * std::tan(glm::radians(camera.Zoom) / 2));
+    // points needed for the circumference to be cut into target sized edges
+    float n = 2 * pi * r * ppu / targetEdgePixels;
+    if (n <= LEVEL_POINTS[0]) return 0;
+    if (n >= LEVEL_POINTS[MAX_LEVEL]) return MAX_LEVEL;
+    int l = 0;
+    while (LEVEL_POINTS[l + 1] < n) l++;
+    return l + std::log(n / LEVEL_POINTS[l]) / std::log((float)LEVEL_POINTS[l + 1] / LEVEL_POINTS[l]);
+}
+
+Shape& AdaptiveShape::select(const glm::vec3& center, const Camera& camera, TessellationState& s, float scale) {
+    float ideal = idealLevel(center, camera, scale);
+    // only move once the ideal level is well past the current one
+    if (s.level < 0 || std::fabs(ideal - s.level) > 0.5f + hysteresis) {
+        s.level = std::clamp(static_cast<int>(std::lround(ideal)), 0, MAX_LEVEL);
+    }
+    return level(s.level);
+}
+
+Shape& AdaptiveShape::select(const glm::vec3& center, const Camera& camera, float scale) {
+    return select(center, camera, state, scale);
+}
+
+Shape& AdaptiveShape::level(int l) {
+    std::unique_ptr<TessellatedShape>& shape = cache[l];
+    if (shape) return *shape;
+    size_t npts = basePoints(l);
+    if (type == Curved_type::SPHERE) {
+        // equal angular spacing along latitude and longitude
+        size_t layers = npts / 2 - 1;
+        std::vector<float> vs = createSphere(radius, layers, npts);
+        shape.reset(new TessellatedShape(vs, trianglularDecomp_Sphere(vs.size(), layers, npts)));
+    }
+    else if (type == Curved_type::CONE) {
+        shape.reset(new TessellatedShape(createCone(npts, radius, zp), trianglularDecomp_Cone(npts)));
+    }
+    else {
+        shape.reset(new TessellatedShape(createBicone(npts, radius, zp, zm), trianglularDecomp_Bicone(npts)));
+    }
+    return *shape;
+}
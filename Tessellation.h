@@ -0,0 +1,63 @@
+#ifndef TESSELLATION_HH
+#define TESSELLATION_HH
+
+#include "GeometryOld.h"
+
+#include <glm/glm/glm.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+class Camera;
+
+enum class Curved_type {
+	SPHERE,
+	CONE,
+	BICONE
+};
+
+// shape around prebuilt vertex and index buffers
+class TessellatedShape : public Shape {
+public:
+	TessellatedShape(const std::vector<float>& vs, const std::vector<unsigned int>& inds);
+};
+
+// per object tessellation state, keeps the selected level between frames
+struct TessellationState {
+	int level = -1;
+};
+
+// Screen space adaptive tessellation for the curved primitives in Geometry.h
+// The level is chosen so edges project to roughly targetEdgePixels on screen, using the
+// projection built from Camera::Zoom and SCR_WIDTH x SCR_HEIGHT. Every level is generated
+// once and cached, so objects at similar distances share geometry across frames.
+class AdaptiveShape {
+public:
+	Curved_type type;
+	float radius;
+	// apex heights for cones (zp) and bicones (zp, zm)
+	float zp, zm;
+	float targetEdgePixels;
+	// fraction of a level the ideal level must move past a boundary before switching, avoids popping
+	float hysteresis;
+
+	AdaptiveShape(Curved_type type, float radius, float zp = 1, float zm = -1, float targetEdgePixels = 8);
+
+	// number of points around the circumference for a level
+	static size_t basePoints(int level);
+	// continuous level that would hit the target edge size for an object at center, scaled by scale
+	float idealLevel(const glm::vec3& center, const Camera& camera, float scale = 1) const;
+	// selects a level with hysteresis and returns the cached shape for it
+	Shape& select(const glm::vec3& center, const Camera& camera, TessellationState& state, float scale = 1);
+	// single object convenience
+	Shape& select(const glm::vec3& center, const Camera& camera, float scale = 1);
+
+private:
+	static constexpr int MAX_LEVEL = 12;
+	TessellationState state;
+	std::map<int, std::unique_ptr<TessellatedShape>> cache;
+	Shape& level(int l);
+};
+
+#endif
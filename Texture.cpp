@@ -1,26 +1,122 @@
 #include "Texture.h"
+#include "TextureCompression.h"
 
 #include <glad/glad.h>
 #include <stb/stb_image.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
+ImageData::ImageData(void) :
+    pixels{ nullptr }, width{ 0 }, height{ 0 }, components{ 0 }
+{}
+
+ImageData::ImageData(const std::string& path) {
+    pixels = stbi_load(path.c_str(), &width, &height, &components, 0);
+    if (!pixels) width = height = components = 0;
+}
+
+ImageData::ImageData(int w, int h, int c) :
+    width{ w }, height{ h }, components{ c }
+{
+    // stb_image allocates with malloc, so stbi_image_free releases these too
+    pixels = (unsigned char*)std::calloc((size_t)w * h * c, 1);
+    if (!pixels) width = height = components = 0;
+}
+
+ImageData::ImageData(ImageData&& other) :
+    pixels{ other.pixels }, width{ other.width }, height{ other.height }, components{ other.components }, mips{ std::move(other.mips) }
+{
+    other.pixels = nullptr;
+}
+
+ImageData& ImageData::operator=(ImageData&& other) {
+    if (this != &other) {
+        stbi_image_free(pixels);
+        pixels = other.pixels;
+        width = other.width;
+        height = other.height;
+        components = other.components;
+        mips = std::move(other.mips);
+        other.pixels = nullptr;
+    }
+    return *this;
+}
+
+ImageData::~ImageData(void) {
+    stbi_image_free(pixels);
+}
+
+bool imageFormat(int components, bool srgb, unsigned int& format, unsigned int& internalFormat) {
+    if (components == 1) format = GL_RED;
+    else if (components == 2) format = GL_RG;
+    else if (components == 3) format = GL_RGB;
+    else if (components == 4) format = GL_RGBA;
+    else return false;
+
+    internalFormat = format;
+    if (srgb && format == GL_RGB) internalFormat = GL_SRGB8;
+    else if (srgb && format == GL_RGBA) internalFormat = GL_SRGB8_ALPHA8;
+    return true;
+}
+
+unsigned int uploadTexture2D(const ImageData& image, bool srgb) {
+    if (!image.pixels) return 0;
+    unsigned int format, internalFormat;
+    if (!imageFormat(image.components, srgb, format, internalFormat)) {
+        std::cout << "undefined stbi image format\n";
+        return 0;
+    }
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    // rows of 1 and 3 channel images aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+    for (size_t l = 0; l < image.mips.size(); l++) {
+        const ImageData& mip = image.mips[l];
+        glTexImage2D(GL_TEXTURE_2D, (GLint)l + 1, internalFormat, mip.width, mip.height, 0, format, GL_UNSIGNED_BYTE, mip.pixels);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (image.mips.empty()) glGenerateMipmap(GL_TEXTURE_2D);
+    else glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.mips.size());
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
 Texture::Texture(const std::string& name) {
-    glGenTextures(1, &ID);
+    ID = GLTexture::create();
     glBindTexture(GL_TEXTURE_2D, ID);
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    std::string ext = name.substr(name.length() - 3);
-    unsigned char* imageData = stbi_load(name.c_str(), &width, &height, &nrChannels, 0);
-    if (imageData) {
-        if (ext == "jpg") glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-        else if (ext == "png") glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
-        else std::cout << "invalid file type\n";
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cout << "Failed to load texture\n";
+    // containers come with their mip chain and aren't flipped, they are stored in the order they are uploaded
+    if (isCompressedTextureFile(name)) {
+        CompressedImage image;
+        if (!readCompressedImage(name, image) || image.faces != 1 || !uploadCompressedLevels(GL_TEXTURE_2D, image, 0)) std::cout << "Failed to load texture\n";
+        else glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    }
+    else {
+        int width, height, nrChannels;
+        std::string ext = name.substr(name.length() - 3);
+        unsigned char* imageData = stbi_load(name.c_str(), &width, &height, &nrChannels, 0);
+        if (imageData) {
+            // bottom row first, v = 0 is the bottom of the image. Flipped here rather than through stb_image's flag,
+            // which is global and would flip the images decoded on the pool as well
+            size_t row = (size_t)width * nrChannels;
+            for (int y = 0; y < height / 2; y++) std::swap_ranges(imageData + y * row, imageData + (y + 1) * row, imageData + (height - 1 - y) * row);
+            if (ext == "jpg") glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+            else if (ext == "png") glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+            else std::cout << "invalid file type\n";
+            glGenerateMipmap(GL_TEXTURE_2D);
+        } else {
+            std::cout << "Failed to load texture\n";
+        }
+        stbi_image_free(imageData);
     }
-    stbi_image_free(imageData);
     // assocaite each texture with a new texture unit
     static size_t u = 0;
     unit = u++;
@@ -90,8 +186,4 @@ void Texture::setBoarderCol(std::vector<float>& rgba) {
 void Texture::bind(void) {
     glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(GL_TEXTURE_2D, ID);
-}
-
-Texture::~Texture(void) {
-    glDeleteTextures(1, &ID);
 }
\ No newline at end of file
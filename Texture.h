@@ -1,6 +1,8 @@
 #ifndef TEXTURE_HH
 #define TEXTURE_HH
 
+#include "GLHandle.h"
+
 #include <string>
 #include <vector>
 
@@ -20,20 +22,48 @@ enum class Filter_type {
     LML
 };
 
+// decoded image kept on the CPU so decoding can run off the GL thread, owns its pixels
+struct ImageData {
+    unsigned char* pixels;
+    int width, height, components;
+    // levels 1 and down when the chain was built on the CPU, see generateMipmaps. empty lets the upload build it
+    std::vector<ImageData> mips;
+
+    ImageData(void);
+    // decodes with stb_image in file order, top row first. That is the order of KTX2 and DDS blocks too and what
+    // models imported with aiProcess_FlipUVs expect. Relies on stb_image's global flip flag staying off, nothing
+    // here sets it. pixels is null if the file couldn't be read
+    ImageData(const std::string& path);
+    // zeroed pixels to fill on the CPU
+    ImageData(int w, int h, int c);
+    ImageData(ImageData&& other);
+    ImageData& operator=(ImageData&& other);
+    ImageData(const ImageData&) = delete;
+    ImageData& operator=(const ImageData&) = delete;
+    ~ImageData(void);
+};
+
+// GL_RED, GL_RG, GL_RGB or GL_RGBA for the channels of an image, and the internal format to store it in.
+// false for channel counts GL can't take
+bool imageFormat(int components, bool srgb, unsigned int& format, unsigned int& internalFormat);
+// creates a mipmapped, repeating 2D texture from a decoded image and its mips, needs the GL context. The caller owns the name.
+// srgb stores color images as sRGB so sampling returns linear values
+unsigned int uploadTexture2D(const ImageData& image, bool srgb = false);
+
 class Texture {
 public:
-    unsigned int ID;
+    GLTexture ID;
     // might be better not to associate each texture with a texture unit
     size_t unit;
     
+    // image files are flipped so v = 0 is their bottom row. KTX2 and DDS files go up top row first, block
+    // compressed data can't be flipped in general, so geometry sampling them needs v flipped
     Texture(const std::string& name);
     void setWrapMode(Wrap_type type);
     void setMinFilter(Filter_type type);
     void setMagFilter(Filter_type type);
     void setBoarderCol(std::vector<float>& rgba);
     void bind(void);
-
-    ~Texture(void);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "TextureAtlas.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+// uvs this far outside [0, 1] still count as inside, exporters leave rounding noise on border vertices
+const float UV_TOLERANCE = 1e-4f;
+
+////////////////////////////
+/// RectPacker Definitions ///
+////////////////////////////
+
+RectPacker::RectPacker(int w, int h) :
+    width{ w }, height{ h }, used{ 0 }, free{ { 0, 0, w, h } }
+{}
+
+bool RectPacker::insert(int w, int h, int& x, int& y) {
+    size_t best = free.size();
+    int bestShort = 0, bestLong = 0;
+    for (size_t i = 0; i < free.size(); i++) {
+        const Rect& r = free[i];
+        if (r.w < w || r.h < h) continue;
+        int shortSide = std::min(r.w - w, r.h - h), longSide = std::max(r.w - w, r.h - h);
+        if (best == free.size() || shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+            best = i;
+            bestShort = shortSide;
+            bestLong = longSide;
+        }
+    }
+    if (best == free.size()) return false;
+    Rect placed{ free[best].x, free[best].y, w, h };
+
+    // every free rectangle the placement overlaps is replaced by the up to four maximal ones around it
+    std::vector<Rect> split;
+    for (const Rect& r : free) {
+        if (placed.x >= r.x + r.w || placed.x + placed.w <= r.x || placed.y >= r.y + r.h || placed.y + placed.h <= r.y) {
+            split.push_back(r);
+            continue;
+        }
+        if (placed.x > r.x) split.push_back({ r.x, r.y, placed.x - r.x, r.h });
+        if (placed.x + placed.w < r.x + r.w) split.push_back({ placed.x + placed.w, r.y, r.x + r.w - placed.x - placed.w, r.h });
+        if (placed.y > r.y) split.push_back({ r.x, r.y, r.w, placed.y - r.y });
+        if (placed.y + placed.h < r.y + r.h) split.push_back({ r.x, placed.y + placed.h, r.w, r.y + r.h - placed.y - placed.h });
+    }
+    // drop rectangles contained in others, keeping one of identical ones
+    free.clear();
+    for (size_t i = 0; i < split.size(); i++) {
+        const Rect& a = split[i];
+        bool contained = false;
+        for (size_t j = 0; j < split.size() && !contained; j++) {
+            if (i == j) continue;
+            const Rect& b = split[j];
+            bool inside = a.x >= b.x && a.y >= b.y && a.x + a.w <= b.x + b.w && a.y + a.h <= b.y + b.h;
+            bool same = a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+            contained = inside && (!same || j < i);
+        }
+        if (!contained) free.push_back(a);
+    }
+    used += (size_t)w * h;
+    x = placed.x;
+    y = placed.y;
+    return true;
+}
+
+float RectPacker::occupancy(void) const {
+    return (float)used / ((float)width * height);
+}
+
+///////////////////////////////////
+/// TextureAtlas Definitions ///
+///////////////////////////////////
+
+TextureAtlas::TextureAtlas(int layerCount, int size, int levels) :
+    layers{ std::max(layerCount, 1) },
+    pageSize{ size },
+    mipLevels{ std::max(levels, 1) }
+{}
+
+bool TextureAtlas::add(const std::vector<const ImageData*>& images, size_t& entry) {
+    if ((int)images.size() != layers) return false;
+    for (const ImageData* image : images) {
+        if (!image || !image->pixels || image->components < 1 || image->components > 4) return false;
+        if (image->width != images[0]->width || image->height != images[0]->height) return false;
+    }
+    int w = images[0]->width, h = images[0]->height;
+    int gutter = 1 << (mipLevels - 1);
+    if (w > ATLAS_MAX_IMAGE_SIZE || h > ATLAS_MAX_IMAGE_SIZE || std::max(w, h) + 2 * gutter > pageSize) return false;
+    entry = entries.size();
+    entries.push_back(Entry{ images });
+    return true;
+}
+
+void TextureAtlas::build(void) {
+    // the gutter is also the alignment, so every image starts on a texel of each of the mip levels
+    int cell = 1 << (mipLevels - 1);
+    int cells = pageSize / cell;
+    std::vector<size_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto cellsOf = [&](int pixels) { return (pixels + cell - 1) / cell + 2; };
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const ImageData& ia = *entries[a].images[0];
+        const ImageData& ib = *entries[b].images[0];
+        int sa = std::max(ia.width, ia.height), sb = std::max(ib.width, ib.height);
+        if (sa != sb) return sa > sb;
+        return ia.width * ia.height > ib.width * ib.height;
+    });
+
+    std::vector<RectPacker> packers;
+    regions.assign(entries.size(), AtlasRegion{});
+    for (size_t e : order) {
+        const ImageData& image = *entries[e].images[0];
+        int w = cellsOf(image.width), h = cellsOf(image.height);
+        int cx = 0, cy = 0;
+        size_t page = 0;
+        while (page < packers.size() && !packers[page].insert(w, h, cx, cy)) page++;
+        if (page == packers.size()) {
+            packers.emplace_back(cells, cells);
+            packers.back().insert(w, h, cx, cy);
+        }
+        AtlasRegion& region = regions[e];
+        region.page = (unsigned int)page;
+        region.x = (cx + 1) * cell;
+        region.y = (cy + 1) * cell;
+        region.width = image.width;
+        region.height = image.height;
+        region.offset = glm::vec2((float)region.x / pageSize, (float)region.y / pageSize);
+        region.scale = glm::vec2((float)image.width / pageSize, (float)image.height / pageSize);
+    }
+
+    pages.clear();
+    pages.reserve(packers.size() * layers);
+    for (size_t i = 0; i < packers.size() * layers; i++) pages.emplace_back(pageSize, pageSize, 4);
+    for (size_t e = 0; e < entries.size(); e++) {
+        const AtlasRegion& region = regions[e];
+        int x0 = region.x - cell, y0 = region.y - cell;
+        int x1 = x0 + cellsOf(region.width) * cell, y1 = y0 + cellsOf(region.height) * cell;
+        for (int layer = 0; layer < layers; layer++) {
+            const ImageData& image = *entries[e].images[layer];
+            ImageData& page = pages[region.page * layers + layer];
+            // the gutter repeats the nearest edge texel, expanded like GL_RED, GL_RG and GL_RGB uploads read
+            for (int y = y0; y < y1; y++) {
+                int sy = std::min(std::max(y - region.y, 0), image.height - 1);
+                for (int x = x0; x < x1; x++) {
+                    int sx = std::min(std::max(x - region.x, 0), image.width - 1);
+                    const unsigned char* p = image.pixels + ((size_t)sy * image.width + sx) * image.components;
+                    unsigned char* q = page.pixels + ((size_t)y * pageSize + x) * 4;
+                    q[0] = p[0];
+                    q[1] = image.components > 1 ? p[1] : 0;
+                    q[2] = image.components > 2 ? p[2] : 0;
+                    q[3] = image.components > 3 ? p[3] : 255;
+                }
+            }
+        }
+    }
+}
+
+unsigned int TextureAtlas::upload(size_t page, int layer, bool srgb) const {
+    if (page >= pageCount() || layer < 0 || layer >= layers) return 0;
+    return uploadAtlasPage(pages[page * layers + layer], srgb, mipLevels);
+}
+
+unsigned int uploadAtlasPage(const ImageData& page, bool srgb, int mipLevels) {
+    unsigned int id = uploadTexture2D(page, srgb);
+    if (!id) return 0;
+    // deeper levels would blend neighboring images, and nothing may repeat across the page
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return id;
+}
+
+////////////////////////////
+/// UV Remapping ///
+////////////////////////////
+
+bool texCoordsInUnitSquare(const VertexData* vs, size_t n_vs) {
+    for (size_t i = 0; i < n_vs; i++) {
+        const glm::vec2& uv = vs[i].TexCoords;
+        if (uv.x < -UV_TOLERANCE || uv.x > 1 + UV_TOLERANCE || uv.y < -UV_TOLERANCE || uv.y > 1 + UV_TOLERANCE) return false;
+    }
+    return true;
+}
+
+bool texCoordsInUnitSquare(const std::vector<float>& texcoords) {
+    for (float t : texcoords) {
+        if (t < -UV_TOLERANCE || t > 1 + UV_TOLERANCE) return false;
+    }
+    return true;
+}
+
+void remapTexCoords(VertexData* vs, size_t n_vs, const AtlasRegion& region) {
+    for (size_t i = 0; i < n_vs; i++) {
+        glm::vec2& uv = vs[i].TexCoords;
+        uv = region.offset + glm::vec2(uv.x * region.scale.x, uv.y * region.scale.y);
+    }
+}
+
+void remapTexCoords(std::vector<float>& texcoords, const AtlasRegion& region) {
+    for (size_t i = 0; i + 1 < texcoords.size(); i += 2) {
+        texcoords[i] = region.offset.x + texcoords[i] * region.scale.x;
+        texcoords[i + 1] = region.offset.y + texcoords[i + 1] * region.scale.y;
+    }
+}
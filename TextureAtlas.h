@@ -0,0 +1,88 @@
+#ifndef TEXTURE_ATLAS_HH
+#define TEXTURE_ATLAS_HH
+
+#include "Mesh.h"
+#include "Texture.h"
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+
+// pixels per side of a page
+#define ATLAS_PAGE_SIZE 2048
+// images larger than this on either side keep their own texture, they gain little from sharing a page
+#define ATLAS_MAX_IMAGE_SIZE 512
+// mip levels that never sample a neighbor. Images are aligned to 2^(levels - 1) pixels and get a gutter as wide
+// of their repeated edge texels, the pages stop their chain at the last of these levels
+#define ATLAS_MIP_LEVELS 4
+
+// where an image ended up, its uvs become offset + uv * scale
+struct AtlasRegion {
+    unsigned int page;
+    // the image itself in page pixels, the gutter is around it
+    int x, y, width, height;
+    glm::vec2 offset, scale;
+};
+
+// MaxRects bin packing with the best short side fit rule: every placement keeps the maximal free rectangles,
+// and a new image goes where it leaves the least on its tighter side
+class RectPacker {
+public:
+    RectPacker(int width, int height);
+    // false if there is no room, x and y are left alone then
+    bool insert(int w, int h, int& x, int& y);
+    // fraction of the area in use
+    float occupancy(void) const;
+
+private:
+    struct Rect {
+        int x, y, w, h;
+    };
+    int width, height;
+    size_t used;
+    std::vector<Rect> free;
+};
+
+// Packs small images into shared pages so meshes that used different textures can be drawn with one. An entry is
+// a set of equally sized images, one per layer, e.g. the diffuse and specular map of a material: they get the same
+// rectangle on the pages of their layers, so one uv transform serves all of them. Pages clamp instead of repeating,
+// only geometry with uvs inside [0, 1] can move into an atlas.
+class TextureAtlas {
+public:
+    int layers, pageSize, mipLevels;
+    // one per entry, filled by build
+    std::vector<AtlasRegion> regions;
+    // RGBA8, page * layers + layer, filled by build
+    std::vector<ImageData> pages;
+
+    TextureAtlas(int layers = 1, int pageSize = ATLAS_PAGE_SIZE, int mipLevels = ATLAS_MIP_LEVELS);
+
+    // queues an entry, the images have to stay alive until build. false if their sizes differ or they are larger
+    // than ATLAS_MAX_IMAGE_SIZE, entry is its index in regions otherwise
+    bool add(const std::vector<const ImageData*>& images, size_t& entry);
+    size_t size(void) const { return entries.size(); }
+    // packs the entries largest first, opening pages as they fill up, and copies the images in. Needs no GL
+    void build(void);
+    size_t pageCount(void) const { return pages.size() / layers; }
+
+    // texture of one page layer, see uploadAtlasPage
+    unsigned int upload(size_t page, int layer, bool srgb = false) const;
+
+private:
+    struct Entry {
+        std::vector<const ImageData*> images;
+    };
+    std::vector<Entry> entries;
+};
+
+// clamped texture of a page, mipmapped down to mipLevels. Needs the GL context, the caller owns the name
+unsigned int uploadAtlasPage(const ImageData& page, bool srgb = false, int mipLevels = ATLAS_MIP_LEVELS);
+
+// whether uvs stay inside [0, 1], the ones outside would sample the neighbors in an atlas instead of repeating
+bool texCoordsInUnitSquare(const VertexData* vs, size_t n_vs);
+// texcoords as two floats per vertex, like Shape keeps them
+bool texCoordsInUnitSquare(const std::vector<float>& texcoords);
+void remapTexCoords(VertexData* vs, size_t n_vs, const AtlasRegion& region);
+void remapTexCoords(std::vector<float>& texcoords, const AtlasRegion& region);
+
+#endif
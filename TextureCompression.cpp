@@ -0,0 +1,914 @@
+#include "TextureCompression.h"
+#include "MipmapGeneration.h"
+#include "ModelCache.h"
+#include "ThreadPool.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// S3TC and BPTC come from extensions on a 3.3 context, the enums aren't in every loader
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+const char DDS_MAGIC[4] = { 'D', 'D', 'S', ' ' };
+// KTX2 key value entry holding the hash of the image a cache was made from
+const char SOURCE_HASH_KEY[] = "SourceHash";
+const char WRITER_KEY[] = "KTXwriter";
+const char WRITER[] = "OpenGL renderer TextureCompression";
+// block rows per job, levels below this are encoded on the calling thread
+const int MIN_PARALLEL_BLOCK_ROWS = 16;
+
+struct KTX2Header {
+    unsigned char identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth, pixelHeight, pixelDepth;
+    uint32_t layerCount, faceCount, levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset, dfdByteLength;
+    uint32_t kvdByteOffset, kvdByteLength;
+    uint64_t sgdByteOffset, sgdByteLength;
+};
+
+struct KTX2Level {
+    uint64_t byteOffset, byteLength, uncompressedByteLength;
+};
+
+struct DDSPixelFormat {
+    uint32_t size, flags, fourCC, rgbBitCount;
+    uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+struct DDSHeader {
+    uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat format;
+    uint32_t caps, caps2, caps3, caps4, reserved2;
+};
+
+struct DDSHeaderDX10 {
+    uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+};
+
+namespace {
+
+// Vulkan and DXGI names of the formats, unorm then srgb. BC4 and BC5 have no sRGB variant
+struct FormatInfo {
+    Block_type format;
+    uint32_t vkFormat, vkFormatSrgb;
+    uint32_t dxgiFormat, dxgiFormatSrgb;
+    // KTX2 data format descriptor color model
+    uint32_t colorModel;
+};
+
+const FormatInfo FORMATS[] = {
+    { Block_type::BC1, 131, 132, 71, 72, 128 },
+    { Block_type::BC3, 137, 138, 77, 78, 130 },
+    { Block_type::BC4, 139, 139, 80, 80, 131 },
+    { Block_type::BC5, 141, 141, 83, 83, 132 },
+    { Block_type::BC7, 145, 146, 98, 99, 134 }
+};
+
+const FormatInfo& formatInfo(Block_type format) {
+    for (const FormatInfo& info : FORMATS) {
+        if (info.format == format) return info;
+    }
+    return FORMATS[0];
+}
+
+bool hasSrgb(Block_type format) {
+    return format == Block_type::BC1 || format == Block_type::BC3 || format == Block_type::BC7;
+}
+
+uint32_t fourCC(const char* s) {
+    return (uint32_t)s[0] | ((uint32_t)s[1] << 8) | ((uint32_t)s[2] << 16) | ((uint32_t)s[3] << 24);
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    if (s.size() < suffix.size()) return false;
+    for (size_t i = 0; i < suffix.size(); i++) {
+        if (std::tolower((unsigned char)s[s.size() - suffix.size() + i]) != suffix[i]) return false;
+    }
+    return true;
+}
+
+int levelCount(int width, int height) {
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        levels++;
+    }
+    return levels;
+}
+
+////////////////////////////
+/// RGBA8 Levels ///
+////////////////////////////
+
+struct Rgba8Image {
+    int width, height;
+    std::vector<unsigned char> pixels;
+};
+
+// expanded like a GL_RED, GL_RG or GL_RGB upload reads
+Rgba8Image toRgba8(const ImageData& image) {
+    Rgba8Image out{ image.width, image.height, std::vector<unsigned char>((size_t)image.width * image.height * 4) };
+    for (size_t i = 0; i < (size_t)image.width * image.height; i++) {
+        const unsigned char* p = image.pixels + i * image.components;
+        unsigned char* q = out.pixels.data() + 4 * i;
+        q[0] = p[0];
+        q[1] = image.components > 1 ? p[1] : 0;
+        q[2] = image.components > 2 ? p[2] : 0;
+        q[3] = image.components > 3 ? p[3] : 255;
+    }
+    return out;
+}
+
+////////////////////////////
+/// Block Encoders ///
+////////////////////////////
+
+struct Color565 {
+    uint16_t packed;
+    float rgb[3];
+};
+
+Color565 quantize565(const float* c) {
+    int r = (int)(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    Color565 out;
+    out.packed = (uint16_t)((r << 11) | (g << 5) | b);
+    // expanded like the hardware does
+    out.rgb[0] = (float)((r << 3) | (r >> 2));
+    out.rgb[1] = (float)((g << 2) | (g >> 4));
+    out.rgb[2] = (float)((b << 3) | (b >> 2));
+    return out;
+}
+
+// principal axis of n points with dims components through power iteration, false if they are all the same
+bool principalAxis(const float (*points)[4], int n, int dims, float* mean, float* axis) {
+    for (int k = 0; k < dims; k++) {
+        mean[k] = 0;
+        for (int i = 0; i < n; i++) mean[k] += points[i][k];
+        mean[k] /= n;
+    }
+    float cov[4][4] = {};
+    for (int i = 0; i < n; i++) {
+        for (int a = 0; a < dims; a++) {
+            for (int b = a; b < dims; b++) cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+        }
+    }
+    for (int a = 0; a < dims; a++) {
+        for (int b = 0; b < a; b++) cov[a][b] = cov[b][a];
+    }
+    // start from the channel that varies most, it can't be orthogonal to the principal axis
+    int widest = 0;
+    for (int k = 1; k < dims; k++) {
+        if (cov[k][k] > cov[widest][widest]) widest = k;
+    }
+    if (cov[widest][widest] <= 0) return false;
+    float v[4] = {};
+    for (int k = 0; k < dims; k++) v[k] = cov[widest][k];
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float w[4] = {};
+        float length = 0;
+        for (int a = 0; a < dims; a++) {
+            for (int b = 0; b < dims; b++) w[a] += cov[a][b] * v[b];
+            length = std::max(length, std::fabs(w[a]));
+        }
+        if (length == 0) return false;
+        for (int a = 0; a < dims; a++) v[a] = w[a] / length;
+    }
+    float length = 0;
+    for (int k = 0; k < dims; k++) length += v[k] * v[k];
+    length = std::sqrt(length);
+    for (int k = 0; k < dims; k++) axis[k] = v[k] / length;
+    return true;
+}
+
+// endpoints at the extremes of the points projected on their principal axis
+void axisEndpoints(const float (*points)[4], int n, int dims, float* e0, float* e1) {
+    float mean[4], axis[4];
+    if (!principalAxis(points, n, dims, mean, axis)) {
+        for (int k = 0; k < dims; k++) e0[k] = e1[k] = points[0][k];
+        return;
+    }
+    float lo = 0, hi = 0;
+    for (int i = 0; i < n; i++) {
+        float t = 0;
+        for (int k = 0; k < dims; k++) t += (points[i][k] - mean[k]) * axis[k];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    for (int k = 0; k < dims; k++) {
+        e0[k] = mean[k] + axis[k] * hi;
+        e1[k] = mean[k] + axis[k] * lo;
+    }
+}
+
+// endpoints minimizing the squared error for fixed indices, weights[i] is the share of e1 in pixel i's color
+bool leastSquares(const float (*points)[4], const float* weights, int n, int dims, float* e0, float* e1) {
+    float aa = 0, ab = 0, bb = 0;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < n; i++) {
+        float b = weights[i], a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int k = 0; k < dims; k++) {
+            ax[k] += a * points[i][k];
+            bx[k] += b * points[i][k];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f) return false;
+    for (int k = 0; k < dims; k++) {
+        e0[k] = (bb * ax[k] - ab * bx[k]) / det;
+        e1[k] = (aa * bx[k] - ab * ax[k]) / det;
+    }
+    return true;
+}
+
+// 4 color BC1 palette: both endpoints, then 2/3 and 1/3 of the way
+float bc1Indices(const float (*points)[4], const Color565& c0, const Color565& c1, unsigned char* indices) {
+    float palette[4][3];
+    for (int k = 0; k < 3; k++) {
+        palette[0][k] = c0.rgb[k];
+        palette[1][k] = c1.rgb[k];
+        palette[2][k] = (2 * c0.rgb[k] + c1.rgb[k]) / 3;
+        palette[3][k] = (c0.rgb[k] + 2 * c1.rgb[k]) / 3;
+    }
+    float total = 0;
+    for (int i = 0; i < 16; i++) {
+        float best = 1e30f;
+        for (int j = 0; j < 4; j++) {
+            float d = 0;
+            for (int k = 0; k < 3; k++) d += (points[i][k] - palette[j][k]) * (points[i][k] - palette[j][k]);
+            if (d < best) {
+                best = d;
+                indices[i] = (unsigned char)j;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+void encodeBC1(const unsigned char* block, unsigned char* out) {
+    float points[16][4];
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 4; k++) points[i][k] = block[4 * i + k];
+    }
+    float e0[4], e1[4];
+    axisEndpoints(points, 16, 3, e0, e1);
+    Color565 c0 = quantize565(e0), c1 = quantize565(e1);
+    unsigned char indices[16];
+    float error = bc1Indices(points, c0, c1, indices);
+    // refitting to the chosen indices usually beats the extremes, which the quantization pulls apart
+    const float share[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    for (int iteration = 0; iteration < 2 && error > 0; iteration++) {
+        float weights[16];
+        for (int i = 0; i < 16; i++) weights[i] = share[indices[i]];
+        if (!leastSquares(points, weights, 16, 3, e0, e1)) break;
+        Color565 r0 = quantize565(e0), r1 = quantize565(e1);
+        unsigned char refined[16];
+        float refinedError = bc1Indices(points, r0, r1, refined);
+        if (refinedError >= error) break;
+        error = refinedError;
+        c0 = r0;
+        c1 = r1;
+        std::memcpy(indices, refined, 16);
+    }
+    // color0 > color1 selects the 4 color mode, equal endpoints only ever use index 0
+    if (c0.packed < c1.packed) {
+        std::swap(c0, c1);
+        const unsigned char swapped[4] = { 1, 0, 3, 2 };
+        for (int i = 0; i < 16; i++) indices[i] = swapped[indices[i]];
+    }
+    else if (c0.packed == c1.packed) std::memset(indices, 0, 16);
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) bits |= (uint32_t)indices[i] << (2 * i);
+    out[0] = c0.packed & 0xff;
+    out[1] = c0.packed >> 8;
+    out[2] = c1.packed & 0xff;
+    out[3] = c1.packed >> 8;
+    for (int k = 0; k < 4; k++) out[4 + k] = (bits >> (8 * k)) & 0xff;
+}
+
+// channel of a block in the 8 value mode, which BC3 alpha, BC4 and BC5 share
+void encodeBC4(const unsigned char* block, int channel, unsigned char* out) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        lo = std::min(lo, (int)block[4 * i + channel]);
+        hi = std::max(hi, (int)block[4 * i + channel]);
+    }
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+    uint64_t bits = 0;
+    if (hi > lo) {
+        // index 0 and 1 are the endpoints, 2 to 7 step from hi to lo in sevenths
+        int palette[8] = { hi, lo };
+        for (int j = 1; j < 7; j++) palette[j + 1] = ((7 - j) * hi + j * lo + 3) / 7;
+        for (int i = 0; i < 16; i++) {
+            int v = block[4 * i + channel];
+            int best = 0;
+            for (int j = 1; j < 8; j++) {
+                if (std::abs(palette[j] - v) < std::abs(palette[best] - v)) best = j;
+            }
+            bits |= (uint64_t)best << (3 * i);
+        }
+    }
+    for (int k = 0; k < 6; k++) out[2 + k] = (bits >> (8 * k)) & 0xff;
+}
+
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Endpoints {
+    // 7 bit values, the p-bit is appended as their lowest bit
+    int q[2][4];
+    int p[2];
+    int value[2][4];
+};
+
+BC7Endpoints quantizeBC7(const float* e0, const float* e1, int p0, int p1) {
+    BC7Endpoints out;
+    out.p[0] = p0;
+    out.p[1] = p1;
+    for (int k = 0; k < 4; k++) {
+        const float* e[2] = { e0, e1 };
+        for (int j = 0; j < 2; j++) {
+            int q = (int)std::floor((std::min(std::max(e[j][k], 0.0f), 255.0f) - out.p[j]) / 2.0f + 0.5f);
+            out.q[j][k] = std::min(std::max(q, 0), 127);
+            out.value[j][k] = (out.q[j][k] << 1) | out.p[j];
+        }
+    }
+    return out;
+}
+
+float bc7Indices(const float (*points)[4], const BC7Endpoints& e, unsigned char* indices) {
+    float palette[16][4];
+    for (int j = 0; j < 16; j++) {
+        for (int k = 0; k < 4; k++) palette[j][k] = (float)(((64 - BC7_WEIGHTS[j]) * e.value[0][k] + BC7_WEIGHTS[j] * e.value[1][k] + 32) >> 6);
+    }
+    float total = 0;
+    for (int i = 0; i < 16; i++) {
+        float best = 1e30f;
+        for (int j = 0; j < 16; j++) {
+            float d = 0;
+            for (int k = 0; k < 4; k++) d += (points[i][k] - palette[j][k]) * (points[i][k] - palette[j][k]);
+            if (d < best) {
+                best = d;
+                indices[i] = (unsigned char)j;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+// best of the four p-bit combinations
+float bestBC7(const float (*points)[4], const float* e0, const float* e1, BC7Endpoints& endpoints, unsigned char* indices) {
+    float best = 1e30f;
+    for (int p = 0; p < 4; p++) {
+        BC7Endpoints candidate = quantizeBC7(e0, e1, p & 1, p >> 1);
+        unsigned char chosen[16];
+        float error = bc7Indices(points, candidate, chosen);
+        if (error < best) {
+            best = error;
+            endpoints = candidate;
+            std::memcpy(indices, chosen, 16);
+        }
+    }
+    return best;
+}
+
+// mode 6 only: one subset, RGBA endpoints with 7 bits and a p-bit each, 4 bit indices
+void encodeBC7(const unsigned char* block, unsigned char* out) {
+    float points[16][4];
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 4; k++) points[i][k] = block[4 * i + k];
+    }
+    float e0[4], e1[4];
+    axisEndpoints(points, 16, 4, e0, e1);
+    BC7Endpoints endpoints;
+    unsigned char indices[16];
+    float error = bestBC7(points, e0, e1, endpoints, indices);
+    for (int iteration = 0; iteration < 2 && error > 0; iteration++) {
+        float weights[16];
+        for (int i = 0; i < 16; i++) weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+        if (!leastSquares(points, weights, 16, 4, e0, e1)) break;
+        BC7Endpoints refined;
+        unsigned char refinedIndices[16];
+        float refinedError = bestBC7(points, e0, e1, refined, refinedIndices);
+        if (refinedError >= error) break;
+        error = refinedError;
+        endpoints = refined;
+        std::memcpy(indices, refinedIndices, 16);
+    }
+    // the first index drops its top bit, so it has to be below 8
+    if (indices[0] >= 8) {
+        for (int k = 0; k < 4; k++) std::swap(endpoints.q[0][k], endpoints.q[1][k]);
+        std::swap(endpoints.p[0], endpoints.p[1]);
+        for (int i = 0; i < 16; i++) indices[i] = (unsigned char)(15 - indices[i]);
+    }
+    std::memset(out, 0, 16);
+    int at = 0;
+    auto put = [&](uint32_t value, int bits) {
+        for (int b = 0; b < bits; b++, at++) out[at >> 3] |= ((value >> b) & 1) << (at & 7);
+    };
+    put(1 << 6, 7);
+    for (int k = 0; k < 4; k++) {
+        put(endpoints.q[0][k], 7);
+        put(endpoints.q[1][k], 7);
+    }
+    put(endpoints.p[0], 1);
+    put(endpoints.p[1], 1);
+    put(indices[0], 3);
+    for (int i = 1; i < 16; i++) put(indices[i], 4);
+}
+
+void encodeBlock(Block_type format, const unsigned char* block, unsigned char* out) {
+    switch (format) {
+        case Block_type::BC1:
+            encodeBC1(block, out);
+            break;
+        case Block_type::BC3:
+            encodeBC4(block, 3, out);
+            encodeBC1(block, out + 8);
+            break;
+        case Block_type::BC4:
+            encodeBC4(block, 0, out);
+            break;
+        case Block_type::BC5:
+            encodeBC4(block, 0, out);
+            encodeBC4(block, 1, out + 8);
+            break;
+        case Block_type::BC7:
+            encodeBC7(block, out);
+            break;
+    }
+}
+
+std::vector<unsigned char> encodeLevel(const Rgba8Image& image, Block_type format) {
+    int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+    size_t bytes = blockBytes(format);
+    std::vector<unsigned char> out(levelBytes(format, image.width, image.height));
+    ThreadPool::global().parallelFor(blocksY, [&](size_t begin, size_t end, size_t) {
+        unsigned char block[64];
+        for (size_t by = begin; by < end; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                // edge blocks repeat the last row and column
+                for (int y = 0; y < 4; y++) {
+                    int sy = std::min((int)by * 4 + y, image.height - 1);
+                    for (int x = 0; x < 4; x++) {
+                        int sx = std::min(bx * 4 + x, image.width - 1);
+                        std::memcpy(block + 4 * (4 * y + x), &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+                    }
+                }
+                encodeBlock(format, block, out.data() + (by * blocksX + bx) * bytes);
+            }
+        }
+    }, blocksY < 2 * MIN_PARALLEL_BLOCK_ROWS ? 1 : 0);
+    return out;
+}
+
+////////////////////////////
+/// Containers ///
+////////////////////////////
+
+// basic data format descriptor of a block format, one sample per 64 bit half
+std::vector<uint32_t> dataFormatDescriptor(const CompressedImage& image) {
+    const FormatInfo& info = formatInfo(image.format);
+    // channel ids and whether the sample is alpha, which stays linear in sRGB images
+    std::vector<std::pair<uint32_t, bool>> samples;
+    if (image.format == Block_type::BC3) samples = { { 15, true }, { 0, false } };
+    else if (image.format == Block_type::BC5) samples = { { 0, false }, { 1, false } };
+    else samples = { { 0, false } };
+    uint32_t bits = image.format == Block_type::BC7 ? 128 : 64;
+    std::vector<uint32_t> dfd;
+    dfd.push_back(0);
+    dfd.push_back(0);
+    dfd.push_back(2 | ((24 + 16 * (uint32_t)samples.size()) << 16));
+    // BT.709 primaries, sRGB or linear transfer, straight alpha
+    dfd.push_back(info.colorModel | (1 << 8) | ((image.srgb ? 2u : 1u) << 16));
+    dfd.push_back(3 | (3 << 8));
+    dfd.push_back((uint32_t)blockBytes(image.format));
+    dfd.push_back(0);
+    for (size_t i = 0; i < samples.size(); i++) {
+        uint32_t length = bits / (uint32_t)samples.size();
+        uint32_t qualifiers = samples[i].second && image.srgb ? 0x10 : 0;
+        dfd.push_back((uint32_t)(i * length) | ((length - 1) << 16) | ((samples[i].first | qualifiers) << 24));
+        dfd.push_back(0);
+        dfd.push_back(0);
+        dfd.push_back(0xffffffffu);
+    }
+    dfd[0] = (uint32_t)(dfd.size() * 4);
+    return dfd;
+}
+
+void appendKeyValue(std::vector<unsigned char>& kvd, const char* key, const void* value, size_t size) {
+    uint32_t length = (uint32_t)(std::strlen(key) + 1 + size);
+    const unsigned char* l = (const unsigned char*)&length;
+    kvd.insert(kvd.end(), l, l + 4);
+    kvd.insert(kvd.end(), key, key + std::strlen(key) + 1);
+    kvd.insert(kvd.end(), (const unsigned char*)value, (const unsigned char*)value + size);
+    while (kvd.size() % 4) kvd.push_back(0);
+}
+
+bool writeFile(const std::string& path, const std::vector<std::pair<const void*, size_t>>& parts) {
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        std::cout << "ERROR::TEXTURE_COMPRESSION:: can't write " << path << "\n";
+        return false;
+    }
+    bool ok = true;
+    for (const auto& part : parts) ok = ok && std::fwrite(part.first, 1, part.second, f) == part.second;
+    ok = std::fclose(f) == 0 && ok;
+    std::remove(path.c_str());
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cout << "ERROR::TEXTURE_COMPRESSION:: failed writing " << path << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readKTX2(const MappedFile& file, CompressedImage& out, uint64_t* sourceHash) {
+    if (file.size < sizeof(KTX2Header)) return false;
+    KTX2Header h;
+    std::memcpy(&h, file.data, sizeof(h));
+    if (h.supercompressionScheme != 0 || h.pixelDepth > 1 || h.layerCount > 1 || (h.faceCount != 1 && h.faceCount != 6)) return false;
+    if (h.pixelWidth == 0 || h.pixelHeight == 0 || h.pixelWidth > 65536 || h.pixelHeight > 65536) return false;
+    const FormatInfo* info = nullptr;
+    for (const FormatInfo& f : FORMATS) {
+        if (f.vkFormat == h.vkFormat || f.vkFormatSrgb == h.vkFormat) info = &f;
+    }
+    // BC1 with alpha reads the same blocks
+    if (h.vkFormat == 133 || h.vkFormat == 134) info = &FORMATS[0];
+    if (!info) {
+        std::cout << "ERROR::TEXTURE_COMPRESSION:: unsupported KTX2 format " << h.vkFormat << "\n";
+        return false;
+    }
+    out.format = info->format;
+    out.srgb = (hasSrgb(info->format) && h.vkFormat == info->vkFormatSrgb) || h.vkFormat == 134;
+    out.width = h.pixelWidth;
+    out.height = h.pixelHeight;
+    out.faces = h.faceCount;
+    uint32_t levels = std::max(h.levelCount, 1u);
+    if (levels > (uint32_t)levelCount(out.width, out.height)) return false;
+    if (sizeof(KTX2Header) + levels * sizeof(KTX2Level) > file.size) return false;
+    out.levels.assign(levels, {});
+    for (uint32_t l = 0; l < levels; l++) {
+        KTX2Level level;
+        std::memcpy(&level, file.data + sizeof(KTX2Header) + l * sizeof(KTX2Level), sizeof(level));
+        size_t expected = levelBytes(out.format, std::max(out.width >> l, 1), std::max(out.height >> l, 1)) * out.faces;
+        if (level.byteLength != expected || level.byteOffset > file.size || level.byteLength > file.size - level.byteOffset) {
+            out.levels.clear();
+            return false;
+        }
+        out.levels[l].assign(file.data + level.byteOffset, file.data + level.byteOffset + level.byteLength);
+    }
+    if (sourceHash) {
+        *sourceHash = 0;
+        if (h.kvdByteOffset <= file.size && h.kvdByteLength <= file.size - h.kvdByteOffset) {
+            const unsigned char* kvd = file.data + h.kvdByteOffset;
+            size_t at = 0;
+            while (at + 4 <= h.kvdByteLength) {
+                uint32_t length;
+                std::memcpy(&length, kvd + at, 4);
+                if (length > h.kvdByteLength - at - 4) break;
+                const char* key = (const char*)(kvd + at + 4);
+                size_t keyLength = std::find(key, key + length, '\0') - key;
+                if (keyLength == sizeof(SOURCE_HASH_KEY) - 1 && std::memcmp(key, SOURCE_HASH_KEY, keyLength) == 0 && length == keyLength + 1 + 8) {
+                    std::memcpy(sourceHash, key + keyLength + 1, 8);
+                }
+                at += 4 + ((length + 3) & ~3u);
+            }
+        }
+    }
+    return true;
+}
+
+bool readDDS(const MappedFile& file, CompressedImage& out) {
+    if (file.size < 4 + sizeof(DDSHeader)) return false;
+    DDSHeader h;
+    std::memcpy(&h, file.data + 4, sizeof(h));
+    if (h.size != sizeof(DDSHeader) || h.format.size != sizeof(DDSPixelFormat) || !(h.format.flags & 0x4)) return false;
+    if (h.width == 0 || h.height == 0 || h.width > 65536 || h.height > 65536) return false;
+    size_t offset = 4 + sizeof(DDSHeader);
+    bool found = true;
+    out.srgb = false;
+    out.faces = (h.caps2 & 0x200) ? 6 : 1;
+    if (out.faces == 6 && (h.caps2 & 0xfc00) != 0xfc00) return false;
+    if (h.format.fourCC == fourCC("DX10")) {
+        if (file.size < offset + sizeof(DDSHeaderDX10)) return false;
+        DDSHeaderDX10 dx10;
+        std::memcpy(&dx10, file.data + offset, sizeof(dx10));
+        offset += sizeof(dx10);
+        if (dx10.resourceDimension != 3 || dx10.arraySize > 1) return false;
+        if (dx10.miscFlag & 0x4) out.faces = 6;
+        found = false;
+        for (const FormatInfo& f : FORMATS) {
+            if (f.dxgiFormat != dx10.dxgiFormat && f.dxgiFormatSrgb != dx10.dxgiFormat) continue;
+            out.format = f.format;
+            out.srgb = hasSrgb(f.format) && dx10.dxgiFormat == f.dxgiFormatSrgb;
+            found = true;
+        }
+        if (!found) {
+            std::cout << "ERROR::TEXTURE_COMPRESSION:: unsupported DDS format " << dx10.dxgiFormat << "\n";
+            return false;
+        }
+    }
+    else if (h.format.fourCC == fourCC("DXT1")) out.format = Block_type::BC1;
+    else if (h.format.fourCC == fourCC("DXT5")) out.format = Block_type::BC3;
+    else if (h.format.fourCC == fourCC("ATI1") || h.format.fourCC == fourCC("BC4U")) out.format = Block_type::BC4;
+    else if (h.format.fourCC == fourCC("ATI2") || h.format.fourCC == fourCC("BC5U")) out.format = Block_type::BC5;
+    else {
+        std::cout << "ERROR::TEXTURE_COMPRESSION:: unsupported DDS format\n";
+        return false;
+    }
+    out.width = h.width;
+    out.height = h.height;
+    int levels = std::max((int)h.mipMapCount, 1);
+    if (levels > levelCount(out.width, out.height)) return false;
+    size_t chain = 0;
+    for (int l = 0; l < levels; l++) chain += levelBytes(out.format, std::max(out.width >> l, 1), std::max(out.height >> l, 1));
+    if (chain * out.faces > file.size - offset) return false;
+    // DDS stores each face with its chain, the levels here hold all faces
+    out.levels.assign(levels, {});
+    for (int face = 0; face < out.faces; face++) {
+        for (int l = 0; l < levels; l++) {
+            size_t bytes = levelBytes(out.format, std::max(out.width >> l, 1), std::max(out.height >> l, 1));
+            out.levels[l].insert(out.levels[l].end(), file.data + offset, file.data + offset + bytes);
+            offset += bytes;
+        }
+    }
+    return true;
+}
+
+// hash of the source file's contents and everything else that goes into its cache
+bool sourceHash(const std::string& path, bool srgb, uint64_t& hash) {
+    if (!hashFile(path, hash)) return false;
+    uint32_t settings[2] = { COMPRESSED_TEXTURE_VERSION, srgb };
+    hash = hashBytes((const unsigned char*)settings, sizeof(settings), hash);
+    return true;
+}
+
+GLenum internalFormat(const CompressedImage& image) {
+    switch (image.format) {
+        case Block_type::BC1: return image.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case Block_type::BC3: return image.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case Block_type::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case Block_type::BC5: return GL_COMPRESSED_RG_RGTC2;
+        case Block_type::BC7: return image.srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+}
+
+///////////////////////////////////////
+/// CompressedImage Definitions ///
+///////////////////////////////////////
+
+size_t CompressedImage::bytes(void) const {
+    size_t total = 0;
+    for (const std::vector<unsigned char>& level : levels) total += level.size();
+    return total;
+}
+
+size_t blockBytes(Block_type format) {
+    return format == Block_type::BC1 || format == Block_type::BC4 ? 8 : 16;
+}
+
+size_t levelBytes(Block_type format, int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+Block_type defaultBlockFormat(int components, bool highQuality) {
+    if (components == 1) return Block_type::BC4;
+    if (components == 2) return Block_type::BC5;
+    if (highQuality) return Block_type::BC7;
+    return components == 3 ? Block_type::BC1 : Block_type::BC3;
+}
+
+bool compressImage(const ImageData& image, Block_type format, bool srgb, CompressedImage& out, Mip_filter filter) {
+    if (!image.pixels || image.width < 1 || image.height < 1 || image.components < 1 || image.components > 4) return false;
+    out.format = format;
+    // like uploadTexture2D only color images are stored as sRGB
+    out.srgb = srgb && hasSrgb(format) && image.components >= 3;
+    out.width = image.width;
+    out.height = image.height;
+    out.faces = 1;
+    out.levels.clear();
+    // a GPU filter means nothing here, the box is what glGenerateMipmap would have done
+    std::vector<ImageData> mips = buildMipmaps(image, out.srgb, filter == Mip_filter::GPU ? Mip_filter::BOX : filter);
+    out.levels.push_back(encodeLevel(toRgba8(image), format));
+    for (const ImageData& mip : mips) out.levels.push_back(encodeLevel(toRgba8(mip), format));
+    return true;
+}
+
+bool readCompressedImage(const std::string& path, CompressedImage& out, uint64_t* sourceHash) {
+    if (sourceHash) *sourceHash = 0;
+    MappedFile file(path);
+    if (!file.data) return false;
+    bool ok = false;
+    if (file.size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(file.data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) ok = readKTX2(file, out, sourceHash);
+    else if (file.size >= 4 && std::memcmp(file.data, DDS_MAGIC, 4) == 0) ok = readDDS(file, out);
+    if (!ok) out.levels.clear();
+    return ok;
+}
+
+bool writeKTX2(const std::string& path, const CompressedImage& image, uint64_t sourceHash) {
+    if (image.empty()) return false;
+    const FormatInfo& info = formatInfo(image.format);
+    std::vector<uint32_t> dfd = dataFormatDescriptor(image);
+    // keys sorted by their bytes as the format requires
+    std::vector<unsigned char> kvd;
+    appendKeyValue(kvd, WRITER_KEY, WRITER, sizeof(WRITER));
+    if (sourceHash) appendKeyValue(kvd, SOURCE_HASH_KEY, &sourceHash, sizeof(sourceHash));
+
+    KTX2Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = image.srgb ? info.vkFormatSrgb : info.vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = image.width;
+    header.pixelHeight = image.height;
+    header.faceCount = image.faces;
+    header.levelCount = (uint32_t)image.levels.size();
+    header.dfdByteOffset = (uint32_t)(sizeof(KTX2Header) + image.levels.size() * sizeof(KTX2Level));
+    header.dfdByteLength = (uint32_t)(dfd.size() * 4);
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (uint32_t)kvd.size();
+
+    // smallest level first, each aligned to its block size
+    size_t alignment = blockBytes(image.format);
+    size_t end = header.kvdByteOffset + kvd.size();
+    std::vector<KTX2Level> index(image.levels.size());
+    std::vector<std::pair<const void*, size_t>> parts;
+    parts.push_back({ &header, sizeof(header) });
+    parts.push_back({ index.data(), index.size() * sizeof(KTX2Level) });
+    parts.push_back({ dfd.data(), dfd.size() * 4 });
+    parts.push_back({ kvd.data(), kvd.size() });
+    std::vector<unsigned char> padding(alignment, 0);
+    for (size_t l = image.levels.size(); l-- > 0;) {
+        size_t pad = (alignment - end % alignment) % alignment;
+        if (pad) parts.push_back({ padding.data(), pad });
+        end += pad;
+        index[l] = KTX2Level{ end, image.levels[l].size(), image.levels[l].size() };
+        parts.push_back({ image.levels[l].data(), image.levels[l].size() });
+        end += image.levels[l].size();
+    }
+    return writeFile(path, parts);
+}
+
+bool writeDDS(const std::string& path, const CompressedImage& image) {
+    if (image.empty()) return false;
+    const FormatInfo& info = formatInfo(image.format);
+    DDSHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.size = sizeof(DDSHeader);
+    // caps, height, width, pixel format, mip map count and linear size are set
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+    header.height = image.height;
+    header.width = image.width;
+    header.pitchOrLinearSize = (uint32_t)levelBytes(image.format, image.width, image.height);
+    header.mipMapCount = (uint32_t)image.levels.size();
+    header.format.size = sizeof(DDSPixelFormat);
+    header.format.flags = 0x4;
+    header.format.fourCC = fourCC("DX10");
+    header.caps = 0x1000 | (image.levels.size() > 1 ? 0x400008 : 0);
+    if (image.faces == 6) {
+        header.caps |= 0x8;
+        header.caps2 = 0x200 | 0xfc00;
+    }
+    DDSHeaderDX10 dx10{ image.srgb ? info.dxgiFormatSrgb : info.dxgiFormat, 3, image.faces == 6 ? 0x4u : 0u, 1, 0 };
+
+    std::vector<std::pair<const void*, size_t>> parts;
+    parts.push_back({ DDS_MAGIC, 4 });
+    parts.push_back({ &header, sizeof(header) });
+    parts.push_back({ &dx10, sizeof(dx10) });
+    for (int face = 0; face < image.faces; face++) {
+        for (const std::vector<unsigned char>& level : image.levels) {
+            size_t bytes = level.size() / image.faces;
+            parts.push_back({ level.data() + face * bytes, bytes });
+        }
+    }
+    return writeFile(path, parts);
+}
+
+bool isCompressedTextureFile(const std::string& path) {
+    return endsWith(path, ".ktx2") || endsWith(path, ".dds");
+}
+
+bool compressTextureFile(const std::string& source, const std::string& destination, Block_type format, bool srgb, Mip_filter filter) {
+    ImageData image(source);
+    if (!image.pixels) {
+        std::cout << "ERROR::TEXTURE_COMPRESSION:: can't read " << source << "\n";
+        return false;
+    }
+    CompressedImage compressed;
+    if (!compressImage(image, format, srgb, compressed, filter)) return false;
+    if (endsWith(destination, ".dds")) return writeDDS(destination, compressed);
+    // with the source hash the file also serves as the cache loadCompressedTexture looks for
+    uint64_t hash = 0;
+    sourceHash(source, srgb, hash);
+    return writeKTX2(destination, compressed, hash);
+}
+
+bool loadCompressedTexture(const std::string& path, bool srgb, CompressedImage& out, bool normalMap) {
+    if (isCompressedTextureFile(path)) return readCompressedImage(path, out);
+    uint64_t hash;
+    if (!sourceHash(path, srgb, hash)) return false;
+    std::string cachePath = path + (normalMap ? COMPRESSED_TEXTURE_NORMAL_EXTENSION : srgb ? COMPRESSED_TEXTURE_SRGB_EXTENSION : COMPRESSED_TEXTURE_EXTENSION);
+    uint64_t cachedHash;
+    if (readCompressedImage(cachePath, out, &cachedHash) && cachedHash == hash) return true;
+
+    ImageData image(path);
+    // one channel images have no y to keep
+    Block_type format = normalMap && image.components > 1 ? Block_type::BC5 : defaultBlockFormat(image.components);
+    if (!compressImage(image, format, srgb, out)) return false;
+    // a cache that can't be written only costs the next launch the encode again
+    writeKTX2(cachePath, out, hash);
+    return true;
+}
+
+bool compressedFormatSupported(Block_type format) {
+    // RGTC is core since 3.0
+    if (format == Block_type::BC4 || format == Block_type::BC5) return true;
+    static int s3tc = -1, bptc = -1;
+    if (s3tc < 0) {
+        s3tc = bptc = 0;
+        GLint major = 0, minor = 0, n = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 2)) bptc = 1;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+        for (GLint i = 0; i < n; i++) {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (!name) continue;
+            if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) s3tc = 1;
+            else if (std::strcmp(name, "GL_ARB_texture_compression_bptc") == 0) bptc = 1;
+        }
+    }
+    return format == Block_type::BC7 ? bptc == 1 : s3tc == 1;
+}
+
+bool uploadCompressedLevels(unsigned int target, const CompressedImage& image, int face) {
+    if (!compressedFormatSupported(image.format)) {
+        std::cout << "ERROR::TEXTURE_COMPRESSION:: the context can't sample this block format\n";
+        return false;
+    }
+    GLenum format = internalFormat(image);
+    for (size_t l = 0; l < image.levels.size(); l++) {
+        int width = std::max(image.width >> l, 1), height = std::max(image.height >> l, 1);
+        size_t bytes = image.levels[l].size() / image.faces;
+        glCompressedTexImage2D(target, (GLint)l, format, width, height, 0, (GLsizei)bytes, image.levels[l].data() + face * bytes);
+    }
+    return true;
+}
+
+unsigned int uploadCompressedTexture2D(const CompressedImage& image) {
+    if (image.empty() || image.faces != 1) return 0;
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (!uploadCompressedLevels(GL_TEXTURE_2D, image, 0)) {
+        glDeleteTextures(1, &textureID);
+        return 0;
+    }
+    // files from other tools may come with a partial chain
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
@@ -0,0 +1,83 @@
+#ifndef TEXTURE_COMPRESSION_HH
+#define TEXTURE_COMPRESSION_HH
+
+#include "MipmapGeneration.h"
+#include "Texture.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Block compressed textures. Images are encoded on the CPU with a mip chain from generateMipmaps and stored in KTX2 or DDS
+// containers, which are uploaded with glCompressedTexImage2D without decoding. Blocks are 4x4 pixels in upload row
+// order like uploadTexture2D, which for files is the top row first (see ImageData), so an image and its compressed
+// copy upload the same. Sizes that aren't a multiple of 4 repeat their last row and column.
+
+// cache of a plain image next to it, the sRGB variant gets its own file
+#define COMPRESSED_TEXTURE_EXTENSION ".ktx2"
+#define COMPRESSED_TEXTURE_SRGB_EXTENSION ".srgb.ktx2"
+#define COMPRESSED_TEXTURE_NORMAL_EXTENSION ".normal.ktx2"
+// mixed into the source hash, bump when the encoders change their output
+#define COMPRESSED_TEXTURE_VERSION 3
+
+enum class Block_type {
+    // RGB, 8 bytes per block
+    BC1,
+    // RGBA, BC4 alpha and BC1 color, 16 bytes
+    BC3,
+    // one channel, 8 bytes
+    BC4,
+    // two channels, two BC4 blocks, 16 bytes. reads like a GL_RG texture
+    BC5,
+    // RGBA in the quality of BC3's color for all four channels, 16 bytes. Slow to encode, for offline use
+    BC7
+};
+
+struct CompressedImage {
+    Block_type format;
+    bool srgb;
+    int width, height;
+    // 1 for 2D textures, 6 for cube maps in GL face order
+    int faces;
+    // mip levels largest first, each holds its faces one after another
+    std::vector<std::vector<unsigned char>> levels;
+
+    CompressedImage(void) : format{ Block_type::BC1 }, srgb{ false }, width{ 0 }, height{ 0 }, faces{ 1 } {}
+    bool empty(void) const { return levels.empty(); }
+    // all levels and faces, what the upload sends to the GPU
+    size_t bytes(void) const;
+};
+
+size_t blockBytes(Block_type format);
+// one face of a level
+size_t levelBytes(Block_type format, int width, int height);
+// BC4 and BC5 for one and two channels, BC1 for RGB and BC3 for RGBA, BC7 instead of both if quality matters more than time
+Block_type defaultBlockFormat(int components, bool highQuality = false);
+
+// encodes image and its mip chain down to 1x1, block rows in parallel on the global ThreadPool.
+// sRGB images are filtered in linear space. false if the image is empty
+bool compressImage(const ImageData& image, Block_type format, bool srgb, CompressedImage& out, Mip_filter filter = Mip_filter::KAISER);
+
+// reads either container, picked by the file's magic. sourceHash is set from KTX2 files written by writeKTX2, 0 otherwise
+bool readCompressedImage(const std::string& path, CompressedImage& out, uint64_t* sourceHash = nullptr);
+// both go through a temporary file like the model cache
+bool writeKTX2(const std::string& path, const CompressedImage& image, uint64_t sourceHash = 0);
+bool writeDDS(const std::string& path, const CompressedImage& image);
+// .ktx2 and .dds files
+bool isCompressedTextureFile(const std::string& path);
+
+// the offline tool: decodes source, compresses it and writes destination, as DDS if it ends in .dds and KTX2 otherwise
+bool compressTextureFile(const std::string& source, const std::string& destination, Block_type format, bool srgb, Mip_filter filter = Mip_filter::KAISER);
+// cache on first load: containers are read as they are, other images come from the cache next to them, or are decoded,
+// compressed with defaultBlockFormat and cached. Normal maps keep only x and y in BC5, BC1 bands them, so shaders
+// sampling them rebuild z. Needs no GL, so loaders can call it off the GL thread
+bool loadCompressedTexture(const std::string& path, bool srgb, CompressedImage& out, bool normalMap = false);
+
+// whether the context can sample the format, BC1 and BC3 need S3TC and BC7 needs BPTC. Needs the GL context
+bool compressedFormatSupported(Block_type format);
+// a repeating, trilinear 2D texture like uploadTexture2D, 0 if the image is empty, a cube map or not supported
+unsigned int uploadCompressedTexture2D(const CompressedImage& image);
+// uploads every level of one face into target of the bound texture, false if the format isn't supported
+bool uploadCompressedLevels(unsigned int target, const CompressedImage& image, int face);
+
+#endif
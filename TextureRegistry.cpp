@@ -0,0 +1,199 @@
+#include "TextureRegistry.h"
+#include "Texture.h"
+#include "MipmapGeneration.h"
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+
+#include <filesystem>
+#include <iostream>
+
+namespace {
+
+// contexts without S3TC or BPTC get the file decoded instead of losing the texture, containers have nothing to decode
+unsigned int uploadCompressedOrDecoded(const std::string& path, const CompressedImage& image, bool srgb, Mip_filter filter) {
+    if (isCompressedTextureFile(path) || compressedFormatSupported(image.format)) return uploadCompressedTexture2D(image);
+    ImageData decoded(path);
+    generateMipmaps(decoded, srgb, filter);
+    return uploadTexture2D(decoded, srgb);
+}
+
+}
+
+std::string TextureRegistry::canonicalPath(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if (error) return std::filesystem::path(path).lexically_normal().generic_string();
+    return canonical.generic_string();
+}
+
+unsigned int TextureRegistry::acquire(const std::string& path, bool srgb) {
+    return acquire(std::vector<std::string>{ path }, srgb)[0];
+}
+
+std::vector<unsigned int> TextureRegistry::acquire(const std::vector<std::string>& paths, bool srgb) {
+    std::vector<unsigned int> ids(paths.size(), 0);
+    std::vector<TextureKey> misses;
+    // position in misses of every path that wasn't resident
+    std::vector<size_t> missIndex(paths.size(), (size_t)-1);
+    bool compressMisses;
+    Mip_filter filter;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        compressMisses = compress;
+        filter = mipFilter;
+        std::unordered_map<TextureKey, size_t, TextureKeyHash> pending;
+        for (size_t i = 0; i < paths.size(); i++) {
+            TextureKey key{ canonicalPath(paths[i]), srgb };
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                it->second.references++;
+                ids[i] = it->second.texture;
+                continue;
+            }
+            // a file listed twice is still only loaded once
+            auto p = pending.find(key);
+            if (p == pending.end()) {
+                p = pending.emplace(key, misses.size()).first;
+                misses.push_back(key);
+            }
+            missIndex[i] = p->second;
+        }
+    }
+    if (misses.empty()) return ids;
+
+    std::vector<ImageData> images(misses.size());
+    std::vector<CompressedImage> compressed(misses.size());
+    ThreadPool::global().parallelFor(misses.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) {
+            const std::string& path = misses[i].path;
+            if ((compressMisses || isCompressedTextureFile(path)) && loadCompressedTexture(path, srgb, compressed[i])) continue;
+            images[i] = ImageData(path);
+            generateMipmaps(images[i], srgb, filter);
+        }
+    }, misses.size());
+
+    std::vector<unsigned int> loaded(misses.size());
+    for (size_t i = 0; i < misses.size(); i++) {
+        loaded[i] = compressed[i].empty() ? uploadTexture2D(images[i], srgb) : uploadCompressedOrDecoded(misses[i].path, compressed[i], srgb, filter);
+        if (!loaded[i]) std::cout << "Texture failed to load at path: " << misses[i].path << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (missIndex[i] == (size_t)-1) continue;
+        const TextureKey& key = misses[missIndex[i]];
+        unsigned int id = loaded[missIndex[i]];
+        if (!id) continue;
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            it = entries.emplace(key, Entry{ GLTexture(id), 0 }).first;
+            keys.emplace(id, key);
+        }
+        else if (it->second.texture != id) {
+            // registered by someone else while we were decoding, keep theirs
+            GLTexture duplicate(id);
+            loaded[missIndex[i]] = it->second.texture;
+        }
+        it->second.references++;
+        ids[i] = it->second.texture;
+    }
+    return ids;
+}
+
+unsigned int TextureRegistry::acquire(const std::string& path, const ImageData& image, bool srgb) {
+    TextureKey key{ canonicalPath(path), srgb };
+    unsigned int id = acquireResident(path, srgb);
+    if (id) return id;
+    id = uploadTexture2D(image, srgb);
+    if (!id) {
+        std::cout << "Texture failed to load at path: " << key.path << "\n";
+        return 0;
+    }
+    return insert(key, id);
+}
+
+unsigned int TextureRegistry::acquire(const std::string& path, const CompressedImage& image, bool srgb) {
+    TextureKey key{ canonicalPath(path), srgb };
+    unsigned int id = acquireResident(path, srgb);
+    if (id) return id;
+    Mip_filter filter;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        filter = mipFilter;
+    }
+    id = uploadCompressedOrDecoded(path, image, srgb, filter);
+    if (!id) {
+        std::cout << "Texture failed to load at path: " << key.path << "\n";
+        return 0;
+    }
+    return insert(key, id);
+}
+
+unsigned int TextureRegistry::insert(const TextureKey& key, unsigned int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        it = entries.emplace(key, Entry{ GLTexture(id), 0 }).first;
+        keys.emplace(id, key);
+    }
+    else {
+        // registered by someone else while we were uploading, keep theirs
+        GLTexture duplicate(id);
+    }
+    it->second.references++;
+    return it->second.texture;
+}
+
+unsigned int TextureRegistry::acquireResident(const std::string& path, bool srgb) {
+    TextureKey key{ canonicalPath(path), srgb };
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) return 0;
+    it->second.references++;
+    return it->second.texture;
+}
+
+void TextureRegistry::release(unsigned int id) {
+    if (!id) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto k = keys.find(id);
+    if (k == keys.end()) return;
+    auto it = entries.find(k->second);
+    if (--it->second.references > 0) return;
+    // the handle deletes the texture
+    entries.erase(it);
+    keys.erase(k);
+}
+
+void TextureRegistry::shutdown(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    keys.clear();
+}
+
+size_t TextureRegistry::references(unsigned int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto k = keys.find(id);
+    if (k == keys.end()) return 0;
+    return entries.find(k->second)->second.references;
+}
+
+size_t TextureRegistry::size(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+void TextureRegistry::setCompression(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    compress = enabled;
+}
+
+void TextureRegistry::setMipFilter(Mip_filter filter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    mipFilter = filter;
+}
+
+TextureRegistry& TextureRegistry::global(void) {
+    static TextureRegistry registry;
+    return registry;
+}
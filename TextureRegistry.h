@@ -0,0 +1,79 @@
+#ifndef TEXTURE_REGISTRY_HH
+#define TEXTURE_REGISTRY_HH
+
+#include "GLHandle.h"
+#include "MipmapGeneration.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ImageData;
+struct CompressedImage;
+
+// what makes two loads of a file the same texture
+struct TextureKey {
+    // canonical path, so different spellings of one file share an entry
+    std::string path;
+    // stored as sRGB, see Model::srgb
+    bool srgb;
+
+    bool operator==(const TextureKey& other) const { return srgb == other.srgb && path == other.path; }
+};
+
+struct TextureKeyHash {
+    size_t operator()(const TextureKey& key) const { return std::hash<std::string>()(key.path) ^ (size_t)key.srgb; }
+};
+
+// Process wide, reference counted set of resident 2D textures, so a file used by several models
+// is decoded and uploaded once. acquire and release have to be called with the GL context current,
+// acquireResident can be called from any thread.
+class TextureRegistry {
+public:
+    // texture id for the file, loaded if it isn't resident yet, 0 if it can't be loaded.
+    // every successful acquire has to be matched by one release.
+    unsigned int acquire(const std::string& path, bool srgb = false);
+    // same for several files at once, missing ones are decoded in parallel on the thread pool
+    std::vector<unsigned int> acquire(const std::vector<std::string>& paths, bool srgb = false);
+    // same for an image decoded by the caller, if the file became resident in the meantime that copy is used
+    unsigned int acquire(const std::string& path, const ImageData& image, bool srgb = false);
+    // a compressed copy of a plain image whose format the context can't sample is replaced by the decoded file
+    unsigned int acquire(const std::string& path, const CompressedImage& image, bool srgb = false);
+    // reference to the texture if the file is resident, 0 otherwise. Needs no GL, so background loaders can
+    // find out which images they have to decode
+    unsigned int acquireResident(const std::string& path, bool srgb = false);
+    // drops one reference, the texture is deleted with the last one. unknown ids and 0 are ignored
+    void release(unsigned int id);
+    // deletes every texture still registered, whatever its references. Call it before the GL context goes away,
+    // the static registry is destroyed after that. Later releases of the old ids are ignored
+    void shutdown(void);
+
+    // references held on id, 0 if it isn't registered
+    size_t references(unsigned int id);
+    size_t size(void);
+    // block compress files loaded from now on through loadCompressedTexture, KTX2 and DDS files are always read as they are
+    void setCompression(bool enabled);
+    // filter of the mip chains built for files decoded from now on, GPU (the default) leaves them to glGenerateMipmap.
+    // Callers that pass in their own ImageData build its mips themselves
+    void setMipFilter(Mip_filter filter);
+
+    static std::string canonicalPath(const std::string& path);
+    static TextureRegistry& global(void);
+
+private:
+    struct Entry {
+        GLTexture texture;
+        size_t references;
+    };
+    std::unordered_map<TextureKey, Entry, TextureKeyHash> entries;
+    std::unordered_map<unsigned int, TextureKey> keys;
+    bool compress = false;
+    Mip_filter mipFilter = Mip_filter::GPU;
+    std::mutex mutex;
+
+    // takes over id, a texture uploaded by the caller, unless someone registered the file in the meantime
+    unsigned int insert(const TextureKey& key, unsigned int id);
+};
+
+#endif
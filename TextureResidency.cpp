@@ -0,0 +1,401 @@
+#include "TextureResidency.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    // GL 4.3 or ARB_copy_image, with a loader that was generated with them
+    bool copyImageSupported(void) {
+#if defined(GL_VERSION_4_3)
+        if (GLAD_GL_VERSION_4_3) return true;
+#endif
+#if defined(GL_ARB_copy_image)
+        if (GLAD_GL_ARB_copy_image) return true;
+#endif
+        return false;
+    }
+
+    // the top n levels go, the next one becomes the base
+    void dropLevels(ImageData& image, int n) {
+        if (n <= 0 || (size_t)n > image.mips.size()) return;
+        std::vector<ImageData> rest(std::make_move_iterator(image.mips.begin() + n), std::make_move_iterator(image.mips.end()));
+        ImageData base = std::move(image.mips[n - 1]);
+        base.mips = std::move(rest);
+        image = std::move(base);
+    }
+
+    void dropLevels(CompressedImage& image, int n) {
+        if (n <= 0 || (size_t)n >= image.levels.size()) return;
+        image.levels.erase(image.levels.begin(), image.levels.begin() + n);
+        image.width = std::max(image.width >> n, 1);
+        image.height = std::max(image.height >> n, 1);
+    }
+
+    size_t imageBytes(const ImageData& image) {
+        size_t bytes = (size_t)image.width * image.height * image.components;
+        for (const ImageData& mip : image.mips) bytes += (size_t)mip.width * mip.height * mip.components;
+        return bytes;
+    }
+
+    // repeating and trilinear like uploadTexture2D, on the bound 2D texture
+    void setSampling(int levels) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+}
+
+////////////////////////////
+/// ResidentTexture Definitions ///
+////////////////////////////
+
+ResidentTexture::ResidentTexture(void) :
+    width{ 0 }, height{ 0 }, levels{ 0 }, level{ 0 }, ready{ false }, failed{ false },
+    srgb{ false }, compressed{ false }, format{ Block_type::BC1 }, filter{ Mip_filter::KAISER }, components{ 0 },
+    coarse{ 0 }, used{ 0 }, wanted{ 0 }, loading{ false }
+{
+    // 1x1 mid grey like StreamedTexture's placeholder
+    ID = GLTexture::create();
+    unsigned char grey[4] = { 128, 128, 128, 255 };
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    setSampling(1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void ResidentTexture::bind(unsigned int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, ID);
+}
+
+size_t ResidentTexture::bytesFrom(int first) const {
+    size_t bytes = 0;
+    for (int l = std::max(first, 0); l < levels; l++) {
+        int w = std::max(width >> l, 1), h = std::max(height >> l, 1);
+        bytes += compressed ? levelBytes(format, w, h) : (size_t)w * h * (components == 3 ? 4 : components);
+    }
+    return bytes;
+}
+
+////////////////////////////
+/// TextureResidency Definitions ///
+////////////////////////////
+
+TextureResidency::TextureResidency(size_t memoryBytes, size_t bytesPerFrame, double msPerFrame) :
+    memoryBudget{ memoryBytes },
+    byteBudget{ bytesPerFrame },
+    timeBudget{ msPerFrame },
+    coarseSize{ 64 },
+    mipFilter{ Mip_filter::KAISER },
+    resident{ 0 },
+    frame{ 1 },
+    stopping{ false }
+{
+    // reads one file at a time, a separate thread for the same reason as ModelStreamer's loader
+    loader = std::thread([this] {
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queued.empty(); });
+                if (stopping) return;
+                // stays queued while it decodes, so pending counts it
+                job = queued.front();
+            }
+            // the list and the job are all that hold the texture anymore, skip the work
+            if (job->texture.use_count() > 2) decode(*job);
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.pop_front();
+            decoded.push_back(job);
+        }
+    });
+}
+
+TextureResidency::~TextureResidency(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    loader.join();
+}
+
+std::shared_ptr<ResidentTexture> TextureResidency::load(const std::string& path, bool srgb) {
+    std::shared_ptr<ResidentTexture> texture = std::make_shared<ResidentTexture>();
+    texture->path = path;
+    texture->srgb = srgb;
+    texture->filter = mipFilter;
+    textures.push_back(texture);
+    queue(texture, -1);
+    return texture;
+}
+
+void TextureResidency::request(ResidentTexture& texture, float texelsPerPixel) {
+    int level = texelsPerPixel > 1.0f ? (int)std::floor(std::log2(texelsPerPixel)) : 0;
+    if (texture.used != frame) {
+        texture.used = frame;
+        texture.wanted = level;
+    }
+    else texture.wanted = std::min(texture.wanted, level);
+}
+
+size_t TextureResidency::pending(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queued.size() + decoded.size() + uploading.size();
+}
+
+void TextureResidency::queue(const std::shared_ptr<ResidentTexture>& texture, int level) {
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->texture = texture;
+    job->path = texture->path;
+    job->srgb = texture->srgb;
+    job->filter = texture->filter;
+    job->level = level;
+    job->coarseSize = coarseSize;
+    job->width = job->height = job->levels = job->components = 0;
+    job->loaded = false;
+    texture->loading = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(job);
+    }
+    wake.notify_one();
+}
+
+void TextureResidency::decode(Job& job) {
+    if (isCompressedTextureFile(job.path)) {
+        CompressedImage& image = job.compressed;
+        if (!readCompressedImage(job.path, image) || image.faces != 1) {
+            image = CompressedImage();
+            return;
+        }
+        job.width = image.width;
+        job.height = image.height;
+        job.levels = (int)image.levels.size();
+    }
+    else {
+        ImageData& image = job.image;
+        image = ImageData(job.path);
+        if (!image.pixels) return;
+        // the finer levels can't be left to glGenerateMipmap, they aren't on the GPU
+        generateMipmaps(image, job.srgb, job.filter == Mip_filter::GPU ? Mip_filter::BOX : job.filter);
+        if (image.mips.empty() && (image.width > 1 || image.height > 1)) {
+            image = ImageData();
+            return;
+        }
+        job.width = image.width;
+        job.height = image.height;
+        job.levels = 1 + (int)image.mips.size();
+        job.components = image.components;
+    }
+    // a first load takes the largest level that is no larger than coarseSize
+    if (job.level < 0) {
+        job.level = 0;
+        while (job.level < job.levels - 1 && std::max(job.width >> job.level, job.height >> job.level) > job.coarseSize) job.level++;
+    }
+    job.level = std::min(job.level, job.levels - 1);
+    dropLevels(job.image, job.level);
+    dropLevels(job.compressed, job.level);
+    job.loaded = true;
+}
+
+int TextureResidency::floorLevel(const ResidentTexture& texture) const {
+    // in view it keeps what it asked for, otherwise only the coarse levels
+    return texture.used == frame ? std::min(texture.wanted, texture.coarse) : texture.coarse;
+}
+
+size_t TextureResidency::evictable(const ResidentTexture* keep) const {
+    size_t bytes = 0;
+    for (const std::shared_ptr<ResidentTexture>& texture : textures) {
+        if (texture.get() == keep || !texture->ready) continue;
+        int floor = floorLevel(*texture);
+        if (texture->level < floor) bytes += texture->bytesFrom(texture->level) - texture->bytesFrom(floor);
+    }
+    return bytes;
+}
+
+void TextureResidency::makeRoom(size_t bytes, const ResidentTexture* keep) {
+    if (resident + bytes <= memoryBudget) return;
+    size_t excess = resident + bytes - memoryBudget, freed = 0;
+    // a texture growing only takes what textures in view don't need. Over the budget itself, they go down to their
+    // coarse levels too, after everything else
+    for (int pass = 0; pass < (keep ? 1 : 2) && freed < excess; pass++) {
+        std::vector<ResidentTexture*> candidates;
+        for (const std::shared_ptr<ResidentTexture>& texture : textures) {
+            int floor = pass == 0 ? floorLevel(*texture) : texture->coarse;
+            if (texture.get() != keep && texture->ready && texture->level < floor) candidates.push_back(texture.get());
+        }
+        // least recently requested first, textures in view come last
+        std::sort(candidates.begin(), candidates.end(), [](const ResidentTexture* a, const ResidentTexture* b) { return a->used < b->used; });
+        for (ResidentTexture* texture : candidates) {
+            if (freed >= excess) break;
+            int floor = pass == 0 ? floorLevel(*texture) : texture->coarse, first = texture->level;
+            size_t held = texture->bytesFrom(first);
+            // finest levels first, only as many as it takes
+            while (first < floor && freed + held - texture->bytesFrom(first) < excess) first++;
+            freed += held - texture->bytesFrom(first);
+            evict(*texture, first);
+        }
+    }
+}
+
+void TextureResidency::evict(ResidentTexture& texture, int first) {
+    if (first <= texture.level) return;
+    // levels of ID to skip and keep
+    int skip = first - texture.level, count = texture.levels - first;
+    bool copy = copyImageSupported();
+    unsigned int format = GL_RGBA, internalFormat = GL_RGBA;
+    if (texture.compressed) {
+        GLint queried = 0;
+        glBindTexture(GL_TEXTURE_2D, texture.ID);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, skip, GL_TEXTURE_INTERNAL_FORMAT, &queried);
+        internalFormat = (unsigned int)queried;
+    }
+    else imageFormat(texture.components, texture.srgb, format, internalFormat);
+
+    GLTexture smaller = GLTexture::create();
+    std::vector<unsigned char> pixels;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int l = 0; l < count; l++) {
+        int width = std::max(texture.width >> (first + l), 1), height = std::max(texture.height >> (first + l), 1);
+        GLint bytes = width * height * texture.components;
+        glBindTexture(GL_TEXTURE_2D, texture.ID);
+        if (texture.compressed) glGetTexLevelParameteriv(GL_TEXTURE_2D, skip + l, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+        // without copy_image the levels take a round trip through client memory, which waits for the GPU
+        if (!copy) {
+            pixels.resize(bytes);
+            if (texture.compressed) glGetCompressedTexImage(GL_TEXTURE_2D, skip + l, pixels.data());
+            else glGetTexImage(GL_TEXTURE_2D, skip + l, format, GL_UNSIGNED_BYTE, pixels.data());
+        }
+        const void* data = copy ? nullptr : pixels.data();
+        glBindTexture(GL_TEXTURE_2D, smaller);
+        if (texture.compressed) glCompressedTexImage2D(GL_TEXTURE_2D, l, internalFormat, width, height, 0, bytes, data);
+        else glTexImage2D(GL_TEXTURE_2D, l, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+#if defined(GL_VERSION_4_3) || defined(GL_ARB_copy_image)
+        if (copy) glCopyImageSubData(texture.ID, GL_TEXTURE_2D, skip + l, 0, 0, 0, smaller, GL_TEXTURE_2D, l, 0, 0, 0, width, height, 1);
+#endif
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    setSampling(count);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    resident -= texture.bytesFrom(texture.level) - texture.bytesFrom(first);
+    texture.ID = std::move(smaller);
+    texture.level = first;
+}
+
+bool TextureResidency::upload(Job& job) {
+    ResidentTexture& texture = *job.texture;
+    if (!job.loaded) return false;
+    int target = job.level;
+    if (texture.levels == 0) {
+        texture.width = job.width;
+        texture.height = job.height;
+        texture.levels = job.levels;
+        texture.components = job.components;
+        texture.compressed = !job.compressed.empty();
+        texture.format = job.compressed.format;
+        texture.coarse = job.level;
+        // nothing resident yet
+        texture.level = texture.levels;
+        // the coarse levels come in whatever the budget says
+        makeRoom(texture.bytesFrom(target), &texture);
+    }
+    else {
+        // the file changed since the first load
+        if (job.width != texture.width || job.height != texture.height || job.levels != texture.levels) return false;
+        // levels that stopped being asked for while the file was read aren't worth taking room from others
+        target = std::max(target, floorLevel(texture));
+        size_t room = (memoryBudget > resident ? memoryBudget - resident : 0) + evictable(&texture);
+        while (target < texture.level && texture.bytesFrom(target) - texture.bytesFrom(texture.level) > room) target++;
+        if (target >= texture.level) return true;
+        makeRoom(texture.bytesFrom(target) - texture.bytesFrom(texture.level), &texture);
+    }
+
+    dropLevels(job.image, target - job.level);
+    dropLevels(job.compressed, target - job.level);
+    unsigned int id = texture.compressed ? uploadCompressedTexture2D(job.compressed) : uploadTexture2D(job.image, job.srgb);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (!id) return false;
+    resident += texture.bytesFrom(target) - texture.bytesFrom(texture.level);
+    texture.ID = GLTexture(id);
+    texture.level = target;
+    texture.ready = true;
+    return true;
+}
+
+void TextureResidency::update(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!decoded.empty()) {
+            uploading.push_back(decoded.front());
+            decoded.pop_front();
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    bool first = true;
+    while (!uploading.empty()) {
+        Job& job = *uploading.front();
+        // abandoned ones are dropped with their pixels
+        if (job.texture.use_count() > 2) {
+            size_t next = job.compressed.empty() ? imageBytes(job.image) : job.compressed.bytes();
+            // stop before a job that would overshoot the budget, unless nothing went through yet
+            if (!first) {
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (timeBudget > 0 && ms >= timeBudget) break;
+                if (byteBudget > 0 && bytes + next > byteBudget) break;
+            }
+            first = false;
+            bytes += next;
+            if (!upload(job)) {
+                std::cout << "ERROR::TEXTURE_RESIDENCY:: failed to load " << job.path << std::endl;
+                job.texture->failed = true;
+            }
+        }
+        job.texture->loading = false;
+        uploading.pop_front();
+    }
+
+    // textures only the list holds anymore give their memory back
+    for (size_t i = 0; i < textures.size();) {
+        if (textures[i].use_count() == 1 && !textures[i]->loading) {
+            resident -= textures[i]->bytesFrom(textures[i]->level);
+            textures[i] = std::move(textures.back());
+            textures.pop_back();
+        }
+        else i++;
+    }
+
+    // the budget may have shrunk
+    makeRoom(0, nullptr);
+
+    // finer levels for the textures in view, the blurriest first, as far as they fit
+    std::vector<std::shared_ptr<ResidentTexture>> wanting;
+    for (const std::shared_ptr<ResidentTexture>& texture : textures) {
+        if (texture->ready && !texture->failed && !texture->loading && texture->used == frame && texture->wanted < texture->level) wanting.push_back(texture);
+    }
+    std::sort(wanting.begin(), wanting.end(), [](const std::shared_ptr<ResidentTexture>& a, const std::shared_ptr<ResidentTexture>& b) {
+        return a->level - a->wanted > b->level - b->wanted;
+    });
+    size_t room = (memoryBudget > resident ? memoryBudget - resident : 0) + evictable(nullptr);
+    for (const std::shared_ptr<ResidentTexture>& texture : wanting) {
+        int target = texture->wanted;
+        size_t held = texture->bytesFrom(texture->level);
+        while (target < texture->level && texture->bytesFrom(target) - held > room) target++;
+        if (target >= texture->level) continue;
+        room -= texture->bytesFrom(target) - held;
+        queue(texture, target);
+    }
+    frame++;
+}
@@ -0,0 +1,146 @@
+#ifndef TEXTURE_RESIDENCY_HH
+#define TEXTURE_RESIDENCY_HH
+
+#include "GLHandle.h"
+#include "MipmapGeneration.h"
+#include "Texture.h"
+#include "TextureCompression.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a 2D texture whose finest mip levels come and go with TextureResidency. ID always holds the levels that are
+// resident, the finest of them as its level 0, so sampling with the same coordinates just gets blurrier or sharper.
+// The name changes when levels are added or dropped, bind through the texture every frame instead of keeping ID
+class ResidentTexture {
+public:
+    GLTexture ID;
+    // size of the file's level 0 and the length of its chain, 0 until the coarse levels arrive
+    int width, height, levels;
+    // finest level of the file that is resident, levels while ID is still the grey placeholder
+    int level;
+    // set by update once the coarse levels are in. A failed load keeps the placeholder
+    bool ready, failed;
+
+    ResidentTexture(void);
+    void bind(unsigned int unit = 0) const;
+    // bytes of the file's levels from first down, what the GPU holds with first resident.
+    // RGB counts as RGBA, which is how drivers store it
+    size_t bytesFrom(int first) const;
+
+private:
+    friend class TextureResidency;
+    std::string path;
+    bool srgb;
+    // containers keep their blocks, format is only meaningful for them
+    bool compressed;
+    Block_type format;
+    // mips of images that aren't containers, the one set when it was loaded
+    Mip_filter filter;
+    int components;
+    // finest level that is always resident, the last level no larger than TextureResidency::coarseSize
+    int coarse;
+    // frame of the last request and the finest level it asked for
+    uint64_t used;
+    int wanted;
+    // a job for this texture is queued or decoding
+    bool loading;
+};
+
+// Keeps the mip levels of the textures it loads within a memory budget. load returns a placeholder at once and a
+// loader thread brings in the coarse levels first, up to coarseSize, which stay resident from then on. The renderer
+// reports how densely each texture is sampled with request, and update streams in the finer levels that are asked for
+// and fit. When they don't, or the budget shrinks, the finest levels of the least recently requested textures are
+// dropped first, then the levels of textures in view that are finer than they need. Dropping copies the remaining
+// levels into a smaller texture on the GPU with GL 4.3 or ARB_copy_image, through client memory otherwise.
+// Finer levels are read from the file again, KTX2 and DDS files straight from their chain. Nothing is kept on the CPU
+// between loads, so other images are decoded whole and their full mip chain rebuilt for the coarse load and again for
+// every refinement, most of it thrown away each time. Budget the loader for that or convert them once with
+// compressTextureFile, block compressed files stream in far cheaper.
+class TextureResidency {
+public:
+    // bytes all resident levels may take. The coarse levels stay even if they alone go over, textures in view
+    // give up finer levels they asked for only when the budget can't be kept otherwise
+    size_t memoryBudget;
+    // upload budget of one update, like TextureStreamer's. One upload always goes through
+    size_t byteBudget;
+    double timeBudget;
+    // largest side of the levels a first load brings in
+    int coarseSize;
+    // mip chain of images that aren't containers. GPU builds it with a box filter on the CPU, the levels have to
+    // exist before the finest one is resident. Loads take the filter set when they start
+    Mip_filter mipFilter;
+
+    TextureResidency(size_t memoryBytes = 256 << 20, size_t bytesPerFrame = 16 << 20, double msPerFrame = 2.0);
+    // stops the loader, the textures keep the levels they have
+    ~TextureResidency(void);
+    TextureResidency(const TextureResidency&) = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+
+    // a texture dropped by everyone else is released by the next update. Needs the GL context for the placeholder
+    std::shared_ptr<ResidentTexture> load(const std::string& path, bool srgb = false);
+    // called for every draw that samples texture, between two updates. texelsPerPixel is how many texels of the
+    // file's level 0 fall on one screen pixel along the denser axis, e.g. width * uv span / pixels covered. Level
+    // log2 of it is what the sampler reads, the finest level of all requests since the last update is kept
+    void request(ResidentTexture& texture, float texelsPerPixel);
+    // uploads what the loader finished, evicts and queues finer levels. Once per frame with the GL context current
+    void update(void);
+    // jobs that aren't uploaded yet
+    size_t pending(void);
+    size_t residentBytes(void) const { return resident; }
+    size_t size(void) const { return textures.size(); }
+
+private:
+    struct Job {
+        std::shared_ptr<ResidentTexture> texture;
+        std::string path;
+        bool srgb;
+        Mip_filter filter;
+        // finest level to read, -1 for the coarse levels of a first load. The loader sets it to the one it read
+        int level;
+        int coarseSize;
+        // set by the loader, the levels from level down in one of the two
+        ImageData image;
+        CompressedImage compressed;
+        int width, height, levels, components;
+        bool loaded;
+    };
+
+    // every texture load returned, dropped once the caller's references are gone
+    std::vector<std::shared_ptr<ResidentTexture>> textures;
+    size_t resident;
+    uint64_t frame;
+
+    // waiting for and done with decoding, shared with the loader thread
+    std::deque<std::shared_ptr<Job>> queued;
+    std::deque<std::shared_ptr<Job>> decoded;
+    // render thread only
+    std::deque<std::shared_ptr<Job>> uploading;
+
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void queue(const std::shared_ptr<ResidentTexture>& texture, int level);
+    // reads the levels of a job on the loader thread
+    void decode(Job& job);
+    bool upload(Job& job);
+    // the level dropping stops at while the texture's requests are to be kept, its coarse level out of view
+    int floorLevel(const ResidentTexture& texture) const;
+    // bytes makeRoom could free for keep
+    size_t evictable(const ResidentTexture* keep) const;
+    // drops levels of textures other than keep, least recently requested first, until bytes more fit the budget
+    // or nothing else can go. Without keep it enforces the budget and takes from textures in view as well
+    void makeRoom(size_t bytes, const ResidentTexture* keep);
+    // moves the texture's finest resident level down to first
+    void evict(ResidentTexture& texture, int first);
+};
+
+#endif
@@ -0,0 +1,394 @@
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// region of a source that wasn't staged
+const uint64_t NO_REGION = ~(uint64_t)0;
+// region offsets, more than any unpack alignment
+const size_t STAGING_ALIGNMENT = 16;
+
+namespace {
+    // base level and mips back to back, the layout uploadImage reads
+    void copyLevels(const ImageData& image, unsigned char* dst) {
+        size_t bytes = (size_t)image.width * image.height * image.components;
+        std::memcpy(dst, image.pixels, bytes);
+        dst += bytes;
+        for (const ImageData& mip : image.mips) {
+            bytes = (size_t)mip.width * mip.height * mip.components;
+            std::memcpy(dst, mip.pixels, bytes);
+            dst += bytes;
+        }
+    }
+
+    // GL 4.4 or ARB_buffer_storage, with a loader that was generated with them
+    bool bufferStorageSupported(void) {
+#if defined(GL_VERSION_4_4)
+        if (GLAD_GL_VERSION_4_4) return true;
+#endif
+#if defined(GL_ARB_buffer_storage)
+        if (GLAD_GL_ARB_buffer_storage) return true;
+#endif
+        return false;
+    }
+}
+
+////////////////////////////
+/// StreamedTexture Definitions ///
+////////////////////////////
+
+StreamedTexture::StreamedTexture(unsigned int textureTarget) :
+    target{ textureTarget }, ready{ false }, failed{ false }
+{
+    // 1x1 mid grey like ModelStreamer's placeholder, replaced in place so the name never changes
+    ID = GLTexture::create();
+    unsigned char grey[4] = { 128, 128, 128, 255 };
+    glBindTexture(target, ID);
+    if (target == GL_TEXTURE_CUBE_MAP) {
+        for (unsigned int face = 0; face < 6; face++) glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    else {
+        glTexImage2D(target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    glBindTexture(target, 0);
+}
+
+void StreamedTexture::bind(unsigned int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, ID);
+}
+
+////////////////////////////
+/// TextureStreamer Definitions ///
+////////////////////////////
+
+TextureStreamer::TextureStreamer(size_t bytesPerFrame, double msPerFrame, size_t ringBytes) :
+    byteBudget{ bytesPerFrame },
+    timeBudget{ msPerFrame },
+    mipFilter{ Mip_filter::KAISER },
+    stopping{ false },
+    stagingBytes{ ringBytes },
+    mapped{ nullptr },
+    firstRegion{ 0 }
+{
+    staging = GLBuffer::create();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+    if (bufferStorageSupported()) {
+        // coherent, so the loader's writes need no flush before the upload that reads them
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, stagingBytes, nullptr, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, stagingBytes, flags);
+        if (!mapped) {
+            // the storage is immutable, start over with a buffer update can map piece by piece
+            std::cout << "ERROR::TEXTURE_STREAMER:: persistent mapping failed, mapping per upload\n";
+            staging = GLBuffer::create();
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+        }
+    }
+#endif
+    if (!mapped) glBufferData(GL_PIXEL_UNPACK_BUFFER, stagingBytes, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // decodes one load at a time, the files of a cube map on the pool. A separate thread for the same reason
+    // as ModelStreamer's loader
+    loader = std::thread([this] {
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queued.empty(); });
+                if (stopping) return;
+                // stays queued while it decodes, so pending counts it
+                job = queued.front();
+            }
+            // nobody but us holds the texture anymore, skip the work
+            if (job->texture.use_count() > 1) {
+                ThreadPool::global().parallelFor(job->sources.size(), [&](size_t begin, size_t end, size_t) {
+                    for (size_t i = begin; i < end; i++) decode(job->sources[i], job->srgb, job->filter);
+                });
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.pop_front();
+            decoded.push_back(job);
+        }
+    });
+}
+
+TextureStreamer::~TextureStreamer(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    loader.join();
+    for (const Region& region : regions) {
+        if (region.fence) glDeleteSync((GLsync)region.fence);
+    }
+    if (mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+}
+
+std::shared_ptr<StreamedTexture> TextureStreamer::load(const std::string& path, bool srgb) {
+    return enqueue(GL_TEXTURE_2D, { path }, srgb);
+}
+
+std::shared_ptr<StreamedTexture> TextureStreamer::loadCubeMap(const std::vector<std::string>& faces, bool srgb) {
+    return enqueue(GL_TEXTURE_CUBE_MAP, faces, srgb);
+}
+
+std::shared_ptr<StreamedTexture> TextureStreamer::enqueue(unsigned int target, const std::vector<std::string>& paths, bool srgb) {
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->texture = std::make_shared<StreamedTexture>(target);
+    job->srgb = srgb;
+    // cube maps filter linearly without mips, like CubeMap
+    job->filter = target == GL_TEXTURE_CUBE_MAP ? Mip_filter::GPU : mipFilter;
+    job->sources.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        job->sources[i].path = paths[i];
+        job->sources[i].components = 0;
+        job->sources[i].region = NO_REGION;
+    }
+    // taken before queueing, see ModelStreamer::load
+    std::shared_ptr<StreamedTexture> texture = job->texture;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(job);
+    }
+    wake.notify_one();
+    return texture;
+}
+
+size_t TextureStreamer::pending(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queued.size() + decoded.size() + uploading.size();
+}
+
+size_t TextureStreamer::Source::bytes(void) const {
+    size_t total = 0;
+    for (const LevelSize& level : levels) total += (size_t)level.width * level.height * components;
+    return total;
+}
+
+void TextureStreamer::decode(Source& source, bool srgb, Mip_filter filter) {
+    if (isCompressedTextureFile(source.path)) {
+        readCompressedImage(source.path, source.compressed);
+        return;
+    }
+    source.image = ImageData(source.path);
+    if (!source.image.pixels) return;
+    generateMipmaps(source.image, srgb, filter);
+    source.components = source.image.components;
+    source.levels.push_back({ source.image.width, source.image.height });
+    for (const ImageData& mip : source.image.mips) source.levels.push_back({ mip.width, mip.height });
+    if (!mapped) return;
+    size_t bytes = source.bytes();
+    size_t offset;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        source.region = allocate(bytes);
+        if (source.region == NO_REGION) return;
+        offset = regions[source.region - firstRegion].offset;
+    }
+    // the region is ours until its upload, so the copy needs no lock
+    copyLevels(source.image, mapped + offset);
+    source.image = ImageData();
+}
+
+uint64_t TextureStreamer::allocate(size_t bytes) {
+    bytes = (bytes + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    size_t offset;
+    if (regions.empty()) {
+        if (bytes > stagingBytes) return NO_REGION;
+        offset = 0;
+    }
+    else {
+        size_t tail = regions.front().offset;
+        size_t head = regions.back().offset + regions.back().bytes;
+        // free space is [head, size) and [0, tail) before the ring wraps, [head, tail) after
+        if (head > tail && head + bytes <= stagingBytes) offset = head;
+        else if (head > tail && bytes <= tail) offset = 0;
+        else if (head <= tail && head + bytes <= tail) offset = head;
+        else return NO_REGION;
+    }
+    regions.push_back(Region{ offset, bytes, nullptr, false });
+    return firstRegion + regions.size() - 1;
+}
+
+void TextureStreamer::reclaim(void) {
+    // in allocation order, a region still in flight holds back the ones after it
+    while (!regions.empty() && regions.front().done) {
+        Region& region = regions.front();
+        if (region.fence) {
+            GLenum status = glClientWaitSync((GLsync)region.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+            glDeleteSync((GLsync)region.fence);
+        }
+        regions.pop_front();
+        firstRegion++;
+    }
+}
+
+void TextureStreamer::release(Job& job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Source& source : job.sources) {
+        if (source.region != NO_REGION) regions[source.region - firstRegion].done = true;
+        source.region = NO_REGION;
+    }
+}
+
+size_t TextureStreamer::jobBytes(const Job& job) const {
+    size_t bytes = 0;
+    for (const Source& source : job.sources) {
+        bytes += source.compressed.empty() ? source.bytes() : source.compressed.bytes();
+    }
+    return bytes;
+}
+
+bool TextureStreamer::uploadImage(Source& source, bool srgb, unsigned int target) {
+    unsigned int format, internalFormat;
+    if (source.levels.empty() || !imageFormat(source.components, srgb, format, internalFormat)) return false;
+    size_t bytes = source.bytes();
+    size_t offset = 0;
+    if (source.region == NO_REGION && source.image.pixels) {
+        // the loader couldn't stage it, the ring is either full or not mapped
+        std::lock_guard<std::mutex> lock(mutex);
+        source.region = allocate(bytes);
+        if (source.region != NO_REGION) {
+            offset = regions[source.region - firstRegion].offset;
+            unsigned char* dst = mapped ? mapped + offset : nullptr;
+            if (!mapped) {
+                // unsynchronized, the fences already keep this range out of the GPU's way
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+                dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            }
+            if (dst) copyLevels(source.image, dst);
+            if (!mapped) {
+                if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) dst = nullptr;
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            }
+            if (!dst) {
+                regions[source.region - firstRegion].done = true;
+                source.region = NO_REGION;
+            }
+        }
+    }
+    else if (source.region != NO_REGION) {
+        std::lock_guard<std::mutex> lock(mutex);
+        offset = regions[source.region - firstRegion].offset;
+    }
+
+    // rows of 1 and 3 channel images aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    bool staged = source.region != NO_REGION;
+    if (staged) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+    for (size_t l = 0; l < source.levels.size(); l++) {
+        const LevelSize& level = source.levels[l];
+        const void* pixels = (const void*)(uintptr_t)offset;
+        // larger than the ring, or it is full of uploads in flight. The driver copies it out of client memory instead
+        if (!staged) pixels = l == 0 ? source.image.pixels : source.image.mips[l - 1].pixels;
+        glTexImage2D(target, (GLint)l, internalFormat, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        offset += (size_t)level.width * level.height * source.components;
+    }
+    if (staged) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        std::lock_guard<std::mutex> lock(mutex);
+        Region& region = regions[source.region - firstRegion];
+        region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region.done = true;
+        source.region = NO_REGION;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    source.image = ImageData();
+    return true;
+}
+
+bool TextureStreamer::upload(Job& job) {
+    StreamedTexture& texture = *job.texture;
+    bool cube = texture.target == GL_TEXTURE_CUBE_MAP;
+    glBindTexture(texture.target, texture.ID);
+    // faces filled so far, a cube map has to end up with all six
+    unsigned int face = 0;
+    bool ok = !job.sources.empty() && (cube || job.sources.size() == 1);
+    int levels = 1;
+    for (size_t i = 0; ok && i < job.sources.size(); i++) {
+        Source& source = job.sources[i];
+        if (!source.compressed.empty()) {
+            // a cube map container holds all six faces and is given as the only file
+            const CompressedImage& image = source.compressed;
+            ok = cube ? face + image.faces <= 6 : image.faces == 1;
+            for (int f = 0; ok && f < image.faces; f++) ok = uploadCompressedLevels(cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face++ : GL_TEXTURE_2D, image, f);
+            levels = (int)image.levels.size();
+            source.compressed = CompressedImage();
+        }
+        else {
+            ok = face < 6 && uploadImage(source, job.srgb, cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D);
+            levels = (int)source.levels.size();
+            face++;
+        }
+    }
+    ok = ok && (!cube || face == 6);
+    if (ok && !cube) {
+        // containers and CPU mipmapped images bring their chain, the rest is built on the GPU
+        if (levels > 1) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        else glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindTexture(texture.target, 0);
+    release(job);
+    return ok;
+}
+
+void TextureStreamer::update(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reclaim();
+        while (!decoded.empty()) {
+            uploading.push_back(decoded.front());
+            decoded.pop_front();
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    bool first = true;
+    while (!uploading.empty()) {
+        Job& job = *uploading.front();
+        if (job.texture.use_count() == 1) {
+            // abandoned, its staged pixels are dropped
+            release(job);
+            uploading.pop_front();
+            continue;
+        }
+        size_t next = jobBytes(job);
+        // stop before a texture that would overshoot the budget, unless nothing went through yet
+        if (!first) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (timeBudget > 0 && ms >= timeBudget) break;
+            if (byteBudget > 0 && bytes + next > byteBudget) break;
+        }
+        first = false;
+        bytes += next;
+        if (upload(job)) job.texture->ready = true;
+        else {
+            std::cout << "ERROR::TEXTURE_STREAMER:: failed to load " << job.sources.front().path << std::endl;
+            job.texture->failed = true;
+        }
+        uploading.pop_front();
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef TEXTURE_STREAMER_HH
+#define TEXTURE_STREAMER_HH
+
+#include "GLHandle.h"
+#include "MipmapGeneration.h"
+#include "Texture.h"
+#include "TextureCompression.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a texture TextureStreamer fills in the background. ID is a complete texture from the start, a flat grey
+// placeholder until update puts the image into it, so it can be bound and drawn with right away
+class StreamedTexture {
+public:
+    GLTexture ID;
+    // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+    unsigned int target;
+    // set by update once the image is in. A failed load keeps the placeholder
+    bool ready, failed;
+
+    StreamedTexture(unsigned int textureTarget);
+    void bind(unsigned int unit = 0) const;
+};
+
+// Loads textures without stalling the render loop. load returns a placeholder texture at once, a loader thread decodes
+// the files (the faces of a cube map in parallel on the global ThreadPool) and copies the pixels into a ring of pixel
+// unpack buffer memory, and update, called once per frame with the GL context current, points glTexImage2D at them.
+// The copy into the texture then runs on the GPU's time, a fence per upload tells when the ring can reuse the space.
+// 2D textures repeat and are mipmapped like uploadTexture2D, cube maps clamp and filter linearly like CubeMap.
+// The mips of 2D images are built on the loader too and travel through the ring with their base level.
+// KTX2 and DDS files go up with their own mip chain.
+class TextureStreamer {
+public:
+    // upload budget of one update, like ModelStreamer's. One texture always goes through
+    size_t byteBudget;
+    double timeBudget;
+    // mip chain of 2D images, built by the loader and staged with them. Loads take the filter set when they start
+    Mip_filter mipFilter;
+
+    // stagingBytes is the size of the ring. With GL 4.4 or ARB_buffer_storage it stays mapped and the loader
+    // copies into it, otherwise update maps the piece it needs. Images larger than the ring are uploaded from
+    // client memory. Needs the GL context
+    TextureStreamer(size_t bytesPerFrame = 16 << 20, double msPerFrame = 2.0, size_t stagingBytes = 64 << 20);
+    // stops the loader, textures that didn't arrive keep their placeholder. Needs the GL context
+    ~TextureStreamer(void);
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // a load whose texture is dropped by everyone else is abandoned. Both need the GL context for the placeholder
+    std::shared_ptr<StreamedTexture> load(const std::string& path, bool srgb = false);
+    // one image per face in GL face order, or a single KTX2 or DDS cube map
+    std::shared_ptr<StreamedTexture> loadCubeMap(const std::vector<std::string>& faces, bool srgb = false);
+    // uploads within the budget, render thread only
+    void update(void);
+    // loads that aren't uploaded yet
+    size_t pending(void);
+    // whether the ring is persistently mapped
+    bool persistent(void) const { return mapped != nullptr; }
+
+private:
+    struct LevelSize {
+        int width, height;
+    };
+    // one file of a load
+    struct Source {
+        std::string path;
+        // the decoded pixels and their mips, freed once they are in the ring
+        ImageData image;
+        CompressedImage compressed;
+        // kept when the pixels are freed, empty if the image couldn't be read
+        std::vector<LevelSize> levels;
+        int components;
+        // serial of its ring region, NO_REGION if it isn't staged
+        uint64_t region;
+
+        // all levels, the size of the region
+        size_t bytes(void) const;
+    };
+    struct Job {
+        std::shared_ptr<StreamedTexture> texture;
+        std::vector<Source> sources;
+        bool srgb;
+        Mip_filter filter;
+    };
+    // a piece of the ring in allocation order. done once its upload is issued, free again when the fence has passed
+    struct Region {
+        size_t offset, bytes;
+        // GLsync of the upload, null for regions dropped without one
+        void* fence;
+        bool done;
+    };
+
+    // waiting for and done with decoding, shared with the loader thread
+    std::deque<std::shared_ptr<Job>> queued;
+    std::deque<std::shared_ptr<Job>> decoded;
+    // render thread only
+    std::deque<std::shared_ptr<Job>> uploading;
+
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    GLBuffer staging;
+    size_t stagingBytes;
+    // the persistent mapping, null without buffer storage
+    unsigned char* mapped;
+    // guarded by mutex, the loader allocates while update frees
+    std::deque<Region> regions;
+    uint64_t firstRegion;
+
+    std::shared_ptr<StreamedTexture> enqueue(unsigned int target, const std::vector<std::string>& paths, bool srgb);
+    // reads one file on a loader or pool thread and stages it if the ring is mapped
+    void decode(Source& source, bool srgb, Mip_filter filter);
+    // NO_REGION if the ring has no room, mutex held
+    uint64_t allocate(size_t bytes);
+    // frees regions from the front whose uploads the GPU finished, mutex held
+    void reclaim(void);
+    // marks the unused regions of a job done so the ring can move past them
+    void release(Job& job);
+    bool upload(Job& job);
+    bool uploadImage(Source& source, bool srgb, unsigned int target);
+    size_t jobBytes(const Job& job) const;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+ThreadPool::ThreadPool(size_t threads) :
+    stopping{ false }
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // the calling thread always helps so one fewer worker is needed
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back([this] {
+            while (true) {
+                std::function<void(void)> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (stopping && jobs.empty()) return;
+                    job = std::move(jobs.front().run);
+                    jobs.pop_front();
+                }
+                job();
+                done.notify_all();
+            }
+        });
+    }
+}
+
+void ThreadPool::submit(std::function<void(void)> job, const void* group) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{ std::move(job), group });
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::runOne(const void* group) {
+    std::function<void(void)> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.begin();
+        while (it != jobs.end() && group && it->group != group) ++it;
+        if (it == jobs.end()) return false;
+        job = std::move(it->run);
+        jobs.erase(it);
+    }
+    job();
+    done.notify_all();
+    return true;
+}
+
+void ThreadPool::helpUntil(const std::function<bool(void)>& pred, const void* group) {
+    while (!pred()) {
+        if (runOne(group)) continue;
+        std::unique_lock<std::mutex> lock(mutex);
+        // timed so a job finishing between the check and the wait can't hang us
+        done.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t begin, size_t end, size_t chunk)>& f, size_t chunks) {
+    if (n == 0) return;
+    if (chunks == 0) chunks = size();
+    chunks = std::min(chunks, n);
+    if (chunks == 1) {
+        f(0, n, 0);
+        return;
+    }
+    std::atomic<size_t> remaining(chunks - 1);
+    size_t step = (n + chunks - 1) / chunks;
+    for (size_t c = 1; c < chunks; c++) {
+        size_t begin = std::min(n, c * step);
+        size_t end = std::min(n, begin + step);
+        submit([&f, &remaining, begin, end, c] {
+            f(begin, end, c);
+            remaining--;
+        }, &remaining);
+    }
+    f(0, std::min(n, step), 0);
+    helpUntil([&remaining] { return remaining == 0; }, &remaining);
+}
+
+ThreadPool& ThreadPool::global(void) {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::~ThreadPool(void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) t.join();
+}
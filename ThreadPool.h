@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_HH
+#define THREAD_POOL_HH
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size worker pool shared by the CPU side of the engine (mesh processing, image decoding, ...)
+// Never touches GL, anything that needs the context has to be handed back to the render thread.
+class ThreadPool {
+public:
+    ThreadPool(size_t threads = 0);
+
+    // queue a job to run on some worker. group tags it for helpUntil, any pointer unique to the waiter will do
+    void submit(std::function<void(void)> job, const void* group = nullptr);
+    // splits [0, n) into chunks and runs them on the pool and the calling thread, returns once all are done.
+    // f receives [begin, end) and the chunk number, chunks are laid out identically for the same n and chunks
+    // so per-chunk results can be reduced deterministically. chunks = 0 uses one chunk per thread.
+    // while it waits the calling thread only runs chunks of this call, never another caller's jobs
+    void parallelFor(size_t n, const std::function<void(size_t begin, size_t end, size_t chunk)>& f, size_t chunks = 0);
+    // runs queued jobs of group on the calling thread until pred is true, used to wait without starving the pool.
+    // Other jobs are left to the workers, so a render thread waiting on a short job doesn't end up running a long
+    // one, e.g. an import of ModelStreamer's loader. A null group runs any job
+    void helpUntil(const std::function<bool(void)>& pred, const void* group = nullptr);
+    // workers plus the calling thread
+    size_t size(void) const { return workers.size() + 1; }
+
+    // process wide pool
+    static ThreadPool& global(void);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool(void);
+
+private:
+    struct Job {
+        std::function<void(void)> run;
+        const void* group;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping;
+
+    // the oldest job of group, or of any group for nullptr
+    bool runOne(const void* group);
+};
+
+#endif
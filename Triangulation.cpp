@@ -0,0 +1,308 @@
+#include "Triangulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+namespace {
+
+struct Vertex {
+    double x, y;
+    // neighbours along the contour with the polygon interior on the left
+    unsigned int prev, next;
+};
+
+enum class Vertex_type {
+    START,
+    END,
+    SPLIT,
+    MERGE,
+    REGULAR
+};
+
+// sweep order, top to bottom then left to right
+inline bool above(const Vertex& a, const Vertex& b) {
+    return a.y > b.y || (a.y == b.y && a.x < b.x);
+}
+
+inline double orient(const Vertex& a, const Vertex& b, const Vertex& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+double signedArea(const std::vector<float>& contour) {
+    size_t n = contour.size() / 3;
+    double area = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t j = (i + 1) % n;
+        area += (double)contour[3 * i] * contour[3 * j + 1] - (double)contour[3 * j] * contour[3 * i + 1];
+    }
+    return area / 2;
+}
+
+// status structure ordering: edges crossing the sweep line ordered by x at the sweep height
+struct SweepStatus {
+    const std::vector<Vertex>* vs;
+    double y;
+
+    double xAt(unsigned int e, double y0) const {
+        const Vertex& a = (*vs)[e];
+        const Vertex& b = (*vs)[a.next];
+        if (a.y == b.y) return std::min(a.x, b.x);
+        double t = (y0 - a.y) / (b.y - a.y);
+        return a.x + t * (b.x - a.x);
+    }
+};
+
+// lookup key for the point on the sweep line a new vertex sits at
+struct SweepProbe {
+    double x;
+};
+
+struct EdgeOrder {
+    typedef void is_transparent;
+    const SweepStatus* s;
+    bool operator()(unsigned int e, SweepProbe p) const { return s->xAt(e, s->y) < p.x; }
+    bool operator()(SweepProbe p, unsigned int e) const { return p.x < s->xAt(e, s->y); }
+    bool operator()(unsigned int a, unsigned int b) const {
+        if (a == b) return false;
+        double xa = s->xAt(a, s->y);
+        double xb = s->xAt(b, s->y);
+        if (xa != xb) return xa < xb;
+        // edges meeting on the sweep line, order by where they go next
+        const std::vector<Vertex>& vs = *s->vs;
+        double yl = std::max(std::min(vs[a].y, vs[vs[a].next].y), std::min(vs[b].y, vs[vs[b].next].y));
+        double y0 = (s->y + yl) / 2;
+        xa = s->xAt(a, y0);
+        xb = s->xAt(b, y0);
+        if (xa != xb) return xa < xb;
+        return a < b;
+    }
+};
+
+void emitTriangle(const std::vector<Vertex>& vs, unsigned int a, unsigned int b, unsigned int c, std::vector<unsigned int>& indices) {
+    if (orient(vs[a], vs[b], vs[c]) < 0) std::swap(b, c);
+    indices.push_back(a);
+    indices.push_back(b);
+    indices.push_back(c);
+}
+
+// stack triangulation of a y-monotone polygon given in counter clockwise order
+void triangulateMonotone(const std::vector<Vertex>& vs, const std::vector<unsigned int>& poly, std::vector<unsigned int>& indices) {
+    size_t n = poly.size();
+    if (n < 3) return;
+    if (n == 3) {
+        emitTriangle(vs, poly[0], poly[1], poly[2], indices);
+        return;
+    }
+    size_t top = 0, bot = 0;
+    for (size_t i = 1; i < n; i++) {
+        if (above(vs[poly[i]], vs[poly[top]])) top = i;
+        if (above(vs[poly[bot]], vs[poly[i]])) bot = i;
+    }
+    // merge the two chains into sweep order. Walking forward from the top (counter clockwise)
+    // descends the left chain, walking backward descends the right chain
+    std::vector<unsigned int> sorted;
+    std::vector<bool> left;
+    sorted.reserve(n);
+    left.reserve(n);
+    sorted.push_back(poly[top]);
+    left.push_back(true);
+    size_t l = (top + 1) % n, r = (top + n - 1) % n;
+    while (sorted.size() < n - 1) {
+        if (l != bot && (r == bot || above(vs[poly[l]], vs[poly[r]]))) {
+            sorted.push_back(poly[l]);
+            left.push_back(true);
+            l = (l + 1) % n;
+        }
+        else {
+            sorted.push_back(poly[r]);
+            left.push_back(false);
+            r = (r + n - 1) % n;
+        }
+    }
+    sorted.push_back(poly[bot]);
+    left.push_back(true);
+
+    std::vector<size_t> stack{ 0, 1 };
+    for (size_t j = 2; j < n - 1; j++) {
+        if (left[j] != left[stack.back()]) {
+            // opposite chain, fan to everything on the stack
+            for (size_t k = 0; k + 1 < stack.size(); k++) {
+                emitTriangle(vs, sorted[j], sorted[stack[k]], sorted[stack[k + 1]], indices);
+            }
+            size_t last = stack.back();
+            stack.clear();
+            stack.push_back(last);
+            stack.push_back(j);
+        }
+        else {
+            // same chain, cut off ears while the diagonal stays inside
+            size_t last = stack.back();
+            stack.pop_back();
+            while (!stack.empty()) {
+                double o = orient(vs[sorted[stack.back()]], vs[sorted[last]], vs[sorted[j]]);
+                if (left[j] ? o <= 0 : o >= 0) break;
+                emitTriangle(vs, sorted[j], sorted[last], sorted[stack.back()], indices);
+                last = stack.back();
+                stack.pop_back();
+            }
+            stack.push_back(last);
+            stack.push_back(j);
+        }
+    }
+    for (size_t k = 0; k + 1 < stack.size(); k++) {
+        emitTriangle(vs, sorted[n - 1], sorted[stack[k]], sorted[stack[k + 1]], indices);
+    }
+}
+
+}
+
+std::vector<float> concatenateContours(const std::vector<float>& outline, const std::vector<std::vector<float>>& holes) {
+    std::vector<float> vs(outline);
+    for (const std::vector<float>& hole : holes) vs.insert(vs.end(), hole.begin(), hole.end());
+    return vs;
+}
+
+std::vector<unsigned int> triangulatePolygon(const std::vector<float>& outline, const std::vector<std::vector<float>>& holes) {
+    // gather every contour, outline counter clockwise and holes clockwise so the interior is always on the left
+    std::vector<Vertex> vs;
+    vs.reserve(outline.size() / 3);
+    auto addContour = [&vs](const std::vector<float>& contour, bool ccw) {
+        unsigned int first = vs.size();
+        unsigned int n = contour.size() / 3;
+        bool flip = (signedArea(contour) > 0) != ccw;
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int p = first + (i + n - 1) % n;
+            unsigned int q = first + (i + 1) % n;
+            if (flip) std::swap(p, q);
+            vs.push_back({ contour[3 * i], contour[3 * i + 1], p, q });
+        }
+    };
+    addContour(outline, true);
+    for (const std::vector<float>& hole : holes) addContour(hole, false);
+
+    std::vector<unsigned int> indices;
+    size_t n = vs.size();
+    if (n < 3) return indices;
+    indices.reserve(3 * (n + 2 * holes.size()));
+
+    std::vector<unsigned int> order(n);
+    for (unsigned int i = 0; i < n; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&vs](unsigned int a, unsigned int b) { return above(vs[a], vs[b]); });
+
+    std::vector<Vertex_type> type(n);
+    for (unsigned int i = 0; i < n; i++) {
+        const Vertex& p = vs[vs[i].prev];
+        const Vertex& q = vs[vs[i].next];
+        bool convex = orient(p, vs[i], q) > 0;
+        if (above(vs[i], p) && above(vs[i], q)) type[i] = convex ? Vertex_type::START : Vertex_type::SPLIT;
+        else if (above(p, vs[i]) && above(q, vs[i])) type[i] = convex ? Vertex_type::END : Vertex_type::MERGE;
+        else type[i] = Vertex_type::REGULAR;
+    }
+
+    // sweep, adding diagonals that split the polygon into monotone pieces.
+    // edge i runs from vertex i to vs[i].next and is only kept in the status while the interior is on its right
+    SweepStatus sweep{ &vs, 0 };
+    std::set<unsigned int, EdgeOrder> status(EdgeOrder{ &sweep });
+    std::vector<std::set<unsigned int, EdgeOrder>::iterator> inStatus(n, status.end());
+    std::vector<unsigned int> helper(n, 0);
+    std::vector<std::pair<unsigned int, unsigned int>> diagonals;
+
+    auto insertEdge = [&](unsigned int e, unsigned int h) {
+        inStatus[e] = status.insert(e).first;
+        helper[e] = h;
+    };
+    auto removeEdge = [&](unsigned int e, unsigned int v) {
+        if (inStatus[e] == status.end()) return;
+        if (type[helper[e]] == Vertex_type::MERGE) diagonals.push_back({ v, helper[e] });
+        status.erase(inStatus[e]);
+        inStatus[e] = status.end();
+    };
+    auto leftOf = [&](unsigned int v) -> unsigned int {
+        auto itr = status.lower_bound(SweepProbe{ vs[v].x });
+        if (itr == status.begin()) return n;
+        return *std::prev(itr);
+    };
+    auto connectLeft = [&](unsigned int v) {
+        unsigned int e = leftOf(v);
+        if (e == n) return;
+        if (type[helper[e]] == Vertex_type::MERGE || type[v] == Vertex_type::SPLIT) diagonals.push_back({ v, helper[e] });
+        helper[e] = v;
+    };
+
+    for (unsigned int v : order) {
+        sweep.y = vs[v].y;
+        unsigned int in = vs[v].prev;
+        switch (type[v]) {
+        case Vertex_type::START:
+            insertEdge(v, v);
+            break;
+        case Vertex_type::END:
+            removeEdge(in, v);
+            break;
+        case Vertex_type::SPLIT:
+            connectLeft(v);
+            insertEdge(v, v);
+            break;
+        case Vertex_type::MERGE:
+            removeEdge(in, v);
+            connectLeft(v);
+            break;
+        case Vertex_type::REGULAR:
+            if (above(vs[in], vs[v])) {
+                // descending boundary, interior to the right
+                removeEdge(in, v);
+                insertEdge(v, v);
+            }
+            else connectLeft(v);
+            break;
+        }
+    }
+
+    // trace the faces of the polygon plus diagonals. At each vertex the outgoing edges are sorted
+    // by angle, the face continues along the first edge clockwise from the one it arrived on
+    std::vector<std::vector<std::pair<double, unsigned int>>> fan(n);
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned int j = vs[i].next;
+        fan[i].push_back({ std::atan2(vs[j].y - vs[i].y, vs[j].x - vs[i].x), j });
+        fan[j].push_back({ std::atan2(vs[i].y - vs[j].y, vs[i].x - vs[j].x), i });
+    }
+    for (const auto& d : diagonals) {
+        unsigned int a = d.first, b = d.second;
+        fan[a].push_back({ std::atan2(vs[b].y - vs[a].y, vs[b].x - vs[a].x), b });
+        fan[b].push_back({ std::atan2(vs[a].y - vs[b].y, vs[a].x - vs[b].x), a });
+    }
+    std::vector<std::vector<bool>> used(n);
+    for (unsigned int i = 0; i < n; i++) {
+        std::sort(fan[i].begin(), fan[i].end());
+        used[i].assign(fan[i].size(), false);
+    }
+    auto slot = [&](unsigned int at, unsigned int to) -> size_t {
+        double angle = std::atan2(vs[to].y - vs[at].y, vs[to].x - vs[at].x);
+        size_t k = std::lower_bound(fan[at].begin(), fan[at].end(), std::make_pair(angle, 0u)) - fan[at].begin();
+        while (fan[at][k % fan[at].size()].second != to) k++;
+        return k % fan[at].size();
+    };
+    // mark the outside of every contour, only interior faces are traced
+    for (unsigned int i = 0; i < n; i++) used[vs[i].next][slot(vs[i].next, i)] = true;
+
+    std::vector<unsigned int> poly;
+    for (unsigned int i = 0; i < n; i++) {
+        for (size_t k = 0; k < fan[i].size(); k++) {
+            if (used[i][k]) continue;
+            poly.clear();
+            unsigned int a = i;
+            size_t s = k;
+            while (!used[a][s]) {
+                used[a][s] = true;
+                poly.push_back(a);
+                unsigned int b = fan[a][s].second;
+                size_t back = slot(b, a);
+                s = (back + fan[b].size() - 1) % fan[b].size();
+                a = b;
+            }
+            triangulateMonotone(vs, poly, indices);
+        }
+    }
+    return indices;
+}
@@ -0,0 +1,20 @@
+#ifndef TRIANGULATION_HH
+#define TRIANGULATION_HH
+
+#include <vector>
+
+// Triangulates a simple polygon with optional holes in O(n log n) by sweeping it into
+// y-monotone pieces and triangulating each piece with a stack walk.
+// Contours use the xyz packing of Geometry.h and only x,y are read. Either winding is
+// accepted for the outline and holes. The returned indices address the outline followed
+// by every hole in order (see concatenateContours) and are wound counter clockwise,
+// matching the index buffers Shape draws with GL_TRIANGLES.
+// The contours have to be simple: no edge may cross another edge of any contour, and holes
+// lie inside the outline without touching each other. That isn't checked, crossing edges
+// break the sweep order and the result is undefined, so test untrusted input first.
+std::vector<unsigned int> triangulatePolygon(const std::vector<float>& outline, const std::vector<std::vector<float>>& holes = {});
+
+// vertex buffer the indices from triangulatePolygon refer to
+std::vector<float> concatenateContours(const std::vector<float>& outline, const std::vector<std::vector<float>>& holes = {});
+
+#endif
@@ -0,0 +1,211 @@
+#include "VertexFormat.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// below this many vertices packing isn't worth spreading over the pool
+const size_t MIN_PARALLEL_VERTICES = 16384;
+
+glm::vec2 octEncode(const glm::vec3& n) {
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 == 0) return glm::vec2(0.0f, 0.0f);
+    glm::vec2 e(n.x / l1, n.y / l1);
+    // fold the lower hemisphere over the diagonals
+    if (n.z < 0) {
+        float x = (1 - std::fabs(e.y)) * (e.x >= 0 ? 1 : -1);
+        float y = (1 - std::fabs(e.x)) * (e.y >= 0 ? 1 : -1);
+        e = glm::vec2(x, y);
+    }
+    return e;
+}
+
+glm::vec3 octDecode(const glm::vec2& e) {
+    glm::vec3 n(e.x, e.y, 1 - std::fabs(e.x) - std::fabs(e.y));
+    float t = std::fmax(-n.z, 0.0f);
+    n.x += n.x >= 0 ? -t : t;
+    n.y += n.y >= 0 ? -t : t;
+    return glm::normalize(n);
+}
+
+uint16_t floatToHalf(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t mant = x & 0x7FFFFF;
+    int exp = (x >> 23) & 0xFF;
+    // inf and nan
+    if (exp == 255) return sign | 0x7C00 | (mant ? 0x200 : 0);
+    int e = exp - 127 + 15;
+    if (e >= 31) return sign | 0x7C00;
+    // round to nearest even in both branches, a carry into the exponent is still correct
+    if (e <= 0) {
+        if (e < -10) return sign;
+        mant |= 0x800000;
+        int shift = 14 - e;
+        uint32_t h = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (h & 1))) h++;
+        return sign | h;
+    }
+    uint32_t h = (e << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return sign | h;
+}
+
+float halfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t x;
+    if (exp == 31) x = sign | 0x7F800000 | (mant << 13);
+    else if (exp != 0) x = sign | ((exp + 112) << 23) | (mant << 13);
+    else if (mant == 0) x = sign;
+    else {
+        // subnormal, renormalize
+        exp = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        x = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+int16_t toSnorm16(float v) {
+    return (int16_t)std::lround(std::fmin(std::fmax(v, -1.0f), 1.0f) * 32767);
+}
+
+uint32_t toSnorm10(float v) {
+    return (uint32_t)std::lround(std::fmin(std::fmax(v, -1.0f), 1.0f) * 511) & 0x3FF;
+}
+
+void packFrame(const VertexData& v, int16_t normal[2], uint32_t& tangent, uint16_t texcoords[2]) {
+    glm::vec2 n = octEncode(v.Normal);
+    normal[0] = toSnorm16(n.x);
+    normal[1] = toSnorm16(n.y);
+    // handedness of the original basis goes into the 2 bit w, the bitangent itself is dropped
+    glm::vec2 t = octEncode(v.Tangent);
+    uint32_t w = glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent) < 0 ? 0x3 : 0x1;
+    tangent = toSnorm10(t.x) | (toSnorm10(t.y) << 10) | (w << 30);
+    texcoords[0] = floatToHalf(v.TexCoords.x);
+    texcoords[1] = floatToHalf(v.TexCoords.y);
+}
+
+void packBones(const VertexData& v, uint8_t ids[4], uint8_t weights[4]) {
+    // normalized first, the weights of an import don't have to add up to 1
+    float total = 0.0f;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) total += std::fmax(v.m_Weights[i], 0.0f);
+    float scale = total > 0.0f ? 255.0f / total : 0.0f;
+    int sum = 0;
+    int largest = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        bool used = v.m_Weights[i] > 0;
+        ids[i] = used ? (uint8_t)v.m_BoneIDs[i] : 0;
+        weights[i] = used ? (uint8_t)std::min(std::lround(v.m_Weights[i] * scale), 255L) : 0;
+        sum += weights[i];
+        if (weights[i] > weights[largest]) largest = i;
+    }
+    // rounding error, at most 2 either way, goes to the largest weight, which is at least 64
+    if (sum > 0) weights[largest] = (uint8_t)(weights[largest] + 255 - sum);
+}
+
+Vertex_format chooseVertexFormat(Vertex_format format, const VertexData* vs, size_t n_vs) {
+    if (format != Vertex_format::AUTO) return format;
+    bool skinned = false;
+    for (size_t i = 0; i < n_vs; i++) {
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            if (vs[i].m_Weights[j] <= 0) continue;
+            if (vs[i].m_BoneIDs[j] < 0 || vs[i].m_BoneIDs[j] > 255) return Vertex_format::FULL;
+            skinned = true;
+        }
+    }
+    return skinned ? Vertex_format::COMPACT_SKINNED : Vertex_format::COMPACT;
+}
+
+size_t vertexSize(Vertex_format format) {
+    switch (format) {
+        case Vertex_format::COMPACT:
+            return sizeof(CompactVertex);
+        case Vertex_format::COMPACT_SKINNED:
+            return sizeof(CompactSkinnedVertex);
+        default:
+            return sizeof(VertexData);
+    }
+}
+
+std::vector<unsigned char> packVertices(Vertex_format format, const VertexData* vs, size_t n_vs) {
+    std::vector<unsigned char> out(vertexSize(format) * n_vs);
+    ThreadPool::global().parallelFor(n_vs, [&](size_t begin, size_t end, size_t) {
+        if (format == Vertex_format::COMPACT) {
+            CompactVertex* cv = (CompactVertex*)out.data();
+            for (size_t i = begin; i < end; i++) {
+                cv[i].Position = vs[i].Position;
+                packFrame(vs[i], cv[i].Normal, cv[i].Tangent, cv[i].TexCoords);
+            }
+        }
+        else if (format == Vertex_format::COMPACT_SKINNED) {
+            CompactSkinnedVertex* cv = (CompactSkinnedVertex*)out.data();
+            for (size_t i = begin; i < end; i++) {
+                cv[i].Position = vs[i].Position;
+                packFrame(vs[i], cv[i].Normal, cv[i].Tangent, cv[i].TexCoords);
+                packBones(vs[i], cv[i].BoneIDs, cv[i].Weights);
+            }
+        }
+        else std::memcpy(out.data() + begin * sizeof(VertexData), vs + begin, (end - begin) * sizeof(VertexData));
+    }, n_vs < MIN_PARALLEL_VERTICES ? 1 : 0);
+    return out;
+}
+
+void setupVertexAttributes(Vertex_format format) {
+    if (format == Vertex_format::COMPACT || format == Vertex_format::COMPACT_SKINNED) {
+        // both compact layouts share their first 24 bytes
+        GLsizei stride = vertexSize(format);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(CompactVertex, Position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(CompactVertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(CompactVertex, Tangent));
+        if (format == Vertex_format::COMPACT_SKINNED) {
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(CompactSkinnedVertex, BoneIDs));
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(CompactSkinnedVertex, Weights));
+        }
+        return;
+    }
+
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Bitangent));
+    // ids
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, GL_INT, sizeof(VertexData), (void*)offsetof(VertexData, m_BoneIDs));
+    // weights
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, m_Weights));
+}
@@ -0,0 +1,68 @@
+#ifndef VERTEX_FORMAT_HH
+#define VERTEX_FORMAT_HH
+
+#include <glm/glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct VertexData;
+
+// GPU side vertex layouts a Mesh can be uploaded with. Attribute locations stay the same across formats:
+// 0 position, 1 normal, 2 texcoords, 3 tangent, 4 bitangent, 5 bone ids, 6 bone weights
+// FULL             VertexData as is, 88 bytes
+// COMPACT          24 bytes, no bone data, for static geometry
+// COMPACT_SKINNED  32 bytes, COMPACT plus 8 bit bone ids and unorm8 weights
+// AUTO             COMPACT or COMPACT_SKINNED depending on the weights, FULL if a bone id doesn't fit in 8 bits
+//
+// In the compact formats the normal (location 1) is a vec2 octahedral encoding, the tangent (location 3) is a
+// vec4 whose xy is the octahedral tangent and w the bitangent sign, and there is no bitangent. Vertex shaders decode with
+//     vec3 octDecode(vec2 e) {
+//         vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//         float t = max(-n.z, 0.0);
+//         n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+//         return normalize(n);
+//     }
+//     bitangent = tangent.w * cross(normal, octDecode(tangent.xy));
+enum class Vertex_format {
+    FULL,
+    COMPACT,
+    COMPACT_SKINNED,
+    AUTO
+};
+
+struct CompactVertex {
+    glm::vec3 Position;
+    // snorm16 octahedral
+    int16_t Normal[2];
+    // 2_10_10_10 snorm, octahedral xy, z unused, w bitangent sign
+    uint32_t Tangent;
+    // half floats
+    uint16_t TexCoords[2];
+};
+
+struct CompactSkinnedVertex {
+    glm::vec3 Position;
+    int16_t Normal[2];
+    uint32_t Tangent;
+    uint16_t TexCoords[2];
+    uint8_t BoneIDs[4];
+    // unorm8, renormalized so they still sum to 255
+    uint8_t Weights[4];
+};
+
+// encoding helpers
+glm::vec2 octEncode(const glm::vec3& n);
+glm::vec3 octDecode(const glm::vec2& e);
+uint16_t floatToHalf(float f);
+float halfToFloat(uint16_t h);
+
+// resolves AUTO against the vertex data, other formats are returned unchanged
+Vertex_format chooseVertexFormat(Vertex_format format, const VertexData* vs, size_t n_vs);
+size_t vertexSize(Vertex_format format);
+// converts to a resolved format, the result is vertexSize(format) * n_vs bytes
+std::vector<unsigned char> packVertices(Vertex_format format, const VertexData* vs, size_t n_vs);
+// sets the attribute pointers of the bound VAO for the array buffer currently bound
+void setupVertexAttributes(Vertex_format format);
+
+#endif